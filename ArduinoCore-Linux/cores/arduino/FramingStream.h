@@ -0,0 +1,397 @@
+/*
+  FramingStream.h
+  Copyright (c) 2025 Phil Schatzmann. All right reserved.
+
+  This library is free software; you can redistribute it and/or
+  modify it under the terms of the GNU Lesser General Public
+  License as published by the Free Software Foundation; either
+  version 2.1 of the License, or (at your option) any later version.
+
+  This library is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+  Lesser General Public License for more details.
+
+  You should have received a copy of the GNU Lesser General Public
+  License along with this library; if not, write to the Free Software
+  Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA 02110-1301 USA
+*/
+
+#pragma once
+#include <stddef.h>
+#include <stdint.h>
+#include <string.h>
+
+#include <algorithm>
+#include <vector>
+
+#include "ArduinoLogger.h"
+#include "api/Stream.h"
+
+namespace arduino {
+
+/**
+ * @brief Consistent Overhead Byte Stuffing: the encoded frame does not contain
+ * any 0, which is used as frame delimiter. The overhead is 1 byte per 254
+ * bytes.
+ */
+struct COBSCodec {
+  static constexpr uint8_t DELIMITER = 0;
+  /// an empty frame is encoded as 0x01, so it can be transmitted
+  static constexpr bool SKIP_EMPTY = false;
+
+  static size_t maxEncodedSize(size_t len) { return len + len / 254 + 1; }
+
+  /// Encodes the data into out (without delimiter): out needs to provide
+  /// maxEncodedSize(len) bytes
+  static size_t encode(const uint8_t* in, size_t len, uint8_t* out) {
+    // an empty frame (in might be null) is just the code byte
+    if (len == 0) {
+      out[0] = 1;
+      return 1;
+    }
+    const uint8_t* end = in + len;
+    size_t o = 0;
+    while (true) {
+      size_t block = std::min<size_t>(end - in, 254);
+      const uint8_t* zero = (const uint8_t*)memchr(in, 0, block);
+      size_t n = zero != nullptr ? zero - in : block;
+      out[o++] = n + 1;
+      memcpy(out + o, in, n);
+      o += n;
+      in += n;
+      if (zero != nullptr) {
+        in++;  // the 0 is implied by the code
+      } else if (n < 254 || in == end) {
+        break;
+      }
+    }
+    return o;
+  }
+
+  /// Decodes the frame (without delimiter): returns -1 if it is invalid or
+  /// does not fit into out
+  static long decode(const uint8_t* in, size_t len, uint8_t* out,
+                     size_t maxLen) {
+    size_t i = 0;
+    size_t o = 0;
+    while (i < len) {
+      uint8_t code = in[i++];
+      size_t n = code - 1;
+      if (code == 0 || i + n > len || o + n > maxLen) return -1;
+      memcpy(out + o, in + i, n);
+      o += n;
+      i += n;
+      if (code != 0xFF && i < len) {
+        if (o >= maxLen) return -1;
+        out[o++] = 0;
+      }
+    }
+    return o;
+  }
+};
+
+/**
+ * @brief SLIP (RFC 1055): frames end with 0xC0, which is escaped in the data
+ * together with the escape character 0xDB.
+ */
+struct SLIPCodec {
+  static constexpr uint8_t DELIMITER = 0xC0;
+  static constexpr uint8_t ESC = 0xDB;
+  static constexpr uint8_t ESC_END = 0xDC;
+  static constexpr uint8_t ESC_ESC = 0xDD;
+  /// SLIP can not distinguish empty frames from line noise
+  static constexpr bool SKIP_EMPTY = true;
+
+  static size_t maxEncodedSize(size_t len) { return 2 * len; }
+
+  static size_t encode(const uint8_t* in, size_t len, uint8_t* out) {
+    size_t i = 0;
+    size_t o = 0;
+    while (i < len) {
+      // copy the bytes up to the next special character in bulk
+      size_t n = findEither(in + i, len - i, DELIMITER, ESC);
+      memcpy(out + o, in + i, n);
+      o += n;
+      i += n;
+      if (i < len) {
+        out[o++] = ESC;
+        out[o++] = in[i++] == DELIMITER ? ESC_END : ESC_ESC;
+      }
+    }
+    return o;
+  }
+
+  static long decode(const uint8_t* in, size_t len, uint8_t* out,
+                     size_t maxLen) {
+    size_t i = 0;
+    size_t o = 0;
+    while (i < len) {
+      const uint8_t* esc = (const uint8_t*)memchr(in + i, ESC, len - i);
+      size_t n = esc != nullptr ? esc - (in + i) : len - i;
+      if (o + n > maxLen) return -1;
+      memcpy(out + o, in + i, n);
+      o += n;
+      i += n;
+      if (esc == nullptr) break;
+      if (i + 1 >= len || o >= maxLen) return -1;
+      uint8_t c = in[i + 1];
+      if (c != ESC_END && c != ESC_ESC) return -1;
+      out[o++] = c == ESC_END ? DELIMITER : ESC;
+      i += 2;
+    }
+    return o;
+  }
+
+  /// Position of the first byte which is a or b: compares 8 bytes at a time
+  static size_t findEither(const uint8_t* data, size_t len, uint8_t a,
+                           uint8_t b) {
+    const uint64_t ones = 0x0101010101010101ULL;
+    const uint64_t highs = 0x8080808080808080ULL;
+    const uint64_t mask_a = ones * a;
+    const uint64_t mask_b = ones * b;
+    size_t i = 0;
+    for (; i + 8 <= len; i += 8) {
+      uint64_t word;
+      memcpy(&word, data + i, 8);
+      uint64_t xa = word ^ mask_a;
+      uint64_t xb = word ^ mask_b;
+      // a byte of xa or xb is 0 where the data matches
+      if ((((xa - ones) & ~xa) | ((xb - ones) & ~xb)) & highs) break;
+    }
+    for (; i < len; i++) {
+      if (data[i] == a || data[i] == b) return i;
+    }
+    return len;
+  }
+};
+
+/**
+ * @brief Stream adapter which splits the data of another stream into frames
+ *
+ * The frames are encoded with the Codec (COBSCodec or SLIPCodec) and separated
+ * by its delimiter, so that a receiver can resynchronize after lost or
+ * corrupted bytes. The frames are processed in bulk: writeFrame() encodes and
+ * sends a whole frame with a single write() and readFrame() decodes the next
+ * frame directly from the receive buffer into the provided buffer. The
+ * delimiter is searched with memchr() over the received data.
+ *
+ * The Stream API can be used as well: write() collects the data of the current
+ * frame which is sent with endFrame() or flush(), read() and readBytes()
+ * provide the data of the received frames. So the adapter can e.g. be passed
+ * to HardwareService::setStream() to frame each request, because the service
+ * flushes the stream after each request.
+ *
+ * The type of the underlying stream is a template parameter, so that its bulk
+ * readBytes() is used if it provides one (e.g. SerialImpl). Adapters can be
+ * stacked.
+ */
+template <class T, class Codec>
+class FramingStream : public Stream {
+ public:
+  FramingStream(T& io, size_t maxFrameSize = 1024) : p_io(&io) {
+    setMaxFrameSize(maxFrameSize);
+  }
+
+  /// Defines the max size of a decoded frame: longer received frames are
+  /// dropped
+  void setMaxFrameSize(size_t size) {
+    max_frame_size = size;
+    rx_buffer.resize(Codec::maxEncodedSize(size) + 1);
+    rx_start = rx_end = scan_pos = 0;
+    is_discarding = false;
+    tx_frame.reserve(size);
+    rx_frame.resize(size);
+    rx_frame_len = rx_frame_pos = 0;
+  }
+
+  size_t maxFrameSize() { return max_frame_size; }
+
+  /// Encodes and sends a complete frame with a single write
+  bool writeFrame(const uint8_t* data, size_t len) {
+    if (!endFrame()) return false;
+    return sendFrame(data, len);
+  }
+
+  /// Sends the data which was written since the last frame
+  bool endFrame() {
+    if (tx_frame.empty()) return true;
+    bool result = sendFrame(tx_frame.data(), tx_frame.size());
+    tx_frame.clear();
+    return result;
+  }
+
+  /// Waits up to the timeout for the next frame and decodes it into data:
+  /// returns the frame length or -1
+  long readFrame(uint8_t* data, size_t len) {
+    // data of a frame which was started with read()
+    if (rx_frame_pos < rx_frame_len) {
+      size_t n = rx_frame_len - rx_frame_pos;
+      if (n > len) return -1;
+      memcpy(data, rx_frame.data() + rx_frame_pos, n);
+      rx_frame_pos = rx_frame_len = 0;
+      return n;
+    }
+    return receiveFrame(data, len, true);
+  }
+
+  size_t write(uint8_t c) override { return write(&c, 1); }
+
+  size_t write(const uint8_t* data, size_t len) override {
+    size_t n = std::min(len, max_frame_size - tx_frame.size());
+    if (n < len) Logger.warning(FRAMING_STREAM, "frame too long");
+    tx_frame.insert(tx_frame.end(), data, data + n);
+    return n;
+  }
+
+  int availableForWrite() override { return max_frame_size - tx_frame.size(); }
+
+  /// Sends the current frame
+  void flush() override {
+    endFrame();
+    p_io->flush();
+  }
+
+  /// Number of bytes of the current received frame
+  int available() override {
+    if (rx_frame_pos == rx_frame_len) nextFrame(false);
+    return rx_frame_len - rx_frame_pos;
+  }
+
+  int read() override {
+    if (available() == 0 && !nextFrame(true)) return -1;
+    return rx_frame[rx_frame_pos++];
+  }
+
+  int peek() override {
+    if (available() == 0 && !nextFrame(true)) return -1;
+    return rx_frame[rx_frame_pos];
+  }
+
+  /// Provides the data of the received frames: waits up to the timeout for
+  /// the first frame
+  size_t readBytes(uint8_t* data, size_t len) {
+    size_t result = 0;
+    while (result < len) {
+      if (available() == 0 && (result > 0 || !nextFrame(true))) break;
+      size_t n = std::min(len - result, (size_t)(rx_frame_len - rx_frame_pos));
+      memcpy(data + result, rx_frame.data() + rx_frame_pos, n);
+      rx_frame_pos += n;
+      result += n;
+    }
+    return result;
+  }
+
+  size_t readBytes(char* data, size_t len) {
+    return readBytes((uint8_t*)data, len);
+  }
+
+ protected:
+  const char* FRAMING_STREAM = "FramingStream";
+  T* p_io;
+  size_t max_frame_size = 0;
+  std::vector<uint8_t> tx_frame;
+  std::vector<uint8_t> tx_encoded;
+  // encoded data which was received: frames start at rx_start, the delimiter
+  // was already searched up to scan_pos
+  std::vector<uint8_t> rx_buffer;
+  size_t rx_start = 0;
+  size_t rx_end = 0;
+  size_t scan_pos = 0;
+  bool is_discarding = false;
+  // decoded frame for the Stream API
+  std::vector<uint8_t> rx_frame;
+  size_t rx_frame_len = 0;
+  size_t rx_frame_pos = 0;
+
+  bool sendFrame(const uint8_t* data, size_t len) {
+    tx_encoded.resize(Codec::maxEncodedSize(len) + 1);
+    size_t n = Codec::encode(data, len, tx_encoded.data());
+    tx_encoded[n++] = Codec::DELIMITER;
+    return p_io->write(tx_encoded.data(), n) == n;
+  }
+
+  bool nextFrame(bool wait) {
+    long n = receiveFrame(rx_frame.data(), rx_frame.size(), wait);
+    rx_frame_pos = 0;
+    rx_frame_len = n > 0 ? n : 0;
+    return n > 0;
+  }
+
+  long receiveFrame(uint8_t* data, size_t len, bool wait) {
+    unsigned long start = millis();
+    while (true) {
+      const uint8_t* buffer = rx_buffer.data();
+      const uint8_t* end = (const uint8_t*)memchr(
+          buffer + scan_pos, Codec::DELIMITER, rx_end - scan_pos);
+      if (end != nullptr) {
+        size_t frame_start = rx_start;
+        size_t frame_len = end - buffer - rx_start;
+        rx_start = scan_pos = end - buffer + 1;
+        if (is_discarding) {
+          is_discarding = false;
+          continue;
+        }
+        if (frame_len == 0 && Codec::SKIP_EMPTY) continue;
+        long n = Codec::decode(buffer + frame_start, frame_len, data,
+                               std::min(len, max_frame_size));
+        if (n < 0) {
+          Logger.warning(FRAMING_STREAM, "invalid frame");
+          continue;
+        }
+        return n;
+      }
+      scan_pos = rx_end;
+      if (!fill(wait)) {
+        if (!wait || millis() - start >= getTimeout()) return -1;
+      }
+    }
+  }
+
+  /// Reads the available data from the underlying stream: waits for at least
+  /// one byte if nothing is available
+  bool fill(bool wait) {
+    if (rx_start > 0) {
+      // move the incomplete frame to the start
+      memmove(rx_buffer.data(), rx_buffer.data() + rx_start, rx_end - rx_start);
+      rx_end -= rx_start;
+      scan_pos -= rx_start;
+      rx_start = 0;
+    }
+    if (rx_end == rx_buffer.size()) {
+      // no delimiter in a full buffer: drop the data up to the next delimiter
+      if (!is_discarding) Logger.warning(FRAMING_STREAM, "frame too long");
+      rx_end = scan_pos = 0;
+      is_discarding = true;
+    }
+    int available = p_io->available();
+    if (available <= 0 && !wait) return false;
+    size_t len = std::min<size_t>(std::max(available, 1),
+                                  rx_buffer.size() - rx_end);
+    size_t n = p_io->readBytes(rx_buffer.data() + rx_end, len);
+    rx_end += n;
+    return n > 0;
+  }
+};
+
+/**
+ * @brief Stream adapter which frames the data with COBS
+ */
+template <class T = Stream>
+class COBSStream : public FramingStream<T, COBSCodec> {
+ public:
+  COBSStream(T& io, size_t maxFrameSize = 1024)
+      : FramingStream<T, COBSCodec>(io, maxFrameSize) {}
+};
+
+/**
+ * @brief Stream adapter which frames the data with SLIP
+ */
+template <class T = Stream>
+class SLIPStream : public FramingStream<T, SLIPCodec> {
+ public:
+  SLIPStream(T& io, size_t maxFrameSize = 1024)
+      : FramingStream<T, SLIPCodec>(io, maxFrameSize) {}
+};
+
+}  // namespace arduino
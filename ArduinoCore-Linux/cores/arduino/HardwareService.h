@@ -19,6 +19,13 @@
 
 #pragma once
 
+#include <map>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+#include "PayloadCodec.h"
+#include "WaitableStream.h"
 #include "api/Stream.h"
 
 namespace arduino {
@@ -85,7 +92,19 @@ enum HWCalls {
   I2sFlush,
   I2sWrite,
   I2sAvailableForWrite,
-  I2sSetBufferSize
+  I2sSetBufferSize,
+  ServiceSetCodec,
+  I2cTransmission,
+  I2cRequest,
+  SerialStreaming,
+  SerialData,
+  SerialAck,
+  ServiceFeature
+};
+
+/// Optional protocol extensions: see HardwareService::hasFeature()
+enum HWFeatures {
+  FeatureI2cTransactions,
 };
 
 /**
@@ -103,6 +122,10 @@ enum HWCalls {
  * - Provides blocking read with timeout for reliable communication.
  * - Handles byte order conversion for cross-platform compatibility.
  * - Can be used as a base for remote hardware emulation or proxying.
+ * - Optional compression of bulk payloads (see PayloadCodec), which needs to
+ *   be negotiated with the device via negotiateCodec(). The device keeps a
+ *   single codec state per connection, so the state is shared by all
+ *   HardwareService objects which use the same stream.
  *
  * Usage:
  *   - Set the stream using setStream().
@@ -116,7 +139,13 @@ class HardwareService {
  public:
   HardwareService() {}
 
-  void setStream(Stream* str) { io = str; }
+  /// Defines the stream: if it implements WaitableStream we sleep while
+  /// waiting for a reply instead of polling it
+  void setStream(Stream* str) {
+    io = str;
+    p_wait = dynamic_cast<WaitableStream*>(str);
+    p_codec = codecState(str);
+  }
 
   void send(HWCalls call) {
     uint16_t val = (uint16_t)call;
@@ -155,31 +184,116 @@ class HardwareService {
 
   void flush() { io->flush(); }
 
+  /// Asks the device to activate the payload codec for the indicated channel:
+  /// it is only used if the device confirms it
+  bool negotiateCodec(PayloadChannel channel, bool active,
+                      uint32_t threshold = 64) {
+    send(ServiceSetCodec);
+    send((uint8_t)channel);
+    send(active);
+    send(threshold);
+    flush();
+    bool ok = receive8() == 1;
+    if (ok) setCodec(channel, active, threshold);
+    return ok;
+  }
+
+  /// Asks the device if it supports the indicated protocol extension: devices
+  /// which do not know the request do not reply, so we get false after the
+  /// timeout
+  bool hasFeature(HWFeatures feature) {
+    send(ServiceFeature);
+    send((uint8_t)feature);
+    flush();
+    return receive8() == 1;
+  }
+
+  /// Activates the payload codec for the channel: payloads smaller than the
+  /// threshold are sent uncompressed
+  void setCodec(PayloadChannel channel, bool active, uint32_t threshold = 64) {
+    if (channel >= PayloadChannelCount || !p_codec) return;
+    p_codec->active[channel] = active;
+    p_codec->threshold[channel] = threshold;
+    p_codec->codec[channel].reset();
+  }
+
+  bool isCodecActive(PayloadChannel channel) {
+    return channel < PayloadChannelCount && p_codec &&
+           p_codec->active[channel];
+  }
+
+  /// Sends a bulk payload: without codec this is the same as send(data, len),
+  /// otherwise the data is preceded by the encoding and the encoded size
+  void sendPayload(PayloadChannel channel, const void* data, size_t len) {
+    const uint8_t* bytes = (const uint8_t*)data;
+    if (!isCodecActive(channel)) {
+      io->write(bytes, len);
+      return;
+    }
+    PayloadCodec::Encoding encoding = PayloadCodec::Raw;
+    PayloadCodec& codec = p_codec->codec[channel];
+    std::vector<uint8_t>& encoded = p_codec->encoded;
+    if (len >= p_codec->threshold[channel]) {
+      encoding = codec.encode(bytes, len, useDelta(channel), encoded);
+    } else if (useDelta(channel)) {
+      codec.setHistory(bytes, len);
+    }
+    send((uint8_t)encoding);
+    if (encoding == PayloadCodec::Raw) {
+      io->write(bytes, len);
+    } else {
+      send((uint32_t)encoded.size());
+      io->write(encoded.data(), encoded.size());
+    }
+  }
+
+  /// Receives a bulk payload of len bytes which was sent with sendPayload()
+  size_t receivePayload(PayloadChannel channel, void* data, size_t len) {
+    if (!isCodecActive(channel)) return receive(data, len);
+    PayloadCodec& codec = p_codec->codec[channel];
+    std::vector<uint8_t>& encoded = p_codec->encoded;
+    PayloadCodec::Encoding encoding = (PayloadCodec::Encoding)receive8();
+    if (encoding == PayloadCodec::Raw) {
+      size_t result = receive(data, len);
+      if (useDelta(channel)) codec.setHistory((uint8_t*)data, len);
+      return result;
+    }
+    uint32_t size = receive32();
+    encoded.resize(size);
+    receive(encoded.data(), size);
+    if (!codec.decode(encoding, encoded.data(), size, (uint8_t*)data, len,
+                      useDelta(channel))) {
+      memset(data, 0, len);
+      return 0;
+    }
+    return len;
+  }
+
   uint16_t receive16() {
-    uint16_t result;
+    uint16_t result = 0;
     blockingRead((char*)&result, sizeof(uint16_t));
     return swap_uint16(result);
   }
 
   uint32_t receive32() {
-    uint32_t result;
+    uint32_t result = 0;
     blockingRead((char*)&result, sizeof(uint32_t));
     return swap_uint32(result);
   }
 
   uint64_t receive64() {
-    uint64_t result;
+    uint64_t result = 0;
     blockingRead((char*)&result, sizeof(uint64_t));
     return swap_uint64(result);
   }
 
   uint8_t receive8() {
-    uint8_t result;
+    uint8_t result = 0;
     blockingRead((char*)&result, sizeof(uint8_t));
     return result;
   }
 
-  uint16_t receive(void* data, int len) {
+  size_t receive(void* data, size_t len) {
     return blockingRead((char*)data, len);
   }
 
@@ -187,13 +301,54 @@ class HardwareService {
 
  protected:
   Stream* io = nullptr;
+  WaitableStream* p_wait = nullptr;
   bool isLittleEndian = !is_big_endian();
   int timeout_ms = 1000;
+  /// negotiated payload compression of a connection
+  struct CodecState {
+    PayloadCodec codec[PayloadChannelCount];
+    bool active[PayloadChannelCount] = {false};
+    uint32_t threshold[PayloadChannelCount] = {0};
+    std::vector<uint8_t> encoded;
+  };
+  std::shared_ptr<CodecState> p_codec;
+
+  /// provides the codec state of the stream which is shared by all users
+  static std::shared_ptr<CodecState> codecState(Stream* stream) {
+    static std::mutex mtx;
+    static std::map<Stream*, std::weak_ptr<CodecState>> states;
+    if (stream == nullptr) return nullptr;
+    std::lock_guard<std::mutex> lock(mtx);
+    // remove the entries of deleted services
+    for (auto it = states.begin(); it != states.end();) {
+      it = it->second.expired() ? states.erase(it) : std::next(it);
+    }
+    std::shared_ptr<CodecState> result = states[stream].lock();
+    if (!result) {
+      result = std::make_shared<CodecState>();
+      states[stream] = result;
+    }
+    return result;
+  }
+
+  /// frame buffers are sent repeatedly: so we encode the difference
+  bool useDelta(PayloadChannel channel) { return channel == PayloadSPI; }
 
-  uint16_t blockingRead(void* data, int len, int timeout = 1000) {
-    int offset = 0;
+  size_t blockingRead(void* data, size_t len, int timeout = 1000) {
+    size_t offset = 0;
     long start = millis();
     while (offset < len && (millis() - start) < timeout) {
+      if (p_wait != nullptr) {
+        // sleep until data arrives and only read what is available, so that
+        // Stream::readBytes() does not poll
+        long remaining = timeout - (long)(millis() - start);
+        if (io->available() <= 0 && !p_wait->waitReadable(remaining)) break;
+        // peek() detects a closed connection
+        if (io->available() <= 0 && io->peek() < 0) continue;
+        size_t n = min(len - offset, (size_t)max(io->available(), 1));
+        offset += io->readBytes((char*)data + offset, n);
+        continue;
+      }
       int n = io->readBytes((char*)data + offset, len - offset);
       offset += n;
     }
@@ -0,0 +1,620 @@
+/*
+  HardwareServiceServer.h
+  Copyright (c) 2025 Phil Schatzmann. All right reserved.
+
+  This library is free software; you can redistribute it and/or
+  modify it under the terms of the GNU Lesser General Public
+  License as published by the Free Software Foundation; either
+  version 2.1 of the License, or (at your option) any later version.
+
+  This library is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+  Lesser General Public License for more details.
+
+  You should have received a copy of the GNU Lesser General Public
+  License along with this library; if not, write to the Free Software
+  Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA 02110-1301 USA
+*/
+#pragma once
+
+#include <stdio.h>
+
+#include <atomic>
+#include <chrono>
+#include <thread>
+#include <vector>
+
+#include "ArduinoLogger.h"
+#include "HardwareGPIO.h"
+#include "HardwareService.h"
+#include "api/HardwareI2C.h"
+#include "api/HardwareSPI.h"
+#include "api/HardwareSerial.h"
+
+namespace arduino {
+
+/**
+ * @brief Device side of the remote hardware protocol
+ *
+ * HardwareServiceServer decodes the HWCalls which are sent by RemoteGPIO,
+ * RemoteI2C, RemoteSPI and RemoteSerialClass and executes them on local
+ * HardwareGPIO, HardwareI2C, HardwareSPI and HardwareSerial objects (e.g. the
+ * Raspberry Pi or FTDI implementations or a mock). So it can be used as local
+ * stand-in for a device or to provide the pins of a Pi to a remote emulator.
+ *
+ * The calls are dispatched with a table which is indexed by the HWCalls
+ * value. All requests that are available are processed as one batch and the
+ * replies are sent with a single flush. By default the requests are
+ * processed by a worker thread; with begin(stream, false) you need to call
+ * processAvailable() yourself e.g. in loop().
+ *
+ * Serial ports can be switched to a streaming mode by the client (see
+ * RemoteSerialClass::setStreaming()): then the received data is pushed to
+ * the client and written data is acknowledged with a frame.
+ *
+ * The compression of SPI and serial payloads is activated when the client
+ * asks for it (see RemoteSPI::setCompression()).
+ *
+ * Requests for missing hardware are consumed and answered with 0, so that the
+ * stream stays in sync.
+ *
+ * Like a device, the server first announces itself with "Arduino-Emulator"
+ * (repeated every second until a reply arrives) and waits for the "OK" of
+ * HardwareSetupRemote before it processes any call. The "OK" is confirmed
+ * with "SYNC", so that the client can skip the repeated banners which were
+ * still on their way.
+ */
+class HardwareServiceServer {
+ public:
+  HardwareServiceServer() { setupHandlers(); }
+
+  ~HardwareServiceServer() { end(); }
+
+  void setGPIO(HardwareGPIO* gpio) { p_gpio = gpio; }
+  void setI2C(HardwareI2C* i2c) { p_i2c = i2c; }
+  void setSPI(HardwareSPI* spi) { p_spi = spi; }
+  /// defines the serial port for the indicated port number
+  void setSerial(HardwareSerial* serial, uint8_t no = 0) {
+    if (no < MAX_SERIAL) p_serial[no] = serial;
+  }
+
+  /// sleep time of the worker thread when no request is available
+  void setIdleDelay(int us) { idle_us = us; }
+
+  /// starts to process the requests from the stream: with doHandShake =
+  /// false the calls are processed without the initial banner/OK exchange
+  bool begin(Stream& stream, bool useThread = true, bool doHandShake = true) {
+    end();
+    p_stream = &stream;
+    service.setStream(&stream);
+    // a new connection starts without compression
+    for (int channel = 0; channel < PayloadChannelCount; channel++) {
+      service.setCodec((PayloadChannel)channel, false);
+    }
+    is_connected = !doHandShake;
+    ok_matched = 0;
+    banner_time = 0;
+    is_banner_sent = false;
+    if (useThread) {
+      is_active = true;
+      worker = std::thread(&HardwareServiceServer::run, this);
+    }
+    return true;
+  }
+
+  /// stops the worker thread
+  void end() {
+    is_active = false;
+    if (worker.joinable()) worker.join();
+  }
+
+  /// processes a single request: returns false if there was none or the call
+  /// is not supported
+  bool processRequest() {
+    if (p_stream == nullptr || !handShake()) return false;
+    if (p_stream->available() <= 0) return false;
+    uint16_t call = service.receive16();
+    if (call >= CALL_COUNT || handlers[call] == nullptr) {
+      unsupported(call);
+      return false;
+    }
+    (this->*handlers[call])();
+    request_count++;
+    return true;
+  }
+
+  /// processes all available requests and sends the replies; returns the
+  /// number of processed requests
+  int processAvailable() {
+    if (p_stream == nullptr || !handShake()) return 0;
+    int count = 0;
+    while (processRequest()) count++;
+    count += pushSerialData();
+    if (count > 0) service.flush();
+    return count;
+  }
+
+  /// number of requests that have been processed
+  uint64_t requestCount() { return request_count; }
+
+  /// true when the client has confirmed the handshake
+  bool isConnected() { return is_connected; }
+
+  operator bool() { return p_stream != nullptr; }
+
+ protected:
+  typedef void (HardwareServiceServer::*Handler)();
+  static constexpr int CALL_COUNT = ServiceFeature + 1;
+  static constexpr int MAX_SERIAL = 4;
+  HardwareService service;
+  Stream* p_stream = nullptr;
+  HardwareGPIO* p_gpio = nullptr;
+  HardwareI2C* p_i2c = nullptr;
+  HardwareSPI* p_spi = nullptr;
+  HardwareSerial* p_serial[MAX_SERIAL] = {nullptr};
+  bool is_streaming[MAX_SERIAL] = {false};
+  Handler handlers[CALL_COUNT];
+  std::thread worker;
+  std::atomic<bool> is_active{false};
+  int idle_us = 100;
+  std::atomic<bool> is_connected{false};
+  bool is_banner_sent = false;
+  unsigned long banner_time = 0;
+  int ok_matched = 0;
+  uint64_t request_count = 0;
+  std::vector<uint8_t> payload;
+
+  void run() {
+    while (is_active) {
+      if (processAvailable() == 0) {
+        std::this_thread::sleep_for(std::chrono::microseconds(idle_us));
+      }
+    }
+  }
+
+  void setupHandlers() {
+    for (int j = 0; j < CALL_COUNT; j++) {
+      handlers[j] = nullptr;
+    }
+    handlers[I2cBegin0] = &HardwareServiceServer::i2cBegin0;
+    handlers[I2cBegin1] = &HardwareServiceServer::i2cBegin1;
+    handlers[I2cEnd] = &HardwareServiceServer::i2cEnd;
+    handlers[I2cSetClock] = &HardwareServiceServer::i2cSetClock;
+    handlers[I2cBeginTransmission] =
+        &HardwareServiceServer::i2cBeginTransmission;
+    handlers[I2cEndTransmission1] = &HardwareServiceServer::i2cEndTransmission1;
+    handlers[I2cEndTransmission] = &HardwareServiceServer::i2cEndTransmission;
+    handlers[I2cRequestFrom3] = &HardwareServiceServer::i2cRequestFrom3;
+    handlers[I2cRequestFrom2] = &HardwareServiceServer::i2cRequestFrom2;
+    handlers[I2cWrite] = &HardwareServiceServer::i2cWrite;
+    handlers[I2cAvailable] = &HardwareServiceServer::i2cAvailable;
+    handlers[I2cRead] = &HardwareServiceServer::i2cRead;
+    handlers[I2cPeek] = &HardwareServiceServer::i2cPeek;
+    handlers[I2cTransmission] = &HardwareServiceServer::i2cTransmission;
+    handlers[I2cRequest] = &HardwareServiceServer::i2cRequest;
+    handlers[SpiTransfer] = &HardwareServiceServer::spiTransfer;
+    handlers[SpiTransfer8] = &HardwareServiceServer::spiTransfer8;
+    handlers[SpiTransfer16] = &HardwareServiceServer::spiTransfer16;
+    handlers[SpiUsingInterrupt] = &HardwareServiceServer::spiUsingInterrupt;
+    handlers[SpiNotUsingInterrupt] =
+        &HardwareServiceServer::spiNotUsingInterrupt;
+    handlers[SpiBeginTransaction] = &HardwareServiceServer::spiBeginTransaction;
+    handlers[SpiEndTransaction] = &HardwareServiceServer::spiEndTransaction;
+    handlers[SpiAttachInterrupt] = &HardwareServiceServer::spiAttachInterrupt;
+    handlers[SpiDetachInterrupt] = &HardwareServiceServer::spiDetachInterrupt;
+    handlers[SpiBegin] = &HardwareServiceServer::spiBegin;
+    handlers[SpiEnd] = &HardwareServiceServer::spiEnd;
+    handlers[GpioPinMode] = &HardwareServiceServer::gpioPinMode;
+    handlers[GpioDigitalWrite] = &HardwareServiceServer::gpioDigitalWrite;
+    handlers[GpioDigitalRead] = &HardwareServiceServer::gpioDigitalRead;
+    handlers[GpioAnalogRead] = &HardwareServiceServer::gpioAnalogRead;
+    handlers[GpioAnalogReference] = &HardwareServiceServer::gpioAnalogReference;
+    handlers[GpioAnalogWrite] = &HardwareServiceServer::gpioAnalogWrite;
+    handlers[GpioTone] = &HardwareServiceServer::gpioTone;
+    handlers[GpioNoTone] = &HardwareServiceServer::gpioNoTone;
+    handlers[GpioPulseIn] = &HardwareServiceServer::gpioPulseIn;
+    handlers[GpioPulseInLong] = &HardwareServiceServer::gpioPulseInLong;
+    handlers[GpioAnalogWriteFrequency] =
+        &HardwareServiceServer::gpioAnalogWriteFrequency;
+    handlers[GpioAnalogWriteResolution] =
+        &HardwareServiceServer::gpioAnalogWriteResolution;
+    handlers[SerialBegin] = &HardwareServiceServer::serialBegin;
+    handlers[SerialEnd] = &HardwareServiceServer::serialEnd;
+    handlers[SerialWrite] = &HardwareServiceServer::serialWrite;
+    handlers[SerialRead] = &HardwareServiceServer::serialRead;
+    handlers[SerialAvailable] = &HardwareServiceServer::serialAvailable;
+    handlers[SerialPeek] = &HardwareServiceServer::serialPeek;
+    handlers[SerialFlush] = &HardwareServiceServer::serialFlush;
+    handlers[ServiceSetCodec] = &HardwareServiceServer::serviceSetCodec;
+    handlers[ServiceFeature] = &HardwareServiceServer::serviceFeature;
+    handlers[SerialStreaming] = &HardwareServiceServer::serialStreaming;
+  }
+
+  /// sends the banner until the client has answered with "OK": returns true
+  /// when the calls can be processed
+  bool handShake() {
+    if (is_connected) return true;
+    while (p_stream->available() > 0) {
+      int ch = p_stream->read();
+      ok_matched = ch == 'O' ? 1 : (ch == 'K' && ok_matched == 1 ? 2 : 0);
+      if (ok_matched == 2) {
+        Logger.info("HardwareServiceServer", "connected");
+        p_stream->write((const uint8_t*)"SYNC\n", 5);
+        p_stream->flush();
+        is_connected = true;
+        return true;
+      }
+    }
+    if (!is_banner_sent || millis() - banner_time >= 1000) {
+      p_stream->write((const uint8_t*)"Arduino-Emulator\n", 17);
+      p_stream->flush();
+      is_banner_sent = true;
+      banner_time = millis();
+    }
+    return false;
+  }
+
+  /// we can not know the size of the arguments: so we drop the pending data
+  void unsupported(uint16_t call) {
+    char msg[16];
+    snprintf(msg, sizeof(msg), "%u", call);
+    Logger.error("HardwareServiceServer", "unsupported call", msg);
+    while (p_stream->available() > 0) p_stream->read();
+  }
+
+  HardwareSerial* serial(uint8_t no) {
+    return no < MAX_SERIAL ? p_serial[no] : nullptr;
+  }
+
+  /// sends a frame to a serial port in streaming mode
+  void sendFrame(HWCalls type, uint8_t no, const uint8_t* data, uint16_t len) {
+    service.send((uint16_t)type);
+    service.send(no);
+    service.send(len);
+    if (data != nullptr) service.send((void*)data, len);
+  }
+
+  /// pushes the received data of the serial ports in streaming mode: returns
+  /// the number of sent frames
+  int pushSerialData() {
+    int count = 0;
+    uint8_t buffer[512];
+    for (int no = 0; no < MAX_SERIAL; no++) {
+      if (!is_streaming[no] || p_serial[no] == nullptr) continue;
+      int available = p_serial[no]->available();
+      if (available <= 0) continue;
+      int n = p_serial[no]->readBytes(buffer,
+                                      min(available, (int)sizeof(buffer)));
+      if (n > 0) {
+        sendFrame(SerialData, no, buffer, n);
+        count++;
+      }
+    }
+    return count;
+  }
+
+  // I2C
+
+  void i2cBegin0() {
+    if (p_i2c) p_i2c->begin();
+  }
+
+  void i2cBegin1() {
+    uint8_t address = service.receive8();
+    if (p_i2c) p_i2c->begin(address);
+  }
+
+  void i2cEnd() {
+    if (p_i2c) p_i2c->end();
+  }
+
+  void i2cSetClock() {
+    uint32_t freq = service.receive32();
+    if (p_i2c) p_i2c->setClock(freq);
+  }
+
+  void i2cBeginTransmission() {
+    uint8_t address = service.receive8();
+    if (p_i2c) p_i2c->beginTransmission(address);
+  }
+
+  void i2cEndTransmission1() {
+    bool stop = service.receive8();
+    service.send((uint8_t)(p_i2c ? p_i2c->endTransmission(stop) : 0));
+  }
+
+  void i2cEndTransmission() {
+    service.send((uint8_t)(p_i2c ? p_i2c->endTransmission() : 0));
+  }
+
+  void i2cRequestFrom3() {
+    uint8_t address = service.receive8();
+    size_t len = service.receive64();
+    bool stop = service.receive8();
+    service.send((uint8_t)(p_i2c ? p_i2c->requestFrom(address, len, stop) : 0));
+  }
+
+  void i2cRequestFrom2() {
+    uint8_t address = service.receive8();
+    size_t len = service.receive64();
+    service.send((uint8_t)(p_i2c ? p_i2c->requestFrom(address, len) : 0));
+  }
+
+  void i2cWrite() {
+    uint8_t c = service.receive8();
+    service.send((uint16_t)(p_i2c ? p_i2c->write(c) : 0));
+  }
+
+  void i2cAvailable() {
+    service.send((uint16_t)(p_i2c ? p_i2c->available() : 0));
+  }
+
+  void i2cRead() { service.send((uint16_t)(p_i2c ? p_i2c->read() : -1)); }
+
+  void i2cPeek() { service.send((uint16_t)(p_i2c ? p_i2c->peek() : -1)); }
+
+  /// complete write transaction: address, stop bit, length and data
+  void i2cTransmission() {
+    uint8_t address = service.receive8();
+    bool stop = service.receive8();
+    uint16_t len = service.receive16();
+    payload.resize(len);
+    service.receive(payload.data(), len);
+    uint8_t result = 0;
+    if (p_i2c) {
+      p_i2c->beginTransmission(address);
+      p_i2c->write(payload.data(), len);
+      result = p_i2c->endTransmission(stop);
+    }
+    service.send(result);
+  }
+
+  /// complete read transaction which is optionally preceded by a write
+  /// without stop bit: the reply contains the length and the data
+  void i2cRequest() {
+    uint8_t address = service.receive8();
+    uint16_t len = service.receive16();
+    bool stop = service.receive8();
+    uint16_t write_len = service.receive16();
+    payload.resize(max((int)write_len, (int)len));
+    service.receive(payload.data(), write_len);
+    uint16_t n = 0;
+    if (p_i2c) {
+      bool ok = true;
+      if (write_len > 0) {
+        p_i2c->beginTransmission(address);
+        p_i2c->write(payload.data(), write_len);
+        ok = p_i2c->endTransmission(false) == 0;
+      }
+      if (ok) n = p_i2c->requestFrom(address, len, stop);
+      n = min(n, len);
+      for (int j = 0; j < n; j++) payload[j] = p_i2c->read();
+    }
+    service.send(n);
+    service.send(payload.data(), n);
+  }
+
+  // SPI
+
+  void spiTransfer() {
+    uint32_t count = service.receive32();
+    payload.resize(count);
+    service.receivePayload(PayloadSPI, payload.data(), count);
+    if (p_spi) {
+      p_spi->transfer(payload.data(), count);
+    } else {
+      memset(payload.data(), 0, count);
+    }
+    service.sendPayload(PayloadSPIReply, payload.data(), count);
+  }
+
+  void spiTransfer8() {
+    uint8_t data = service.receive8();
+    service.send((uint8_t)(p_spi ? p_spi->transfer(data) : 0));
+  }
+
+  void spiTransfer16() {
+    uint16_t data = service.receive16();
+    service.send((uint16_t)(p_spi ? p_spi->transfer16(data) : 0));
+  }
+
+  void spiUsingInterrupt() {
+    int no = (int32_t)service.receive32();
+    if (p_spi) p_spi->usingInterrupt(no);
+  }
+
+  void spiNotUsingInterrupt() {
+    int no = (int32_t)service.receive32();
+    if (p_spi) p_spi->notUsingInterrupt(no);
+  }
+
+  void spiBeginTransaction() {
+    uint32_t clock = service.receive32();
+    BitOrder order = (BitOrder)service.receive8();
+    SPIMode mode = (SPIMode)service.receive8();
+    if (p_spi) p_spi->beginTransaction(SPISettings(clock, order, mode));
+  }
+
+  void spiEndTransaction() {
+    if (p_spi) p_spi->endTransaction();
+  }
+
+  void spiAttachInterrupt() {
+    if (p_spi) p_spi->attachInterrupt();
+  }
+
+  void spiDetachInterrupt() {
+    if (p_spi) p_spi->detachInterrupt();
+  }
+
+  void spiBegin() {
+    if (p_spi) p_spi->begin();
+  }
+
+  void spiEnd() {
+    if (p_spi) p_spi->end();
+  }
+
+  // GPIO: RemoteGPIO sends the pin and mode of pinMode() as 32 bit values
+
+  void gpioPinMode() {
+    pin_size_t pin = (int32_t)service.receive32();
+    PinMode mode = (PinMode)(int32_t)service.receive32();
+    if (p_gpio) p_gpio->pinMode(pin, mode);
+  }
+
+  void gpioDigitalWrite() {
+    pin_size_t pin = service.receive8();
+    PinStatus status = (PinStatus)service.receive8();
+    if (p_gpio) p_gpio->digitalWrite(pin, status);
+  }
+
+  void gpioDigitalRead() {
+    pin_size_t pin = service.receive8();
+    service.send((uint8_t)(p_gpio ? p_gpio->digitalRead(pin) : 0));
+  }
+
+  void gpioAnalogRead() {
+    pin_size_t pin = service.receive8();
+    service.send((uint16_t)(p_gpio ? p_gpio->analogRead(pin) : 0));
+  }
+
+  void gpioAnalogReference() {
+    uint8_t mode = service.receive8();
+    if (p_gpio) p_gpio->analogReference(mode);
+  }
+
+  void gpioAnalogWrite() {
+    pin_size_t pin = service.receive8();
+    int value = (int32_t)service.receive32();
+    if (p_gpio) p_gpio->analogWrite(pin, value);
+  }
+
+  void gpioTone() {
+    uint8_t pin = service.receive8();
+    unsigned int frequency = service.receive32();
+    unsigned long duration = service.receive64();
+    if (p_gpio) p_gpio->tone(pin, frequency, duration);
+  }
+
+  void gpioNoTone() {
+    uint8_t pin = service.receive8();
+    if (p_gpio) p_gpio->noTone(pin);
+  }
+
+  void gpioPulseIn() {
+    uint8_t pin = service.receive8();
+    uint8_t state = service.receive8();
+    unsigned long timeout = service.receive64();
+    service.send((uint64_t)(p_gpio ? p_gpio->pulseIn(pin, state, timeout) : 0));
+  }
+
+  void gpioPulseInLong() {
+    uint8_t pin = service.receive8();
+    uint8_t state = service.receive8();
+    unsigned long timeout = service.receive64();
+    service.send(
+        (uint64_t)(p_gpio ? p_gpio->pulseInLong(pin, state, timeout) : 0));
+  }
+
+  void gpioAnalogWriteFrequency() {
+    pin_size_t pin = service.receive8();
+    uint32_t freq = service.receive32();
+    if (p_gpio) p_gpio->analogWriteFrequency(pin, freq);
+  }
+
+  void gpioAnalogWriteResolution() {
+    uint8_t bits = service.receive8();
+    if (p_gpio) p_gpio->analogWriteResolution(bits);
+  }
+
+  // Serial
+
+  void serialBegin() {
+    HardwareSerial* p_port = serial(service.receive8());
+    unsigned long baudrate = service.receive64();
+    if (p_port) p_port->begin(baudrate);
+  }
+
+  void serialEnd() {
+    HardwareSerial* p_port = serial(service.receive8());
+    if (p_port) p_port->end();
+  }
+
+  void serialWrite() {
+    uint8_t no = service.receive8();
+    HardwareSerial* p_port = serial(no);
+    uint64_t len = service.receive64();
+    payload.resize(len);
+    service.receivePayload(PayloadSerial, payload.data(), len);
+    size_t result = p_port ? p_port->write(payload.data(), len) : 0;
+    if (no < MAX_SERIAL && is_streaming[no]) {
+      // confirm the data, so that the client can send more
+      sendFrame(SerialAck, no, nullptr, len);
+    } else {
+      service.send((uint16_t)result);
+    }
+  }
+
+  /// replies with the length and the data which is available (max len
+  /// bytes)
+  void serialRead() {
+    HardwareSerial* p_port = serial(service.receive8());
+    uint64_t len = service.receive64();
+    uint8_t buffer[512];
+    int available = p_port ? p_port->available() : 0;
+    size_t n = min((uint64_t)max(available, 0),
+                   min(len, (uint64_t)sizeof(buffer)));
+    n = p_port && n > 0 ? p_port->readBytes(buffer, n) : 0;
+    service.send((uint16_t)n);
+    service.send(buffer, n);
+  }
+
+  void serialAvailable() {
+    HardwareSerial* p_port = serial(service.receive8());
+    service.send((uint16_t)(p_port ? p_port->available() : 0));
+  }
+
+  /// RemoteSerialClass does not send the port number
+  void serialPeek() {
+    HardwareSerial* p_port = serial(0);
+    service.send((uint16_t)(p_port ? p_port->peek() : -1));
+  }
+
+  void serialFlush() {
+    HardwareSerial* p_port = serial(service.receive8());
+    if (p_port) p_port->flush();
+  }
+
+  /// activates the streaming mode: the replies are sent as frames and the
+  /// received data is pushed to the client. The reply is a frame as well (the
+  /// length contains the status), because data frames might precede it.
+  void serialStreaming() {
+    uint8_t no = service.receive8();
+    bool active = service.receive8();
+    bool ok = no < MAX_SERIAL;
+    if (ok) is_streaming[no] = active;
+    sendFrame(SerialStreaming, no, nullptr, ok);
+  }
+
+  // Protocol
+
+  /// activates the payload codec which was requested by the client
+  void serviceSetCodec() {
+    uint8_t channel = service.receive8();
+    bool active = service.receive8();
+    uint32_t threshold = service.receive32();
+    bool ok = channel < PayloadChannelCount;
+    if (ok) service.setCodec((PayloadChannel)channel, active, threshold);
+    service.send((uint8_t)ok);
+  }
+
+  /// confirms the supported protocol extensions
+  void serviceFeature() {
+    uint8_t feature = service.receive8();
+    service.send((uint8_t)(feature == FeatureI2cTransactions));
+  }
+};
+
+}  // namespace arduino
@@ -18,7 +18,6 @@
 */
 
 #pragma once
-#include <exception>
 #include "ArduinoLogger.h"
 #include "GPIOWrapper.h"
 #include "I2CWrapper.h"
@@ -26,6 +25,8 @@
 #include "RemoteI2C.h"
 #include "RemoteSPI.h"
 #include "SPIWrapper.h"
+#include "SharedMemoryStream.h"
+#include "SocketStream.h"
 #include "WiFiUdpStream.h"
 
 namespace arduino {
@@ -39,7 +40,8 @@ namespace arduino {
  * stream, perform handshakes with remote devices, and manage the lifecycle of hardware connections.
  *
  * Key features:
- * - Supports initialization via a stream or UDP port.
+ * - Supports initialization via a stream, UDP port, TCP port, unix domain
+ *   socket or shared memory.
  * - Assigns remote protocol handlers (I2C, SPI, GPIO) to the provided stream.
  * - Optionally sets up global protocol objects for use throughout the application.
  * - Performs handshake with remote devices to ensure connectivity.
@@ -60,8 +62,14 @@ class HardwareSetupRemote : public I2CSource,
   /// default constructor: you need to call begin() afterwards
   HardwareSetupRemote() = default;
 
-  /// HardwareSetup uses the indicated stream
-  HardwareSetupRemote(Stream& stream) { begin(&stream, false); }
+  /// HardwareSetup uses the indicated stream: the handshake gives up after
+  /// the indicated time; check the result with isConnected()
+  HardwareSetupRemote(Stream& stream, unsigned long handShakeTimeoutMs = 5000) {
+    handshake_timeout_ms = handShakeTimeoutMs;
+    if (!begin(&stream, false)) {
+      Logger.error("HardwareSetup", "device not connected");
+    }
+  }
 
   /// HardwareSetup that uses udp
   HardwareSetupRemote(int port) { this->port = port; }
@@ -82,10 +90,11 @@ class HardwareSetupRemote : public I2CSource,
       GPIO.setGPIO(&gpio);
     }
 
-    if (doHandShake) {
-      handShake(s);
-    }
-    return i2c && spi && gpio;
+    if (doHandShake && !(handShake(s) && confirmHandShake(s))) return false;
+    // devices which confirm with SYNC support the I2C transactions
+    i2c.setTransactions(is_synced);
+    is_connected = i2c && spi && gpio;
+    return is_connected;
   }
 
   /// start with udp on the indicatd port
@@ -99,19 +108,59 @@ class HardwareSetupRemote : public I2CSource,
     is_default_objects_active = asDefault;
     if (p_stream == nullptr) {
       default_stream.begin(port);
-      handShake(&default_stream);
+      if (!handShake(&default_stream)) return;
       IPAddress ip = default_stream.remoteIP();
       int remote_port = default_stream.remotePort();
       default_stream.setTarget(ip, remote_port);
-      default_stream.write((const uint8_t*)"OK", 2);
-      default_stream.flush();
+      if (!confirmHandShake(&default_stream)) return;
       begin(&default_stream, asDefault, false);
     } else {
       begin(p_stream, asDefault, true);
     }
   }
 
+  /// start with a TCP server on the indicated port: the device connects to it
+  bool beginTCP(int port, bool asDefault = true) {
+    Logger.warning("HardwareSetup", "waiting for TCP connection...");
+    if (!socket_stream.listenTCP(port)) return false;
+    return beginSocket(asDefault);
+  }
+
+  /// start with a unix domain socket server: e.g. for a device simulator
+  /// which is running on the same host
+  bool beginUnix(const char* path, bool asDefault = true) {
+    Logger.warning("HardwareSetup", "waiting for connection on", path);
+    if (!socket_stream.listenUnix(path)) return false;
+    return beginSocket(asDefault);
+  }
+
+  /// start with a shared memory stream which is opened by a device simulator
+  /// that is running on the same host. With replaceStale an existing segment
+  /// (e.g. of a crashed run) is replaced.
+  bool beginSharedMemory(const char* name, bool asDefault = true,
+                         bool replaceStale = false) {
+    Logger.warning("HardwareSetup", "waiting for device on", name);
+    if (!shm_stream.create(name, 64 * 1024, replaceStale)) return false;
+    is_default_objects_active = asDefault;
+    if (!handShake(&shm_stream) || !confirmHandShake(&shm_stream)) {
+      return false;
+    }
+    return begin(&shm_stream, asDefault, false);
+  }
+
+  /// activates the reliable mode of the default udp stream: the device must
+  /// use it as well. Call it before begin().
+  void setReliable(bool active) { default_stream.setReliable(active); }
+
+  /// Defines the max time in ms to wait for the device in begin() (0 = wait
+  /// forever)
+  void setHandShakeTimeout(unsigned long ms) { handshake_timeout_ms = ms; }
+
+  /// true when the handshake with the device has succeeded
+  bool isConnected() { return is_connected; }
+
   void end() {
+    is_connected = false;
     if (is_default_objects_active) {
       GPIO.setGPIO(nullptr);
       SPI.setSPI(nullptr);
@@ -120,6 +169,12 @@ class HardwareSetupRemote : public I2CSource,
     if (p_stream == &default_stream) {
       default_stream.stop();
     }
+    if (p_stream == &socket_stream) {
+      socket_stream.end();
+    }
+    if (p_stream == &shm_stream) {
+      shm_stream.end();
+    }
   }
 
   HardwareGPIO* getGPIO() { return &gpio; }
@@ -128,34 +183,130 @@ class HardwareSetupRemote : public I2CSource,
 
  protected:
   WiFiUDPStream default_stream;
+  SocketStream socket_stream;
+  SharedMemoryStream shm_stream;
   Stream* p_stream = nullptr;
   RemoteI2C i2c;
   RemoteSPI spi;
   RemoteGPIO gpio;
   int port;
   bool is_default_objects_active = false;
+  unsigned long handshake_timeout_ms = 0;
+  bool is_connected = false;
+  bool is_synced = false;
+  /// max time between two banners of the device
+  static constexpr unsigned long BANNER_INTERVAL_MS = 1000;
 
-  void handShake(Stream* s) {
-    while (true) {
-      Logger.warning("HardwareSetup", "waiting for device...");
-      try {
-        // we wait for the Arduino to send us the Arduino-Emulator string
-        if (s->available() >= 16) {
-          char buffer[30];
-          int len = s->readBytes(buffer, 18);
-          buffer[len] = 0;
-          if (strncmp(buffer, "Arduino-Emulator", 16)==0) {
-            Logger.info("WiFiUDPStream", "device found!");
-            break;
-          } else {
-            Logger.info("WiFiUDPStream", "unknown command", buffer);
-          }
+  bool beginSocket(bool asDefault) {
+    is_default_objects_active = asDefault;
+    if (!handShake(&socket_stream) || !confirmHandShake(&socket_stream)) {
+      socket_stream.end();
+      return false;
+    }
+    return begin(&socket_stream, asDefault, false);
+  }
+
+  /// we wait for the Arduino to send us the Arduino-Emulator string: we
+  /// return true as soon as it has arrived and false if the connection was
+  /// closed or the handshake timeout has elapsed
+  bool handShake(Stream* s) {
+    const char* banner = "Arduino-Emulator";
+    const int banner_len = strlen(banner);
+    int matched = 0;
+    is_connected = false;
+    is_synced = false;
+    unsigned long start = millis();
+    unsigned long last_log = start;
+    Logger.warning("HardwareSetup", "waiting for device...");
+    while (matched < banner_len) {
+      int ch = s->read();
+      if (ch < 0) {
+        if (!waitForData(s)) {
+          Logger.error("HardwareSetup", "connection closed by device");
+          return false;
+        }
+        if (handshake_timeout_ms > 0 &&
+            millis() - start > handshake_timeout_ms) {
+          Logger.error("HardwareSetup", "no response from device");
+          return false;
         }
-        delay(10000);
-      } catch (const std::exception& ex) {
-        Logger.error("WiFiUDPStream", ex.what());
+        if (millis() - last_log > 10000) {
+          Logger.warning("HardwareSetup", "waiting for device...");
+          last_log = millis();
+        }
+        continue;
+      }
+      if (ch == banner[matched]) {
+        matched++;
+      } else {
+        matched = (ch == banner[0]) ? 1 : 0;
       }
     }
+    // skip the optional line end
+    while (s->peek() == '\r' || s->peek() == '\n') s->read();
+    Logger.info("HardwareSetup", "device found!");
+    return true;
+  }
+
+  /// answers the banner with "OK" and waits for the "SYNC" of the device: the
+  /// banners which it has repeated in the meantime are skipped, so that they
+  /// can not be mistaken for the first reply. A device which does not send
+  /// the marker is accepted when it has been silent for longer than its
+  /// banner interval.
+  bool confirmHandShake(Stream* s) {
+    // drop the banners that have already arrived
+    while (s->available() > 0) s->read();
+    s->write((const uint8_t*)"OK", 2);
+    s->flush();
+    const char* marker = "SYNC\n";
+    const int marker_len = strlen(marker);
+    int matched = 0;
+    unsigned long start = millis();
+    unsigned long last_data = start;
+    while (matched < marker_len) {
+      int ch = s->read();
+      if (ch < 0) {
+        if (!waitForData(s)) {
+          Logger.error("HardwareSetup", "connection closed by device");
+          return false;
+        }
+        if (matched == 0 && millis() - last_data > BANNER_INTERVAL_MS + 100) {
+          Logger.warning("HardwareSetup", "device did not confirm with SYNC");
+          return true;
+        }
+        // give an old device the chance to fall silent
+        if (handshake_timeout_ms > 0 &&
+            millis() - start >
+                max(handshake_timeout_ms, 2 * BANNER_INTERVAL_MS)) {
+          Logger.error("HardwareSetup", "no SYNC from device");
+          return false;
+        }
+        continue;
+      }
+      last_data = millis();
+      if (ch == marker[matched]) {
+        matched++;
+      } else {
+        matched = (ch == marker[0]) ? 1 : 0;
+      }
+    }
+    is_synced = true;
+    return true;
+  }
+
+  /// blocks until data is available if the stream supports this: returns
+  /// false if the connection has been closed
+  bool waitForData(Stream* s) {
+    if (s == &socket_stream) {
+      socket_stream.waitReadable(100);
+      return (bool)socket_stream;
+    } else if (s == &shm_stream) {
+      shm_stream.waitReadable(100);
+      return (bool)shm_stream;
+    } else {
+      delay(1);
+    }
+    return true;
   }
 };
 
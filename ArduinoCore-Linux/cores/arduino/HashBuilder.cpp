@@ -0,0 +1,170 @@
+/*
+  HashBuilder.cpp
+  Copyright (c) 2025 Phil Schatzmann. All right reserved.
+
+  This library is free software; you can redistribute it and/or
+  modify it under the terms of the GNU Lesser General Public
+  License as published by the Free Software Foundation; either
+  version 2.1 of the License, or (at your option) any later version.
+
+  This library is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+  Lesser General Public License for more details.
+
+  You should have received a copy of the GNU Lesser General Public
+  License along with this library; if not, write to the Free Software
+  Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA 02110-1301 USA
+*/
+
+#include <Arduino.h>
+#include <HashBuilder.h>
+#if defined(__x86_64__) || defined(__i386__)
+#include <cpuid.h>
+#endif
+
+/*
+ * Add some amount of input to the context
+ *
+ * Complete blocks are hashed directly from the input, only the rest is
+ * copied into _input.
+ */
+void HashBuilder::add(const uint8_t * data, const size_t len) {
+    size_t offset = _size % BLOCK_SIZE;
+    size_t remaining = len;
+    _size += len;
+
+    // complete the pending block
+    if (offset > 0) {
+        size_t n = BLOCK_SIZE - offset;
+        if (n > remaining) {
+            n = remaining;
+        }
+        memcpy(_input + offset, data, n);
+        data += n;
+        remaining -= n;
+        if (offset + n < BLOCK_SIZE) {
+            return;
+        }
+        processBlocks(_input, 1);
+    }
+
+    size_t blocks = remaining / BLOCK_SIZE;
+    if (blocks > 0) {
+        processBlocks(data, blocks);
+        data += blocks * BLOCK_SIZE;
+        remaining -= blocks * BLOCK_SIZE;
+    }
+    memcpy(_input, data, remaining);
+}
+
+static bool hex_char_to_nibble(uint8_t c, uint8_t& nibble) {
+    if (c >= 'a' && c <= 'f') {
+        nibble = c - ((uint8_t)'a' - 0xA);
+        return true;
+    }
+    if (c >= 'A' && c <= 'F') {
+        nibble = c - ((uint8_t)'A' - 0xA);
+        return true;
+    }
+    if (c >= '0' && c <= '9') {
+        nibble = c - (uint8_t)'0';
+        return true;
+    }
+    return false;
+}
+
+void HashBuilder::addHexString(const char * data) {
+    size_t len = strlen(data);
+
+    // Require an even number of hex characters; odd lengths cannot form full bytes.
+    if ((len == 0) || (len % 2 != 0)) {
+        return;
+    }
+
+    constexpr size_t chunk_size = 64;
+    uint8_t tmp[chunk_size];
+    size_t byte_count = len / 2;
+
+    for (size_t processed = 0; processed < byte_count;) {
+        size_t remaining = byte_count - processed;
+        size_t this_chunk = (remaining > chunk_size) ? chunk_size : remaining;
+
+        for (size_t i = 0; i < this_chunk; ++i) {
+            size_t hex_index = (processed + i) * 2;
+            uint8_t high;
+            uint8_t low;
+
+            if (!hex_char_to_nibble(static_cast<uint8_t>(data[hex_index]), high) ||
+                !hex_char_to_nibble(static_cast<uint8_t>(data[hex_index + 1]), low)) {
+                return;
+            }
+
+            tmp[i] = static_cast<uint8_t>((high << 4) | low);
+        }
+
+        add(tmp, this_chunk);
+        processed += this_chunk;
+    }
+}
+
+/*
+ * Pad the current input so its length is congruent to 56 bytes modulo 64,
+ * then append the size in bits and process the last block(s).
+ */
+void HashBuilder::addPadding(bool bigEndianSize) {
+    uint64_t bit_length = _size * 8ULL;
+    size_t offset = _size % BLOCK_SIZE;
+
+    _input[offset++] = 0x80;
+    if (offset > BLOCK_SIZE - 8) {
+        memset(_input + offset, 0, BLOCK_SIZE - offset);
+        processBlocks(_input, 1);
+        offset = 0;
+    }
+    memset(_input + offset, 0, BLOCK_SIZE - 8 - offset);
+    for (unsigned int i = 0; i < 8; ++i) {
+        unsigned int shift = bigEndianSize ? (56 - i * 8) : (i * 8);
+        _input[BLOCK_SIZE - 8 + i] = (uint8_t)(bit_length >> shift);
+    }
+    processBlocks(_input, 1);
+}
+
+void HashBuilder::getBytes(uint8_t * output) const {
+    memcpy(output, _digest, _hash_size);
+}
+
+void HashBuilder::getChars(char * output) const {
+    static const char hex[] = "0123456789abcdef";
+    for (size_t i = 0; i < _hash_size; i++) {
+        output[i * 2] = hex[_digest[i] >> 4];
+        output[i * 2 + 1] = hex[_digest[i] & 0xF];
+    }
+    output[_hash_size * 2] = 0;
+}
+
+String HashBuilder::toString(void) const {
+    char out[65];
+    getChars(out);
+    return String(out);
+}
+
+bool HashBuilder::hasSHAExtensions(void) {
+#if (defined(__x86_64__) || defined(__i386__)) && defined(__GNUC__)
+    static const bool result = [] {
+        unsigned int eax, ebx, ecx, edx;
+        if (!__get_cpuid(1, &eax, &ebx, &ecx, &edx) || !(ecx & bit_SSE4_1)) {
+            return false;
+        }
+        if (!__get_cpuid_count(7, 0, &eax, &ebx, &ecx, &edx)) {
+            return false;
+        }
+        return (ebx & (1u << 29)) != 0;
+    }();
+    return result;
+#elif defined(__ARM_FEATURE_SHA2) || defined(__ARM_FEATURE_CRYPTO)
+    return true;
+#else
+    return false;
+#endif
+}
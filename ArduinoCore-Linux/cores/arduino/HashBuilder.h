@@ -0,0 +1,137 @@
+/*
+  HashBuilder.h
+  Copyright (c) 2025 Phil Schatzmann. All right reserved.
+
+  This library is free software; you can redistribute it and/or
+  modify it under the terms of the GNU Lesser General Public
+  License as published by the Free Software Foundation; either
+  version 2.1 of the License, or (at your option) any later version.
+
+  This library is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+  Lesser General Public License for more details.
+
+  You should have received a copy of the GNU Lesser General Public
+  License along with this library; if not, write to the Free Software
+  Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA 02110-1301 USA
+*/
+
+#pragma once
+
+#include <api/String.h>
+#include <Stream.h>
+#include <cstring>
+#include <memory>
+#include <new>
+
+/**
+ * @brief Common API of MD5Builder, SHA1Builder and SHA256Builder: all of them
+ * process the input in blocks of 64 bytes.
+ *
+ * add() only copies the data of an incomplete block: all complete blocks are
+ * hashed directly from the caller's buffer, so large buffers should be passed
+ * in one call.
+ */
+class HashBuilder {
+public:
+    /// Size of the blocks which are processed by the hash function
+    static constexpr size_t BLOCK_SIZE = 64;
+    /// Size of the chunks which are read by addStream()
+    static constexpr size_t STREAM_CHUNK_SIZE = 64 * 1024;
+
+    virtual ~HashBuilder() = default;
+
+    /// Resets the state: must be called before adding data
+    virtual void begin(void) = 0;
+
+    void add(const uint8_t * data, const size_t len);
+    void add(const char * data) {
+        add((const uint8_t*)data, strlen(data));
+    }
+    void add(char * data) {
+        add((const char*)data);
+    }
+    void add(const String& data) {
+        add(data.c_str());
+    }
+    void addHexString(const char * data);
+    void addHexString(char * data) {
+        addHexString((const char*)data);
+    }
+    void addHexString(const String& data) {
+        addHexString(data.c_str());
+    }
+
+    /**
+     * @brief Adds the available data of the stream (max maxLen bytes). The
+     * data is read in chunks of 64 KB with the readBytes() of the actual
+     * class, so that e.g. an SD File can provide the data with a single read.
+     * @return false if the buffer could not be allocated or the read failed
+     */
+    template <class T>
+    bool addStream(T & stream, const size_t maxLen) {
+        size_t maxLengthLeft = maxLen;
+        size_t bytesAvailable = stream.available();
+        if (bytesAvailable == 0 || maxLengthLeft == 0) {
+            return true;
+        }
+
+        size_t buf_size = maxLengthLeft < STREAM_CHUNK_SIZE ? maxLengthLeft : STREAM_CHUNK_SIZE;
+        auto buf = std::unique_ptr<uint8_t[]> {new (std::nothrow) uint8_t[buf_size]};
+        if (!buf) {
+            return false;
+        }
+
+        while ((bytesAvailable > 0) && (maxLengthLeft > 0)) {
+            // determine number of bytes to read
+            size_t readBytes = bytesAvailable;
+            if (readBytes > maxLengthLeft) {
+                readBytes = maxLengthLeft;    // read only until max_len
+            }
+            if (readBytes > buf_size) {
+                readBytes = buf_size;    // not read more the buffer can handle
+            }
+
+            // read data and check if we got something
+            size_t numBytesRead = stream.readBytes(buf.get(), readBytes);
+            if (numBytesRead < 1) {
+                return false;
+            }
+
+            add(buf.get(), numBytesRead);
+
+            maxLengthLeft -= numBytesRead;
+            bytesAvailable = stream.available();
+        }
+        return true;
+    }
+
+    /// Processes the padding: the result is available with getBytes() etc.
+    virtual void calculate(void) = 0;
+    void getBytes(uint8_t * output) const;
+    void getChars(char * output) const;
+    String toString(void) const;
+    /// Size of the digest in bytes
+    size_t getHashSize(void) const {
+        return _hash_size;
+    }
+
+protected:
+    uint64_t _size = 0;      // Size of input in bytes
+    uint8_t _input[BLOCK_SIZE]; // Incomplete block
+    uint8_t _digest[32];     // Result of algorithm
+    size_t _hash_size;
+
+    HashBuilder(size_t hashSize) : _hash_size(hashSize) {}
+
+    /// Hashes the indicated number of complete blocks
+    virtual void processBlocks(const uint8_t * data, size_t blocks) = 0;
+
+    /// Adds the padding and the size in bits (little or big endian)
+    void addPadding(bool bigEndianSize);
+
+    /// Determines if the CPU supports SHA-NI (x86) or the ARMv8 SHA
+    /// instructions
+    static bool hasSHAExtensions(void);
+};
@@ -24,7 +24,6 @@
 
 #include <Arduino.h>
 #include <MD5Builder.h>
-#include <memory>
 
 /*
  * Constants defined by the MD5 algorithm
@@ -34,153 +33,149 @@
 #define C 0x98badcfe
 #define D 0x10325476
 
-static uint32_t S[] = {7, 12, 17, 22, 7, 12, 17, 22, 7, 12, 17, 22, 7, 12, 17, 22,
-                       5,  9, 14, 20, 5,  9, 14, 20, 5,  9, 14, 20, 5,  9, 14, 20,
-                       4, 11, 16, 23, 4, 11, 16, 23, 4, 11, 16, 23, 4, 11, 16, 23,
-                       6, 10, 15, 21, 6, 10, 15, 21, 6, 10, 15, 21, 6, 10, 15, 21};
-
-static uint32_t K[] = {0xd76aa478, 0xe8c7b756, 0x242070db, 0xc1bdceee,
-                       0xf57c0faf, 0x4787c62a, 0xa8304613, 0xfd469501,
-                       0x698098d8, 0x8b44f7af, 0xffff5bb1, 0x895cd7be,
-                       0x6b901122, 0xfd987193, 0xa679438e, 0x49b40821,
-                       0xf61e2562, 0xc040b340, 0x265e5a51, 0xe9b6c7aa,
-                       0xd62f105d, 0x02441453, 0xd8a1e681, 0xe7d3fbc8,
-                       0x21e1cde6, 0xc33707d6, 0xf4d50d87, 0x455a14ed,
-                       0xa9e3e905, 0xfcefa3f8, 0x676f02d9, 0x8d2a4c8a,
-                       0xfffa3942, 0x8771f681, 0x6d9d6122, 0xfde5380c,
-                       0xa4beea44, 0x4bdecfa9, 0xf6bb4b60, 0xbebfbc70,
-                       0x289b7ec6, 0xeaa127fa, 0xd4ef3085, 0x04881d05,
-                       0xd9d4d039, 0xe6db99e5, 0x1fa27cf8, 0xc4ac5665,
-                       0xf4292244, 0x432aff97, 0xab9423a7, 0xfc93a039,
-                       0x655b59c3, 0x8f0ccc92, 0xffeff47d, 0x85845dd1,
-                       0x6fa87e4f, 0xfe2ce6e0, 0xa3014314, 0x4e0811a1,
-                       0xf7537e82, 0xbd3af235, 0x2ad7d2bb, 0xeb86d391};
+static const uint32_t K[] = {0xd76aa478, 0xe8c7b756, 0x242070db, 0xc1bdceee,
+                             0xf57c0faf, 0x4787c62a, 0xa8304613, 0xfd469501,
+                             0x698098d8, 0x8b44f7af, 0xffff5bb1, 0x895cd7be,
+                             0x6b901122, 0xfd987193, 0xa679438e, 0x49b40821,
+                             0xf61e2562, 0xc040b340, 0x265e5a51, 0xe9b6c7aa,
+                             0xd62f105d, 0x02441453, 0xd8a1e681, 0xe7d3fbc8,
+                             0x21e1cde6, 0xc33707d6, 0xf4d50d87, 0x455a14ed,
+                             0xa9e3e905, 0xfcefa3f8, 0x676f02d9, 0x8d2a4c8a,
+                             0xfffa3942, 0x8771f681, 0x6d9d6122, 0xfde5380c,
+                             0xa4beea44, 0x4bdecfa9, 0xf6bb4b60, 0xbebfbc70,
+                             0x289b7ec6, 0xeaa127fa, 0xd4ef3085, 0x04881d05,
+                             0xd9d4d039, 0xe6db99e5, 0x1fa27cf8, 0xc4ac5665,
+                             0xf4292244, 0x432aff97, 0xab9423a7, 0xfc93a039,
+                             0x655b59c3, 0x8f0ccc92, 0xffeff47d, 0x85845dd1,
+                             0x6fa87e4f, 0xfe2ce6e0, 0xa3014314, 0x4e0811a1,
+                             0xf7537e82, 0xbd3af235, 0x2ad7d2bb, 0xeb86d391};
 
 /*
- * Padding used to make the size (in bits) of the input congruent to 448 mod 512
- */
-static uint8_t PADDING[] = {0x80, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
-                            0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
-                            0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
-                            0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
-                            0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
-                            0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
-                            0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
-                            0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00};
-
-/*
- * Bit-manipulation functions defined by the MD5 algorithm
+ * Bit-manipulation functions defined by the MD5 algorithm: they are written
+ * with operators only, so that they can be used for uint32_t and for the
+ * SIMD vectors of the multi buffer version.
  */
 #ifdef F
 #undef F
 #endif
-#define F(X, Y, Z) ((X & Y) | (~X & Z))
-#define G(X, Y, Z) ((X & Z) | (Y & ~Z))
+#define F(X, Y, Z) (Z ^ (X & (Y ^ Z)))
+#define G(X, Y, Z) (Y ^ (Z & (X ^ Y)))
 #define H(X, Y, Z) (X ^ Y ^ Z)
 #define I(X, Y, Z) (Y ^ (X | ~Z))
 
+#define MD5_STEP(f, a, b, c, d, x, i, s) \
+    a += f(b, c, d) + x + K[i];          \
+    a = ((a << s) | (a >> (32 - s))) + b;
+
 /*
- * Rotates a 32-bit word left by n bits
+ * Reads a little-endian 32-bit word
  */
-static inline uint32_t rotateLeft(uint32_t x, uint32_t n){
-    return (x << n) | (x >> (32 - n));
+static inline uint32_t load32le(const uint8_t *p) {
+    uint32_t result;
+    memcpy(&result, p, 4);
+#if __BYTE_ORDER__ == __ORDER_BIG_ENDIAN__
+    result = __builtin_bswap32(result);
+#endif
+    return result;
 }
 
 /*
- * Step on 512 bits of input with the main MD5 algorithm.
+ * The 64 steps of MD5 on 512 bits of input (fully unrolled)
  */
-static void md5Step(uint32_t *buffer, uint32_t *input){
-    uint32_t AA = buffer[0];
-    uint32_t BB = buffer[1];
-    uint32_t CC = buffer[2];
-    uint32_t DD = buffer[3];
-
-    uint32_t E;
-
-    unsigned int j;
-
-    for(unsigned int i = 0; i < 64; ++i){
-        switch(i / 16){
-            case 0:
-                E = F(BB, CC, DD);
-                j = i;
-                break;
-            case 1:
-                E = G(BB, CC, DD);
-                j = ((i * 5) + 1) % 16;
-                break;
-            case 2:
-                E = H(BB, CC, DD);
-                j = ((i * 3) + 5) % 16;
-                break;
-            default:
-                E = I(BB, CC, DD);
-                j = (i * 7) % 16;
-                break;
-        }
-
-        uint32_t temp = DD;
-        DD = CC;
-        CC = BB;
-        BB = BB + rotateLeft(AA + E + K[i] + input[j], S[i]);
-        AA = temp;
-    }
-
-    buffer[0] += AA;
-    buffer[1] += BB;
-    buffer[2] += CC;
-    buffer[3] += DD;
+template <class T>
+static inline __attribute__((always_inline)) void md5Rounds(T &a, T &b, T &c, T &d, const T x[16]) {
+    MD5_STEP(F, a, b, c, d, x[0], 0, 7)
+    MD5_STEP(F, d, a, b, c, x[1], 1, 12)
+    MD5_STEP(F, c, d, a, b, x[2], 2, 17)
+    MD5_STEP(F, b, c, d, a, x[3], 3, 22)
+    MD5_STEP(F, a, b, c, d, x[4], 4, 7)
+    MD5_STEP(F, d, a, b, c, x[5], 5, 12)
+    MD5_STEP(F, c, d, a, b, x[6], 6, 17)
+    MD5_STEP(F, b, c, d, a, x[7], 7, 22)
+    MD5_STEP(F, a, b, c, d, x[8], 8, 7)
+    MD5_STEP(F, d, a, b, c, x[9], 9, 12)
+    MD5_STEP(F, c, d, a, b, x[10], 10, 17)
+    MD5_STEP(F, b, c, d, a, x[11], 11, 22)
+    MD5_STEP(F, a, b, c, d, x[12], 12, 7)
+    MD5_STEP(F, d, a, b, c, x[13], 13, 12)
+    MD5_STEP(F, c, d, a, b, x[14], 14, 17)
+    MD5_STEP(F, b, c, d, a, x[15], 15, 22)
+
+    MD5_STEP(G, a, b, c, d, x[1], 16, 5)
+    MD5_STEP(G, d, a, b, c, x[6], 17, 9)
+    MD5_STEP(G, c, d, a, b, x[11], 18, 14)
+    MD5_STEP(G, b, c, d, a, x[0], 19, 20)
+    MD5_STEP(G, a, b, c, d, x[5], 20, 5)
+    MD5_STEP(G, d, a, b, c, x[10], 21, 9)
+    MD5_STEP(G, c, d, a, b, x[15], 22, 14)
+    MD5_STEP(G, b, c, d, a, x[4], 23, 20)
+    MD5_STEP(G, a, b, c, d, x[9], 24, 5)
+    MD5_STEP(G, d, a, b, c, x[14], 25, 9)
+    MD5_STEP(G, c, d, a, b, x[3], 26, 14)
+    MD5_STEP(G, b, c, d, a, x[8], 27, 20)
+    MD5_STEP(G, a, b, c, d, x[13], 28, 5)
+    MD5_STEP(G, d, a, b, c, x[2], 29, 9)
+    MD5_STEP(G, c, d, a, b, x[7], 30, 14)
+    MD5_STEP(G, b, c, d, a, x[12], 31, 20)
+
+    MD5_STEP(H, a, b, c, d, x[5], 32, 4)
+    MD5_STEP(H, d, a, b, c, x[8], 33, 11)
+    MD5_STEP(H, c, d, a, b, x[11], 34, 16)
+    MD5_STEP(H, b, c, d, a, x[14], 35, 23)
+    MD5_STEP(H, a, b, c, d, x[1], 36, 4)
+    MD5_STEP(H, d, a, b, c, x[4], 37, 11)
+    MD5_STEP(H, c, d, a, b, x[7], 38, 16)
+    MD5_STEP(H, b, c, d, a, x[10], 39, 23)
+    MD5_STEP(H, a, b, c, d, x[13], 40, 4)
+    MD5_STEP(H, d, a, b, c, x[0], 41, 11)
+    MD5_STEP(H, c, d, a, b, x[3], 42, 16)
+    MD5_STEP(H, b, c, d, a, x[6], 43, 23)
+    MD5_STEP(H, a, b, c, d, x[9], 44, 4)
+    MD5_STEP(H, d, a, b, c, x[12], 45, 11)
+    MD5_STEP(H, c, d, a, b, x[15], 46, 16)
+    MD5_STEP(H, b, c, d, a, x[2], 47, 23)
+
+    MD5_STEP(I, a, b, c, d, x[0], 48, 6)
+    MD5_STEP(I, d, a, b, c, x[7], 49, 10)
+    MD5_STEP(I, c, d, a, b, x[14], 50, 15)
+    MD5_STEP(I, b, c, d, a, x[5], 51, 21)
+    MD5_STEP(I, a, b, c, d, x[12], 52, 6)
+    MD5_STEP(I, d, a, b, c, x[3], 53, 10)
+    MD5_STEP(I, c, d, a, b, x[10], 54, 15)
+    MD5_STEP(I, b, c, d, a, x[1], 55, 21)
+    MD5_STEP(I, a, b, c, d, x[8], 56, 6)
+    MD5_STEP(I, d, a, b, c, x[15], 57, 10)
+    MD5_STEP(I, c, d, a, b, x[6], 58, 15)
+    MD5_STEP(I, b, c, d, a, x[13], 59, 21)
+    MD5_STEP(I, a, b, c, d, x[4], 60, 6)
+    MD5_STEP(I, d, a, b, c, x[11], 61, 10)
+    MD5_STEP(I, c, d, a, b, x[2], 62, 15)
+    MD5_STEP(I, b, c, d, a, x[9], 63, 21)
 }
 
-/*
- * Add some amount of input to the context
- *
- * If the input fills out a block of 512 bits, apply the algorithm (md5Step)
- * and save the result in the buffer. Also updates the overall size.
- */
-void MD5Builder::add(const uint8_t* input_buffer, const size_t input_len) {
-    uint32_t input[16];
-    size_t offset = _size % 64;
-    _size += input_len;
-
-    // Copy each byte in input_buffer into the next space in our context input
-    for(size_t i = 0; i < input_len; ++i){
-        _input[offset++] = (uint8_t)*(input_buffer + i);
-
-        // If we've filled our context input, copy it into our local array input
-        // then reset the offset to 0 and fill in a new buffer.
-        // Every time we fill out a chunk, we run it through the algorithm
-        // to enable some back and forth between cpu and i/o
-        if(offset % 64 == 0){
-            for(unsigned int j = 0; j < 16; ++j){
-                // Convert to little-endian
-                // The local variable `input` our 512-bit chunk separated into 32-bit words
-                // we can use in calculations
-                input[j] = (uint32_t)(_input[(j * 4) + 3]) << 24 |
-                           (uint32_t)(_input[(j * 4) + 2]) << 16 |
-                           (uint32_t)(_input[(j * 4) + 1]) <<  8 |
-                           (uint32_t)(_input[(j * 4)]);
-            }
-            md5Step(_buffer, input);
-            offset = 0;
+void MD5Builder::processBlocks(const uint8_t *data, size_t blocks) {
+    uint32_t a = _buffer[0];
+    uint32_t b = _buffer[1];
+    uint32_t c = _buffer[2];
+    uint32_t d = _buffer[3];
+    uint32_t x[16];
+
+    for (; blocks > 0; --blocks, data += BLOCK_SIZE) {
+        for (unsigned int j = 0; j < 16; ++j) {
+            x[j] = load32le(data + j * 4);
         }
+        uint32_t aa = a, bb = b, cc = c, dd = d;
+        md5Rounds(a, b, c, d, x);
+        a += aa;
+        b += bb;
+        c += cc;
+        d += dd;
     }
-}
 
-static bool hex_char_to_nibble(uint8_t c, uint8_t& nibble) {
-    if (c >= 'a' && c <= 'f') {
-        nibble = c - ((uint8_t)'a' - 0xA);
-        return true;
-    }
-    if (c >= 'A' && c <= 'F') {
-        nibble = c - ((uint8_t)'A' - 0xA);
-        return true;
-    }
-    if (c >= '0' && c <= '9') {
-        nibble = c - (uint8_t)'0';
-        return true;
-    }
-    return false;
+    _buffer[0] = a;
+    _buffer[1] = b;
+    _buffer[2] = c;
+    _buffer[3] = d;
 }
 
 void MD5Builder::begin(void) {
@@ -192,128 +187,194 @@ void MD5Builder::begin(void) {
     _buffer[3] = (uint32_t)D;
 }
 
-void MD5Builder::addHexString(const char * data) {
-    size_t len = strlen(data);
+/*
+ * Pad the input, append the size in bits (little-endian) and save the result
+ * of the final iteration into digest.
+ */
+void MD5Builder::calculate(void) {
+    addPadding(false);
 
-    // Require an even number of hex characters; odd lengths cannot form full bytes.
-    if ((len == 0) || (len % 2 != 0)) {
-        return;
+    // Move the result into digest (convert from little-endian)
+    for(unsigned int i = 0; i < 4; ++i){
+        _digest[(i * 4) + 0] = (uint8_t)((_buffer[i] & 0x000000FF));
+        _digest[(i * 4) + 1] = (uint8_t)((_buffer[i] & 0x0000FF00) >>  8);
+        _digest[(i * 4) + 2] = (uint8_t)((_buffer[i] & 0x00FF0000) >> 16);
+        _digest[(i * 4) + 3] = (uint8_t)((_buffer[i] & 0xFF000000) >> 24);
     }
+}
 
-    constexpr size_t chunk_size = 64;
-    uint8_t tmp[chunk_size];
-    size_t byte_count = len / 2;
-
-    for (size_t processed = 0; processed < byte_count;) {
-        size_t remaining = byte_count - processed;
-        size_t this_chunk = (remaining > chunk_size) ? chunk_size : remaining;
-
-        for (size_t i = 0; i < this_chunk; ++i) {
-            size_t hex_index = (processed + i) * 2;
-            uint8_t high;
-            uint8_t low;
-
-            if (!hex_char_to_nibble(static_cast<uint8_t>(data[hex_index]), high) ||
-                !hex_char_to_nibble(static_cast<uint8_t>(data[hex_index + 1]), low)) {
-                return;
-            }
+/*
+ * Multi buffer version: each SIMD lane hashes a different buffer. When a
+ * lane has processed the last block of its buffer, the next buffer is
+ * assigned to it, so buffers with different sizes keep all lanes busy.
+ */
+#if defined(__GNUC__) && (defined(__SSE2__) || defined(__ARM_NEON))
+#define MD5_SIMD
+typedef uint32_t md5_v4 __attribute__((vector_size(16)));
+#if defined(__x86_64__) || defined(__i386__)
+#define MD5_AVX2
+typedef uint32_t md5_v8 __attribute__((vector_size(32)));
+#endif
 
-            tmp[i] = static_cast<uint8_t>((high << 4) | low);
+template <class V, size_t N>
+static inline __attribute__((always_inline)) void md5Lanes(uint32_t state[4][N], const uint8_t *const ptr[N]) {
+    V a, b, c, d, x[16];
+    memcpy(&a, state[0], sizeof(V));
+    memcpy(&b, state[1], sizeof(V));
+    memcpy(&c, state[2], sizeof(V));
+    memcpy(&d, state[3], sizeof(V));
+    for (unsigned int j = 0; j < 16; ++j) {
+        uint32_t words[N];
+        for (size_t lane = 0; lane < N; ++lane) {
+            words[lane] = load32le(ptr[lane] + j * 4);
         }
-
-        add(tmp, this_chunk);
-        processed += this_chunk;
+        memcpy(&x[j], words, sizeof(V));
     }
+    V aa = a, bb = b, cc = c, dd = d;
+    md5Rounds(a, b, c, d, x);
+    a += aa;
+    b += bb;
+    c += cc;
+    d += dd;
+    memcpy(state[0], &a, sizeof(V));
+    memcpy(state[1], &b, sizeof(V));
+    memcpy(state[2], &c, sizeof(V));
+    memcpy(state[3], &d, sizeof(V));
 }
 
-bool MD5Builder::addStream(Stream &stream, const size_t maxLen) {
-    const int buf_size = 512;
-    size_t maxLengthLeft = maxLen;
-
-    auto buf = std::unique_ptr<uint8_t[]> {new (std::nothrow) uint8_t[buf_size]};
-
-    if (!buf) {
-        return false;
-    }
-
-    size_t bytesAvailable = stream.available();
-    while ((bytesAvailable > 0) && (maxLengthLeft > 0)) {
-
-        // determine number of bytes to read
-        size_t readBytes = bytesAvailable;
-        if (readBytes > maxLengthLeft) {
-            readBytes = maxLengthLeft;    // read only until max_len
+template <class V, size_t N>
+static inline __attribute__((always_inline)) void md5Multiple(const uint8_t *const data[], const size_t len[],
+                                                              size_t count, uint8_t digests[][16]) {
+    struct Lane {
+        size_t msg;       // index of the buffer
+        size_t block;     // next block
+        size_t full;      // number of complete blocks in the buffer
+        size_t total;     // full + 1 or 2 padding blocks
+        bool active;
+        uint8_t tail[2 * HashBuilder::BLOCK_SIZE];
+    };
+    static const uint8_t idle[HashBuilder::BLOCK_SIZE] = {0};
+    static const uint32_t iv[4] = {A, B, C, D};
+    Lane lanes[N];
+    uint32_t state[4][N];
+    const uint8_t *ptr[N];
+    size_t next = 0;
+    size_t active = 0;
+
+    auto assign = [&](size_t j) {
+        Lane &lane = lanes[j];
+        lane.active = next < count;
+        if (!lane.active) {
+            return;
         }
-        if (readBytes > buf_size) {
-            readBytes = buf_size;    // not read more the buffer can handle
+        size_t msg = next++;
+        size_t size = len[msg];
+        size_t rest = size % HashBuilder::BLOCK_SIZE;
+        lane.msg = msg;
+        lane.block = 0;
+        lane.full = size / HashBuilder::BLOCK_SIZE;
+        lane.total = lane.full + (rest < HashBuilder::BLOCK_SIZE - 8 ? 1 : 2);
+        size_t tail_len = (lane.total - lane.full) * HashBuilder::BLOCK_SIZE;
+        memcpy(lane.tail, data[msg] + lane.full * HashBuilder::BLOCK_SIZE, rest);
+        lane.tail[rest] = 0x80;
+        memset(lane.tail + rest + 1, 0, tail_len - rest - 1);
+        uint64_t bit_length = (uint64_t)size * 8ULL;
+        for (unsigned int i = 0; i < 8; ++i) {
+            lane.tail[tail_len - 8 + i] = (uint8_t)(bit_length >> (i * 8));
         }
-
-        // read data and check if we got something
-        size_t numBytesRead = stream.readBytes(buf.get(), readBytes);
-        if (numBytesRead < 1) {
-            return false;
+        for (unsigned int i = 0; i < 4; ++i) {
+            state[i][j] = iv[i];
         }
+        active++;
+    };
 
-        // Update MD5 with buffer payload
-        add(buf.get(), numBytesRead);
-
-        // update available number of bytes
-        maxLengthLeft -= numBytesRead;
-        bytesAvailable = stream.available();
+    for (size_t j = 0; j < N; ++j) {
+        assign(j);
     }
 
-    return true;
-}
+    while (active > 0) {
+        for (size_t j = 0; j < N; ++j) {
+            const Lane &lane = lanes[j];
+            if (!lane.active) {
+                ptr[j] = idle;
+            } else if (lane.block < lane.full) {
+                ptr[j] = data[lane.msg] + lane.block * HashBuilder::BLOCK_SIZE;
+            } else {
+                ptr[j] = lane.tail + (lane.block - lane.full) * HashBuilder::BLOCK_SIZE;
+            }
+        }
 
-/*
- * Pad the current input so its length is congruent to 448 bits (56 bytes) modulo 512 bits,
- * then append the size in bits to the very end, and save the result of the final iteration
- * into digest.
- */
-void MD5Builder::calculate(void) {
-    uint32_t input[16];
-    size_t offset = _size % 64;
-    size_t padding_length = offset < 56 ? 56 - offset : (56 + 64) - offset;
-
-    // Fill in the padding and undo the changes to size that resulted from the update
-    add(PADDING, padding_length);
-    _size -= padding_length;
-
-    // Do a final update (internal to this function)
-    // Last two 32-bit words are the two halves of the size (converted from bytes to bits)
-    for(unsigned int j = 0; j < 14; ++j){
-        input[j] = (uint32_t)(_input[(j * 4) + 3]) << 24 |
-                   (uint32_t)(_input[(j * 4) + 2]) << 16 |
-                   (uint32_t)(_input[(j * 4) + 1]) <<  8 |
-                   (uint32_t)(_input[(j * 4)]);
+        md5Lanes<V, N>(state, ptr);
+
+        for (size_t j = 0; j < N; ++j) {
+            Lane &lane = lanes[j];
+            if (!lane.active || ++lane.block < lane.total) {
+                continue;
+            }
+            uint8_t *digest = digests[lane.msg];
+            for (unsigned int i = 0; i < 4; ++i) {
+                uint32_t value = state[i][j];
+                digest[(i * 4) + 0] = (uint8_t)(value);
+                digest[(i * 4) + 1] = (uint8_t)(value >> 8);
+                digest[(i * 4) + 2] = (uint8_t)(value >> 16);
+                digest[(i * 4) + 3] = (uint8_t)(value >> 24);
+            }
+            active--;
+            assign(j);
+        }
     }
-    uint64_t bit_length = _size * 8ULL;
-    input[14] = (uint32_t)(bit_length);
-    input[15] = (uint32_t)(bit_length >> 32);
+}
 
-    md5Step(_buffer, input);
+static void md5Multiple4(const uint8_t *const data[], const size_t len[], size_t count, uint8_t digests[][16]) {
+    md5Multiple<md5_v4, 4>(data, len, count, digests);
+}
 
-    // Move the result into digest (convert from little-endian)
-    for(unsigned int i = 0; i < 4; ++i){
-        _digest[(i * 4) + 0] = (uint8_t)((_buffer[i] & 0x000000FF));
-        _digest[(i * 4) + 1] = (uint8_t)((_buffer[i] & 0x0000FF00) >>  8);
-        _digest[(i * 4) + 2] = (uint8_t)((_buffer[i] & 0x00FF0000) >> 16);
-        _digest[(i * 4) + 3] = (uint8_t)((_buffer[i] & 0xFF000000) >> 24);
-    }
+#ifdef MD5_AVX2
+__attribute__((target("avx2")))
+static void md5Multiple8(const uint8_t *const data[], const size_t len[], size_t count, uint8_t digests[][16]) {
+    md5Multiple<md5_v8, 8>(data, len, count, digests);
 }
 
-void MD5Builder::getBytes(uint8_t * output) const {
-    memcpy(output, _digest, 16);
+static bool hasAVX2(void) {
+    static const bool result = __builtin_cpu_supports("avx2");
+    return result;
 }
+#endif
+#endif
 
-void MD5Builder::getChars(char * output) const {
-    for (uint8_t i = 0; i < 16; i++) {
-        sprintf(output + (i * 2), "%02x", _digest[i]);
+size_t MD5Builder::lanes(void) {
+#ifdef MD5_AVX2
+    if (hasAVX2()) {
+        return 8;
     }
+#endif
+#ifdef MD5_SIMD
+    return 4;
+#else
+    return 1;
+#endif
 }
 
-String MD5Builder::toString(void) const {
-    char out[33];
-    getChars(out);
-    return String(out);
+void MD5Builder::calculateMultiple(const uint8_t *const data[], const size_t len[], size_t count,
+                                   uint8_t digests[][16]) {
+    if (count > 1 && lanes() > 1) {
+#ifdef MD5_AVX2
+        if (lanes() == 8) {
+            md5Multiple8(data, len, count, digests);
+            return;
+        }
+#endif
+#ifdef MD5_SIMD
+        md5Multiple4(data, len, count, digests);
+        return;
+#endif
+    }
+
+    MD5Builder md5;
+    for (size_t i = 0; i < count; ++i) {
+        md5.begin();
+        md5.add(data[i], len[i]);
+        md5.calculate();
+        md5.getBytes(digests[i]);
+    }
 }
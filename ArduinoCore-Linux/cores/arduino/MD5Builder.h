@@ -25,38 +25,34 @@
 
 #pragma once
 
-#include <api/String.h>
-#include <Stream.h>
-#include <cstring>
-
-class MD5Builder {
+#include <HashBuilder.h>
+
+/**
+ * @brief MD5 of the added data. Multiple independent buffers can be hashed in
+ * parallel with calculateMultiple(), which uses 4 (SSE2, NEON) or 8 (AVX2)
+ * SIMD lanes.
+ */
+class MD5Builder : public HashBuilder {
 private:
-    uint64_t _size;        // Size of input in bytes
     uint32_t _buffer[4];   // Current accumulation of hash
-    uint8_t _input[64];    // Input to be used in the next step
-    uint8_t _digest[16];   // Result of algorithm
 public:
-    void begin(void);
-    void add(const uint8_t * data, const size_t len);
-    void add(const char * data) {
-        add((const uint8_t*)data, strlen(data));
-    }
-    void add(char * data) {
-        add((const char*)data);
-    }
-    void add(const String& data) {
-        add(data.c_str());
-    }
-    void addHexString(const char * data);
-    void addHexString(char * data) {
-        addHexString((const char*)data);
-    }
-    void addHexString(const String& data) {
-        addHexString(data.c_str());
-    }
-    bool addStream(Stream & stream, const size_t maxLen);
-    void calculate(void);
-    void getBytes(uint8_t * output) const;
-    void getChars(char * output) const;
-    String toString(void) const;
+    /// Number of buffers which are hashed in parallel by calculateMultiple()
+    static size_t lanes(void);
+
+    MD5Builder() : HashBuilder(16) {}
+    void begin(void) override;
+    void calculate(void) override;
+
+    /**
+     * @brief Calculates the MD5 of count independent buffers.
+     * @param data Buffers which should be hashed
+     * @param len Length of each buffer
+     * @param count Number of buffers
+     * @param digests Receives the 16 byte digest of each buffer
+     */
+    static void calculateMultiple(const uint8_t * const data[], const size_t len[],
+                                  size_t count, uint8_t digests[][16]);
+
+protected:
+    void processBlocks(const uint8_t * data, size_t blocks) override;
 };
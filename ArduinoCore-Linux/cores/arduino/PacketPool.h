@@ -0,0 +1,125 @@
+/*
+  PacketPool.h
+  Copyright (c) 2025 Phil Schatzmann. All right reserved.
+
+  This library is free software; you can redistribute it and/or
+  modify it under the terms of the GNU Lesser General Public
+  License as published by the Free Software Foundation; either
+  version 2.1 of the License, or (at your option) any later version.
+
+  This library is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+  Lesser General Public License for more details.
+
+  You should have received a copy of the GNU Lesser General Public
+  License along with this library; if not, write to the Free Software
+  Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA 02110-1301 USA
+*/
+#pragma once
+
+#include "stddef.h"
+#include "stdint.h"
+#include "vector"
+
+#include "ArduinoLogger.h"
+
+namespace arduino {
+
+/**
+ * @brief Fixed size pool of packet buffers. All buffers are allocated as a
+ * single slab in begin() and are managed with a free list, so acquire() and
+ * release() never touch the heap. The pool is not thread safe: it is intended
+ * to be owned by a single object (e.g. EthernetUDP).
+ */
+
+class PacketPool {
+ public:
+  PacketPool() = default;
+
+  PacketPool(int count, int packetSize) { begin(count, packetSize); }
+
+  /// Allocates the slab: all buffers must have been released
+  bool begin(int count, int packetSize) {
+    if (count < 1 || packetSize < 1) return false;
+    packet_count = count;
+    packet_size = packetSize;
+    slab.resize((size_t)count * packetSize);
+    free_list.clear();
+    free_list.reserve(count);
+    is_used.assign(count, false);
+    for (int j = count - 1; j >= 0; j--) {
+      free_list.push_back(slab.data() + (size_t)j * packetSize);
+    }
+    return true;
+  }
+
+  /// Releases the slab
+  void end() {
+    slab.clear();
+    slab.shrink_to_fit();
+    free_list.clear();
+    is_used.clear();
+    packet_count = 0;
+    packet_size = 0;
+  }
+
+  /// Provides a free buffer of packetSize() bytes or nullptr if all buffers
+  /// are in use
+  uint8_t* acquire() {
+    if (free_list.empty()) return nullptr;
+    uint8_t* result = free_list.back();
+    free_list.pop_back();
+    is_used[index(result)] = true;
+    return result;
+  }
+
+  /// Returns a buffer that was provided by acquire(): releasing a buffer
+  /// twice or a foreign buffer is reported as error and ignored
+  void release(uint8_t* buffer) {
+    if (buffer == nullptr) return;
+    int idx = index(buffer);
+    if (idx < 0) {
+      Logger.error("PacketPool", "release of a foreign buffer");
+      return;
+    }
+    if (!is_used[idx]) {
+      Logger.error("PacketPool", "buffer released twice");
+      return;
+    }
+    is_used[idx] = false;
+    // capacity was reserved in begin(): push_back does not allocate
+    free_list.push_back(buffer);
+  }
+
+  /// Number of free buffers
+  int available() { return free_list.size(); }
+
+  /// Total number of buffers
+  int count() { return packet_count; }
+
+  /// Size of a single buffer in bytes
+  int packetSize() { return packet_size; }
+
+  operator bool() { return packet_count > 0; }
+
+ protected:
+  std::vector<uint8_t> slab;
+  std::vector<uint8_t*> free_list;
+  std::vector<bool> is_used;
+  int packet_count = 0;
+  int packet_size = 0;
+
+  /// index of the buffer in the slab or -1
+  int index(uint8_t* buffer) {
+    if (slab.empty() || buffer < slab.data() ||
+        buffer >= slab.data() + slab.size()) {
+      return -1;
+    }
+    size_t offset = buffer - slab.data();
+    if (offset % packet_size != 0) return -1;
+    return offset / packet_size;
+  }
+};
+
+}  // namespace arduino
@@ -0,0 +1,181 @@
+/*
+  PayloadCodec.h
+  Copyright (c) 2025 Phil Schatzmann. All right reserved.
+
+  This library is free software; you can redistribute it and/or
+  modify it under the terms of the GNU Lesser General Public
+  License as published by the Free Software Foundation; either
+  version 2.1 of the License, or (at your option) any later version.
+
+  This library is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+  Lesser General Public License for more details.
+
+  You should have received a copy of the GNU Lesser General Public
+  License along with this library; if not, write to the Free Software
+  Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA 02110-1301 USA
+*/
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+#include <string.h>
+
+#include <vector>
+
+namespace arduino {
+
+/// Bulk payloads of the remote hardware protocol which can be compressed
+enum PayloadChannel {
+  PayloadSPI,
+  PayloadSPIReply,
+  PayloadSerial,
+  PayloadChannelCount
+};
+
+/**
+ * @brief Compression of bulk payloads (SPI buffers, serial output)
+ *
+ * The data is encoded with a simple run length encoding: a control byte
+ * 0..127 is followed by 1..128 literal bytes, a control byte 128..255 by a
+ * single byte that is repeated 3..130 times. For channels which use the delta
+ * mode (e.g. SPI frame buffers) the data is first xored with the previous
+ * payload of the same size, so that unchanged areas become runs of 0.
+ *
+ * Both sides need to process the same sequence of payloads per channel to
+ * keep the history in sync.
+ */
+class PayloadCodec {
+ public:
+  enum Encoding : uint8_t { Raw = 0, RLE = 1, DeltaRLE = 2 };
+
+  /// Encodes the data into out and returns the encoding. Raw means that the
+  /// data could not be compressed and out is empty.
+  Encoding encode(const uint8_t* data, size_t len, bool useDelta,
+                  std::vector<uint8_t>& out) {
+    Encoding result = Raw;
+    out.resize(len);
+    size_t best = rleEncode(data, len, out.data(), len);
+    if (best > 0) result = RLE;
+    if (useDelta && history.size() == len) {
+      delta.resize(len);
+      for (size_t j = 0; j < len; j++) delta[j] = data[j] ^ history[j];
+      tmp.resize(len);
+      size_t n = rleEncode(delta.data(), len, tmp.data(),
+                           best > 0 ? best : len);
+      if (n > 0) {
+        out.swap(tmp);
+        best = n;
+        result = DeltaRLE;
+      }
+    }
+    out.resize(best);
+    if (useDelta) history.assign(data, data + len);
+    return result;
+  }
+
+  /// Decodes the encoded data into out which has the size of the original
+  /// data
+  bool decode(Encoding encoding, const uint8_t* in, size_t inLen, uint8_t* out,
+              size_t len, bool useDelta) {
+    bool ok = true;
+    switch (encoding) {
+      case Raw:
+        ok = inLen == len;
+        if (ok) memcpy(out, in, len);
+        break;
+      case RLE:
+        ok = rleDecode(in, inLen, out, len) == len;
+        break;
+      case DeltaRLE:
+        ok = history.size() == len && rleDecode(in, inLen, out, len) == len;
+        if (ok) {
+          for (size_t j = 0; j < len; j++) out[j] ^= history[j];
+        }
+        break;
+      default:
+        ok = false;
+    }
+    if (useDelta) {
+      if (ok) {
+        history.assign(out, out + len);
+      } else {
+        history.clear();
+      }
+    }
+    return ok;
+  }
+
+  /// Updates the history with uncompressed data that was sent or received
+  void setHistory(const uint8_t* data, size_t len) {
+    history.assign(data, data + len);
+  }
+
+  void reset() { history.clear(); }
+
+  /// Run length encoding: returns 0 if the result would not be smaller than
+  /// maxOut
+  static size_t rleEncode(const uint8_t* data, size_t len, uint8_t* out,
+                          size_t maxOut) {
+    size_t i = 0;
+    size_t o = 0;
+    while (i < len) {
+      size_t run = repeatCount(data, len, i);
+      if (run >= 3) {
+        if (o + 2 >= maxOut) return 0;
+        out[o++] = 128 + (run - 3);
+        out[o++] = data[i];
+        i += run;
+      } else {
+        // collect literals until the next run starts
+        size_t start = i;
+        while (i < len && i - start < 128 && repeatCount(data, len, i) < 3) i++;
+        size_t n = i - start;
+        if (o + 1 + n >= maxOut) return 0;
+        out[o++] = n - 1;
+        memcpy(out + o, data + start, n);
+        o += n;
+      }
+    }
+    return o;
+  }
+
+  /// Decodes the run length encoded data: returns the number of bytes which
+  /// were written to out
+  static size_t rleDecode(const uint8_t* in, size_t inLen, uint8_t* out,
+                          size_t len) {
+    size_t i = 0;
+    size_t o = 0;
+    while (i < inLen) {
+      uint8_t ctrl = in[i++];
+      if (ctrl < 128) {
+        size_t n = ctrl + 1;
+        if (i + n > inLen || o + n > len) return 0;
+        memcpy(out + o, in + i, n);
+        i += n;
+        o += n;
+      } else {
+        size_t n = ctrl - 128 + 3;
+        if (i >= inLen || o + n > len) return 0;
+        memset(out + o, in[i++], n);
+        o += n;
+      }
+    }
+    return o;
+  }
+
+ protected:
+  std::vector<uint8_t> history;
+  std::vector<uint8_t> delta;
+  std::vector<uint8_t> tmp;
+
+  /// number of repetitions of data[pos] (max 130)
+  static size_t repeatCount(const uint8_t* data, size_t len, size_t pos) {
+    size_t n = 1;
+    while (pos + n < len && n < 130 && data[pos + n] == data[pos]) n++;
+    return n;
+  }
+};
+
+}  // namespace arduino
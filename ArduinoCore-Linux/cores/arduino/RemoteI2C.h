@@ -1,4 +1,7 @@
 #pragma once
+#include <vector>
+
+#include "ArduinoLogger.h"
 #include "Stream.h"
 #include "api/HardwareI2C.h"
 #include "HardwareService.h"
@@ -18,6 +21,13 @@ namespace arduino {
  * - Stream-based remote communication protocol
  * - Automatic command serialization and response handling
  * - Support for all I2C operations (master/slave, read/write, transactions)
+ * - Written data is buffered until endTransmission() and requestFrom()
+ *   receives the data in its reply. A register read (write without stop bit
+ *   followed by requestFrom()) is sent as a single request. These
+ *   transactions are activated with setTransactions() and negotiated in
+ *   begin(): devices which do not support them are served with the per byte
+ *   calls. HardwareSetupRemote activates them for devices which confirm the
+ *   handshake with SYNC, so old firmware does not need to answer the query.
  * - Real-time bidirectional communication with remote I2C hardware
  * 
  * The class uses HardwareService for protocol handling and can work with any
@@ -31,92 +41,200 @@ class RemoteI2C : public HardwareI2C {
  public:
   RemoteI2C() = default;
   RemoteI2C(Stream* stream) { service.setStream(static_cast<Stream*>(stream)); }
+  ~RemoteI2C() { sendPendingWrite(); }
   void setStream(Stream* stream) {
     service.setStream(static_cast<Stream*>(stream));
   }
 
   virtual void begin() {
+    sendPendingWrite();
     service.send(I2cBegin0);
     service.flush();
+    negotiateTransactions();
   }
 
   virtual void begin(uint8_t address) {
+    sendPendingWrite();
     service.send(I2cBegin1);
     service.send(address);
     service.flush();
+    negotiateTransactions();
   }
   virtual void end() {
+    sendPendingWrite();
     service.send(I2cEnd);
     service.flush();
   }
 
   virtual void setClock(uint32_t freq) {
+    sendPendingWrite();
     service.send(I2cSetClock);
     service.send(freq);
     service.flush();
   }
 
+  /// Requests the exchange of whole transactions: call it before begin(),
+  /// which checks if the device supports them
+  void setTransactions(bool active) { is_transactions_requested = active; }
+
+  /// true if the device supports the exchange of whole transactions
+  bool isTransactionsActive() { return is_transactions; }
+
+  /// the data is collected locally and sent with endTransmission()
   virtual void beginTransmission(uint8_t address) {
-    service.send(I2cBeginTransmission);
-    service.send(address);
-    service.flush();
+    if (!is_transactions) {
+      service.send(I2cBeginTransmission);
+      service.send(address);
+      service.flush();
+      return;
+    }
+    sendPendingWrite();
+    tx_address = address;
+    tx_buffer.clear();
   }
 
+  /// sends the whole transaction in one request. Without stop bit a
+  /// requestFrom() usually follows (e.g. to read a register): then the data is
+  /// sent together with the read request and we report success. Otherwise it
+  /// is sent with the next call.
   virtual uint8_t endTransmission(bool stopBit) {
-    service.send(I2cEndTransmission1);
-    service.send(stopBit);
-    return service.receive8();
+    if (!is_transactions) {
+      service.send(I2cEndTransmission1);
+      service.send(stopBit);
+      service.flush();
+      return service.receive8();
+    }
+    if (!stopBit) {
+      is_write_pending = true;
+      return 0;
+    }
+    return sendTransmission(stopBit);
   }
 
-  virtual uint8_t endTransmission(void) {
-    service.send(I2cEndTransmission);
-    return service.receive8();
-  }
+  virtual uint8_t endTransmission(void) { return endTransmission(true); }
 
+  /// the reply contains the requested data, which is then provided by read()
   virtual size_t requestFrom(uint8_t address, size_t len, bool stopBit) {
-    service.send(I2cRequestFrom3);
+    if (!is_transactions) {
+      service.send(I2cRequestFrom3);
+      service.send(address);
+      service.send((uint64_t)len);
+      service.send(stopBit);
+      service.flush();
+      return service.receive8();
+    }
+    if (is_write_pending && tx_address != address) sendPendingWrite();
+    if (len > UINT16_MAX) {
+      Logger.error("RemoteI2C", "requestFrom: len too big");
+      sendPendingWrite();
+      return 0;
+    }
+    service.send(I2cRequest);
     service.send(address);
-    service.send((uint64_t)len);
+    service.send((uint16_t)len);
     service.send(stopBit);
-    return service.receive8();
+    // data of a preceding write without stop bit
+    uint16_t write_len = is_write_pending ? tx_buffer.size() : 0;
+    service.send(write_len);
+    service.send(tx_buffer.data(), write_len);
+    service.flush();
+    if (is_write_pending) {
+      is_write_pending = false;
+      tx_buffer.clear();
+    }
+    rx_buffer.resize(service.receive16());
+    rx_pos = 0;
+    service.receive(rx_buffer.data(), rx_buffer.size());
+    return rx_buffer.size();
   }
 
   virtual size_t requestFrom(uint8_t address, size_t len) {
-    service.send(I2cRequestFrom2);
-    service.send(address);
-    service.send((uint64_t)len);
-    return service.receive8();
+    return requestFrom(address, len, true);
   }
 
-  virtual void onReceive(void (*)(int)) {}
+  virtual void onReceive(void (*)(int)) { sendPendingWrite(); }
 
-  virtual void onRequest(void (*)(void)) {}
+  virtual void onRequest(void (*)(void)) { sendPendingWrite(); }
 
   size_t write(uint8_t c) {
-    service.send(I2cWrite);
-    service.send(c);
-    return service.receive16();
+    if (!is_transactions) {
+      service.send(I2cWrite);
+      service.send(c);
+      service.flush();
+      return service.receive16();
+    }
+    tx_buffer.push_back(c);
+    return 1;
+  }
+
+  size_t write(const uint8_t* data, size_t len) {
+    if (!is_transactions) {
+      size_t result = 0;
+      for (size_t j = 0; j < len; j++) result += write(data[j]);
+      return result;
+    }
+    tx_buffer.insert(tx_buffer.end(), data, data + len);
+    return len;
   }
 
   int available() {
-    service.send(I2cAvailable);
-    return service.receive16();
+    if (!is_transactions) return remoteCall(I2cAvailable);
+    sendPendingWrite();
+    return rx_buffer.size() - rx_pos;
   }
 
   int read() {
-    service.send(I2cRead);
-    return service.receive16();
+    if (!is_transactions) return remoteCall(I2cRead);
+    sendPendingWrite();
+    return rx_pos < rx_buffer.size() ? rx_buffer[rx_pos++] : -1;
   }
 
   int peek() {
-    service.send(I2cPeek);
-    return service.receive16();
+    if (!is_transactions) return remoteCall(I2cPeek);
+    sendPendingWrite();
+    return rx_pos < rx_buffer.size() ? rx_buffer[rx_pos] : -1;
   }
 
   operator bool() { return service; }
 
  protected:
   HardwareService service;
+  uint8_t tx_address = 0;
+  std::vector<uint8_t> tx_buffer;
+  std::vector<uint8_t> rx_buffer;
+  size_t rx_pos = 0;
+  bool is_write_pending = false;
+  bool is_transactions = false;
+  bool is_transactions_requested = false;
+
+  void negotiateTransactions() {
+    is_transactions = is_transactions_requested &&
+                      service.hasFeature(FeatureI2cTransactions);
+  }
+
+  /// per byte call without arguments which returns an int16_t
+  int remoteCall(HWCalls call) {
+    service.send(call);
+    service.flush();
+    return (int16_t)service.receive16();
+  }
+
+  uint8_t sendTransmission(bool stopBit) {
+    service.send(I2cTransmission);
+    service.send(tx_address);
+    service.send(stopBit);
+    service.send((uint16_t)tx_buffer.size());
+    service.send(tx_buffer.data(), tx_buffer.size());
+    service.flush();
+    tx_buffer.clear();
+    return service.receive8();
+  }
+
+  void sendPendingWrite() {
+    if (!is_write_pending) return;
+    is_write_pending = false;
+    sendTransmission(false);
+  }
 };
 
 }  // namespace arduino
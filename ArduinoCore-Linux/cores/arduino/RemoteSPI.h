@@ -37,6 +37,7 @@ namespace arduino {
  * - Support for all SPI transfer modes (8-bit, 16-bit, buffer transfers)
  * - Transaction management with SPISettings support
  * - Interrupt handling and configuration
+ * - Optional compression of buffer transfers (setCompression())
  * - Real-time bidirectional communication with remote SPI hardware
  * 
  * The class uses HardwareService for protocol handling and can work with any
@@ -70,11 +71,9 @@ class RemoteSPI : public HardwareSPI {
   void transfer(void* buf, size_t count) {
     service.send(SpiTransfer);
     service.send((uint32_t)count);
-    service.send(buf, count);
+    service.sendPayload(PayloadSPI, buf, count);
     service.flush();
-    for (int j=0; j<count; j++) {
-      ((uint8_t*)buf)[j] = service.receive8();
-    }
+    service.receivePayload(PayloadSPIReply, buf, count);
   }
 
   void usingInterrupt(int interruptNumber) {
@@ -123,6 +122,14 @@ class RemoteSPI : public HardwareSPI {
     service.flush();
   }
 
+  /// Compresses the buffers of transfer(buf, count) which are bigger than
+  /// the threshold: the device must support it. The setting applies to all
+  /// RemoteSPI objects which use the same stream.
+  bool setCompression(bool active, uint32_t threshold = 64) {
+    return service.negotiateCodec(PayloadSPI, active, threshold) &&
+           service.negotiateCodec(PayloadSPIReply, active, threshold);
+  }
+
   operator bool() { return service; }
 
  protected:
@@ -18,6 +18,7 @@
 */
 #pragma once
 
+#include "ArduinoLogger.h"
 #include "HardwareService.h"
 #include "RingBufferExt.h"
 #include "api/Stream.h"
@@ -40,6 +41,18 @@ namespace arduino {
  * - Standard Serial operations (begin, end, baud rate configuration)
  * - Optimized buffering for single character and bulk operations
  * - Real-time bidirectional communication with remote Serial hardware
+ * - Optional streaming mode (setStreaming())
+ * 
+ * Written data is collected locally and sent when the buffer is full or with
+ * flush(). In the default mode each block is confirmed by the device and
+ * available() and read() ask the device when the local buffer is empty.
+ *
+ * In the streaming mode the written blocks are acknowledged asynchronously:
+ * we only wait if more than the window size is unconfirmed. The device pushes
+ * the received data without being asked, so available() and read() just
+ * process what has arrived and never wait for a round trip. The streaming
+ * mode needs a stream which is not shared with other remote objects (e.g.
+ * RemoteGPIO) because the pushed data would interfere with their replies.
  * 
  * The class uses HardwareService for protocol handling and maintains separate
  * read and write buffers for efficient data transfer. It can work with any
@@ -53,6 +66,7 @@ class RemoteSerialClass : public Stream {
  public:
   RemoteSerialClass(Stream& stream, uint8_t no) {
     this->no = no;
+    this->p_stream = &stream;
     this->service.setStream(&stream);
   }
 
@@ -71,12 +85,47 @@ class RemoteSerialClass : public Stream {
   }
 
   virtual void end() {
+    flush();
     service.send(SerialEnd);
     service.send(no);
     service.flush();
   }
 
+  /// Activates the streaming mode: the device must support it. The window
+  /// is the max number of written bytes which have not been confirmed yet.
+  /// The device replies with a frame, so that the frames which are still
+  /// queued before it are processed: their data must fit into the read
+  /// buffer.
+  bool setStreaming(bool active, int window = 4096) {
+    flush();
+    service.send(SerialStreaming);
+    service.send(no);
+    service.send(active);
+    service.flush();
+    streaming_reply = -1;
+    unsigned long start = millis();
+    while (streaming_reply < 0 && millis() - start < getTimeout()) {
+      if (!processIncoming()) delay(1);
+    }
+    if (streaming_reply < 0) {
+      Logger.error("RemoteSerial", "no reply for setStreaming");
+    }
+    bool ok = streaming_reply == 1;
+    if (ok) {
+      is_streaming = active;
+      window_size = window;
+      unacknowledged = 0;
+    }
+    return ok;
+  }
+
+  bool isStreaming() { return is_streaming; }
+
   virtual int available() {
+    if (is_streaming) {
+      processIncoming();
+      return read_buffer.available();
+    }
     if (read_buffer.available() > 0) {
       return read_buffer.available();
     }
@@ -88,7 +137,9 @@ class RemoteSerialClass : public Stream {
   }
 
   virtual int read() {
-    if (read_buffer.available() == 0) {
+    if (is_streaming) {
+      processIncoming();
+    } else if (read_buffer.available() == 0) {
       uint8_t buffer[max_buffer_len];
       int len = readBytes(buffer, max_buffer_len);
       read_buffer.write(buffer, len);
@@ -100,6 +151,14 @@ class RemoteSerialClass : public Stream {
   }
 
   virtual size_t readBytes(uint8_t* buffer, size_t length) {
+    if (is_streaming) {
+      // wait for the pushed data up to the timeout
+      unsigned long start = millis();
+      while (read_buffer.available() == 0 && millis() - start < getTimeout()) {
+        if (!processIncoming()) delay(1);
+      }
+      return read_buffer.read(buffer, length);
+    }
     if (read_buffer.available() > 0) {
       return read_buffer.read(buffer, length);
     }
@@ -107,12 +166,14 @@ class RemoteSerialClass : public Stream {
     service.send(no);
     service.send((uint64_t)length);
     service.flush();
-    int len = service.receive(buffer, length);
-    return len;
+    // the device replies with the length of the available data
+    size_t len = min((size_t)service.receive16(), length);
+    return service.receive(buffer, len);
   }
 
   virtual int peek() {
-    if (read_buffer.available() > 0) {
+    if (is_streaming) processIncoming();
+    if (read_buffer.available() > 0 || is_streaming) {
       return read_buffer.peek();
     }
     service.send(SerialPeek);
@@ -122,54 +183,118 @@ class RemoteSerialClass : public Stream {
 
   virtual size_t write(uint8_t c) {
     if (write_buffer.availableToWrite() == 0) {
-      flush();
+      sendWriteBuffer();
     }
     return write_buffer.write(c);
   }
 
+  /// the data is added to the write buffer which is sent when it is full
+  virtual size_t write(const uint8_t* str, size_t len) {
+    size_t result = 0;
+    while (result < len) {
+      if (write_buffer.availableToWrite() == 0) sendWriteBuffer();
+      result += write_buffer.write((uint8_t*)str + result, len - result);
+    }
+    return result;
+  }
+
   virtual size_t write(uint8_t* str, size_t len) {
-    flush();
-    service.send(SerialWrite);
-    service.send(no);
-    service.send((uint64_t)len);
-    service.send(str, len);
-    service.flush();
-    return service.receive16();
+    return write((const uint8_t*)str, len);
   }
 
+  /// sends the buffered data: in the default mode the device is asked to
+  /// flush as well if something was written
   void flush() {
-#if defined(_MSC_VER)
-    int available;
-    while ((available = write_buffer.available()) > 0) {
-      uint8_t buffer[max_buffer_len];
-      write_buffer.read(buffer, min(available, max_buffer_len));
-      write(buffer, min(available, max_buffer_len));
+    bool was_written = write_buffer.available() > 0;
+    sendWriteBuffer();
+    if (was_written && !is_streaming) {
+      service.send(SerialFlush);
+      service.send(no);
+      service.flush();
     }
-#else
-    int available = write_buffer.available();
-    if (available > 0) {
-      uint8_t buffer[available];
-      write_buffer.read(buffer, available);
-      write(buffer, available);
-    }
-#endif
-    service.send(SerialFlush);
-    service.send(no);
-    service.flush();
   }
 
   operator bool() { return service; }
 
+  /// Compresses the written data if it is bigger than the threshold: the
+  /// device must support it. The setting applies to all serial ports which
+  /// use the same stream.
+  bool setCompression(bool active, uint32_t threshold = 64) {
+    return service.negotiateCodec(PayloadSerial, active, threshold);
+  }
+
  protected:
   HardwareService service;
+  Stream* p_stream = nullptr;
   uint8_t no;
-#if defined(_MSC_VER)
-  static constexpr int max_buffer_len = 512;  // MSVC does not support VLA
-#else
-  int max_buffer_len = 512;
-#endif
-  RingBufferExt write_buffer;
-  RingBufferExt read_buffer;
+  static constexpr int max_buffer_len = 512;
+  /// type (uint16_t), port (uint8_t), length (uint16_t)
+  static constexpr int frame_header_len = 5;
+  RingBufferExt write_buffer{max_buffer_len};
+  RingBufferExt read_buffer{4096};
+  uint8_t tx_buffer[max_buffer_len];
+  bool is_streaming = false;
+  int window_size = 4096;
+  int unacknowledged = 0;
+  // status of the SerialStreaming reply frame (-1 = not received)
+  int streaming_reply = -1;
+
+  void sendWriteBuffer() {
+    int available = write_buffer.available();
+    if (available == 0) return;
+    if (is_streaming) {
+      // wait until the device has confirmed enough data
+      unsigned long start = millis();
+      while (unacknowledged + available > window_size &&
+             millis() - start < getTimeout()) {
+        if (!processIncoming()) delay(1);
+      }
+    }
+    write_buffer.read(tx_buffer, available);
+    service.send(SerialWrite);
+    service.send(no);
+    service.send((uint64_t)available);
+    service.sendPayload(PayloadSerial, tx_buffer, available);
+    service.flush();
+    if (is_streaming) {
+      unacknowledged += available;
+    } else {
+      service.receive16();
+    }
+  }
+
+  /// processes the frames that the device has sent: returns true if
+  /// something was processed
+  bool processIncoming() {
+    bool result = false;
+    uint8_t data[max_buffer_len];
+    while (p_stream->available() >= frame_header_len) {
+      // keep the data in the stream if we can not store it
+      if (read_buffer.availableToWrite() < max_buffer_len) break;
+      uint16_t type = service.receive16();
+      uint8_t port = service.receive8();
+      uint16_t len = service.receive16();
+      if (type == SerialAck) {
+        unacknowledged = max(0, unacknowledged - (int)len);
+      } else if (type == SerialStreaming) {
+        // the length field contains the status
+        if (port == no) streaming_reply = len;
+      } else if (type == SerialData && len <= max_buffer_len) {
+        service.receive(data, len);
+        if (port == no) read_buffer.write(data, len);
+      } else {
+        // skip the payload, so that we stay in sync with the next frame
+        Logger.error("RemoteSerial", "invalid frame");
+        while (len > 0) {
+          uint16_t n = min(len, (uint16_t)max_buffer_len);
+          if (service.receive(data, n) != n) break;
+          len -= n;
+        }
+      }
+      result = true;
+    }
+    return result;
+  }
 };
 
 }  // namespace arduino
@@ -63,7 +63,7 @@ class RingBufferExt {
   int read(uint8_t* str, int len) {
     for (int j = 0; j < len; j++) {
       int current = read();
-      if (current <= 0) {
+      if (current < 0) {
         return j;
       }
       str[j] = current;
@@ -0,0 +1,226 @@
+/*
+  SHA1Builder.cpp
+  Copyright (c) 2025 Phil Schatzmann. All right reserved.
+
+  This library is free software; you can redistribute it and/or
+  modify it under the terms of the GNU Lesser General Public
+  License as published by the Free Software Foundation; either
+  version 2.1 of the License, or (at your option) any later version.
+
+  This library is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+  Lesser General Public License for more details.
+
+  You should have received a copy of the GNU Lesser General Public
+  License along with this library; if not, write to the Free Software
+  Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA 02110-1301 USA
+*/
+
+#include <Arduino.h>
+#include <SHA1Builder.h>
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#define SHA1_X86
+#include <immintrin.h>
+#elif defined(__ARM_FEATURE_SHA2) || defined(__ARM_FEATURE_CRYPTO)
+#define SHA1_ARM
+#include <arm_neon.h>
+#endif
+
+static inline uint32_t load32be(const uint8_t *p) {
+    return (uint32_t)p[0] << 24 | (uint32_t)p[1] << 16 | (uint32_t)p[2] << 8 | (uint32_t)p[3];
+}
+
+static inline uint32_t rol32(uint32_t x, int n) {
+    return (x << n) | (x >> (32 - n));
+}
+
+/*
+ * Rounds of SHA-1: the message schedule is calculated in place in w[16]
+ */
+#define SHA1_W(i) \
+    (w[(i) & 15] = rol32(w[((i) - 3) & 15] ^ w[((i) - 8) & 15] ^ w[((i) - 14) & 15] ^ w[(i) & 15], 1))
+#define SHA1_R0(a, b, c, d, e, i) \
+    e += (d ^ (b & (c ^ d))) + w[i] + 0x5A827999 + rol32(a, 5); b = rol32(b, 30);
+#define SHA1_R1(a, b, c, d, e, i) \
+    e += (d ^ (b & (c ^ d))) + SHA1_W(i) + 0x5A827999 + rol32(a, 5); b = rol32(b, 30);
+#define SHA1_R2(a, b, c, d, e, i) \
+    e += (b ^ c ^ d) + SHA1_W(i) + 0x6ED9EBA1 + rol32(a, 5); b = rol32(b, 30);
+#define SHA1_R3(a, b, c, d, e, i) \
+    e += ((b & c) | (d & (b | c))) + SHA1_W(i) + 0x8F1BBCDC + rol32(a, 5); b = rol32(b, 30);
+#define SHA1_R4(a, b, c, d, e, i) \
+    e += (b ^ c ^ d) + SHA1_W(i) + 0xCA62C1D6 + rol32(a, 5); b = rol32(b, 30);
+#define SHA1_R5(R, i)                                                    \
+    R(a, b, c, d, e, i) R(e, a, b, c, d, i + 1) R(d, e, a, b, c, i + 2) \
+    R(c, d, e, a, b, i + 3) R(b, c, d, e, a, i + 4)
+
+static void sha1Blocks(uint32_t state[5], const uint8_t *data, size_t blocks) {
+    uint32_t w[16];
+    for (; blocks > 0; --blocks, data += HashBuilder::BLOCK_SIZE) {
+        for (unsigned int i = 0; i < 16; ++i) {
+            w[i] = load32be(data + i * 4);
+        }
+        uint32_t a = state[0], b = state[1], c = state[2], d = state[3], e = state[4];
+
+        SHA1_R5(SHA1_R0, 0) SHA1_R5(SHA1_R0, 5) SHA1_R5(SHA1_R0, 10)
+        SHA1_R0(a, b, c, d, e, 15) SHA1_R1(e, a, b, c, d, 16) SHA1_R1(d, e, a, b, c, 17)
+        SHA1_R1(c, d, e, a, b, 18) SHA1_R1(b, c, d, e, a, 19)
+        SHA1_R5(SHA1_R2, 20) SHA1_R5(SHA1_R2, 25) SHA1_R5(SHA1_R2, 30) SHA1_R5(SHA1_R2, 35)
+        SHA1_R5(SHA1_R3, 40) SHA1_R5(SHA1_R3, 45) SHA1_R5(SHA1_R3, 50) SHA1_R5(SHA1_R3, 55)
+        SHA1_R5(SHA1_R4, 60) SHA1_R5(SHA1_R4, 65) SHA1_R5(SHA1_R4, 70) SHA1_R5(SHA1_R4, 75)
+
+        state[0] += a;
+        state[1] += b;
+        state[2] += c;
+        state[3] += d;
+        state[4] += e;
+    }
+}
+
+#ifdef SHA1_X86
+/*
+ * SHA-NI: each sha1rnds4 calculates 4 rounds. e is kept in the upper word of
+ * e0/e1 which are used alternately.
+ */
+#define SHA1_NI_ROUNDS(f, e_cur, e_next, m0, m1, m2, m3) \
+    e_cur = _mm_sha1nexte_epu32(e_cur, m0);              \
+    e_next = abcd;                                       \
+    m1 = _mm_sha1msg2_epu32(m1, m0);                     \
+    abcd = _mm_sha1rnds4_epu32(abcd, e_cur, f);          \
+    m3 = _mm_sha1msg1_epu32(m3, m0);                     \
+    m2 = _mm_xor_si128(m2, m0);
+
+__attribute__((target("sha,sse4.1")))
+static void sha1BlocksNI(uint32_t state[5], const uint8_t *data, size_t blocks) {
+    const __m128i mask = _mm_set_epi64x(0x0001020304050607ULL, 0x08090a0b0c0d0e0fULL);
+    __m128i abcd = _mm_shuffle_epi32(_mm_loadu_si128((const __m128i *)state), 0x1B);
+    __m128i e0 = _mm_set_epi32((int)state[4], 0, 0, 0);
+    __m128i e1, msg0, msg1, msg2, msg3;
+
+    for (; blocks > 0; --blocks, data += HashBuilder::BLOCK_SIZE) {
+        __m128i abcd_save = abcd;
+        __m128i e0_save = e0;
+
+        // rounds 0-15 load the message
+        msg0 = _mm_shuffle_epi8(_mm_loadu_si128((const __m128i *)(data + 0)), mask);
+        e0 = _mm_add_epi32(e0, msg0);
+        e1 = abcd;
+        abcd = _mm_sha1rnds4_epu32(abcd, e0, 0);
+
+        msg1 = _mm_shuffle_epi8(_mm_loadu_si128((const __m128i *)(data + 16)), mask);
+        e1 = _mm_sha1nexte_epu32(e1, msg1);
+        e0 = abcd;
+        abcd = _mm_sha1rnds4_epu32(abcd, e1, 0);
+        msg0 = _mm_sha1msg1_epu32(msg0, msg1);
+
+        msg2 = _mm_shuffle_epi8(_mm_loadu_si128((const __m128i *)(data + 32)), mask);
+        e0 = _mm_sha1nexte_epu32(e0, msg2);
+        e1 = abcd;
+        abcd = _mm_sha1rnds4_epu32(abcd, e0, 0);
+        msg1 = _mm_sha1msg1_epu32(msg1, msg2);
+        msg0 = _mm_xor_si128(msg0, msg2);
+
+        msg3 = _mm_shuffle_epi8(_mm_loadu_si128((const __m128i *)(data + 48)), mask);
+        SHA1_NI_ROUNDS(0, e1, e0, msg3, msg0, msg1, msg2)
+
+        // rounds 16-79 (the schedule of the last rounds is not used)
+        SHA1_NI_ROUNDS(0, e0, e1, msg0, msg1, msg2, msg3)
+        SHA1_NI_ROUNDS(1, e1, e0, msg1, msg2, msg3, msg0)
+        SHA1_NI_ROUNDS(1, e0, e1, msg2, msg3, msg0, msg1)
+        SHA1_NI_ROUNDS(1, e1, e0, msg3, msg0, msg1, msg2)
+        SHA1_NI_ROUNDS(1, e0, e1, msg0, msg1, msg2, msg3)
+        SHA1_NI_ROUNDS(1, e1, e0, msg1, msg2, msg3, msg0)
+        SHA1_NI_ROUNDS(2, e0, e1, msg2, msg3, msg0, msg1)
+        SHA1_NI_ROUNDS(2, e1, e0, msg3, msg0, msg1, msg2)
+        SHA1_NI_ROUNDS(2, e0, e1, msg0, msg1, msg2, msg3)
+        SHA1_NI_ROUNDS(2, e1, e0, msg1, msg2, msg3, msg0)
+        SHA1_NI_ROUNDS(2, e0, e1, msg2, msg3, msg0, msg1)
+        SHA1_NI_ROUNDS(3, e1, e0, msg3, msg0, msg1, msg2)
+        SHA1_NI_ROUNDS(3, e0, e1, msg0, msg1, msg2, msg3)
+        SHA1_NI_ROUNDS(3, e1, e0, msg1, msg2, msg3, msg0)
+        SHA1_NI_ROUNDS(3, e0, e1, msg2, msg3, msg0, msg1)
+        SHA1_NI_ROUNDS(3, e1, e0, msg3, msg0, msg1, msg2)
+
+        e0 = _mm_sha1nexte_epu32(e0, e0_save);
+        abcd = _mm_add_epi32(abcd, abcd_save);
+    }
+
+    _mm_storeu_si128((__m128i *)state, _mm_shuffle_epi32(abcd, 0x1B));
+    state[4] = (uint32_t)_mm_extract_epi32(e0, 3);
+}
+#endif
+
+#ifdef SHA1_ARM
+/*
+ * ARMv8 SHA1 instructions: each sha1c/p/m calculates 4 rounds.
+ */
+static void sha1BlocksNI(uint32_t state[5], const uint8_t *data, size_t blocks) {
+    static const uint32_t k[4] = {0x5A827999, 0x6ED9EBA1, 0x8F1BBCDC, 0xCA62C1D6};
+    uint32x4_t abcd = vld1q_u32(state);
+    uint32_t e = state[4];
+
+    for (; blocks > 0; --blocks, data += HashBuilder::BLOCK_SIZE) {
+        uint32x4_t abcd_save = abcd;
+        uint32_t e_save = e;
+        uint32x4_t msg[4];
+        for (unsigned int i = 0; i < 4; ++i) {
+            msg[i] = vreinterpretq_u32_u8(vrev32q_u8(vld1q_u8(data + i * 16)));
+        }
+
+        for (unsigned int g = 0; g < 20; ++g) {
+            uint32x4_t tmp = vaddq_u32(msg[g % 4], vdupq_n_u32(k[g / 5]));
+            uint32_t e_next = vsha1h_u32(vgetq_lane_u32(abcd, 0));
+            if (g < 5) {
+                abcd = vsha1cq_u32(abcd, e, tmp);
+            } else if (g < 10 || g >= 15) {
+                abcd = vsha1pq_u32(abcd, e, tmp);
+            } else {
+                abcd = vsha1mq_u32(abcd, e, tmp);
+            }
+            e = e_next;
+            if (g < 16) {
+                msg[g % 4] = vsha1su1q_u32(vsha1su0q_u32(msg[g % 4], msg[(g + 1) % 4], msg[(g + 2) % 4]),
+                                           msg[(g + 3) % 4]);
+            }
+        }
+
+        abcd = vaddq_u32(abcd, abcd_save);
+        e += e_save;
+    }
+
+    vst1q_u32(state, abcd);
+    state[4] = e;
+}
+#endif
+
+void SHA1Builder::processBlocks(const uint8_t *data, size_t blocks) {
+#if defined(SHA1_X86) || defined(SHA1_ARM)
+    if (hasSHAExtensions()) {
+        sha1BlocksNI(_state, data, blocks);
+        return;
+    }
+#endif
+    sha1Blocks(_state, data, blocks);
+}
+
+void SHA1Builder::begin(void) {
+    _size = 0;
+
+    _state[0] = 0x67452301;
+    _state[1] = 0xEFCDAB89;
+    _state[2] = 0x98BADCFE;
+    _state[3] = 0x10325476;
+    _state[4] = 0xC3D2E1F0;
+}
+
+void SHA1Builder::calculate(void) {
+    addPadding(true);
+
+    // Move the result into digest (big-endian)
+    for (unsigned int i = 0; i < 5; ++i) {
+        _digest[(i * 4) + 0] = (uint8_t)(_state[i] >> 24);
+        _digest[(i * 4) + 1] = (uint8_t)(_state[i] >> 16);
+        _digest[(i * 4) + 2] = (uint8_t)(_state[i] >> 8);
+        _digest[(i * 4) + 3] = (uint8_t)(_state[i]);
+    }
+}
@@ -0,0 +1,39 @@
+/*
+  SHA1Builder.h
+  Copyright (c) 2025 Phil Schatzmann. All right reserved.
+
+  This library is free software; you can redistribute it and/or
+  modify it under the terms of the GNU Lesser General Public
+  License as published by the Free Software Foundation; either
+  version 2.1 of the License, or (at your option) any later version.
+
+  This library is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+  Lesser General Public License for more details.
+
+  You should have received a copy of the GNU Lesser General Public
+  License along with this library; if not, write to the Free Software
+  Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA 02110-1301 USA
+*/
+
+
+#pragma once
+
+#include <HashBuilder.h>
+
+/**
+ * @brief SHA-1 of the added data: the SHA-NI (x86) or ARMv8 SHA1 instructions
+ * are used when they are available.
+ */
+class SHA1Builder : public HashBuilder {
+private:
+    uint32_t _state[5];    // Current accumulation of hash
+public:
+    SHA1Builder() : HashBuilder(20) {}
+    void begin(void) override;
+    void calculate(void) override;
+
+protected:
+    void processBlocks(const uint8_t * data, size_t blocks) override;
+};
@@ -0,0 +1,236 @@
+/*
+  SHA256Builder.cpp
+  Copyright (c) 2025 Phil Schatzmann. All right reserved.
+
+  This library is free software; you can redistribute it and/or
+  modify it under the terms of the GNU Lesser General Public
+  License as published by the Free Software Foundation; either
+  version 2.1 of the License, or (at your option) any later version.
+
+  This library is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+  Lesser General Public License for more details.
+
+  You should have received a copy of the GNU Lesser General Public
+  License along with this library; if not, write to the Free Software
+  Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA 02110-1301 USA
+*/
+
+#include <Arduino.h>
+#include <SHA256Builder.h>
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#define SHA256_X86
+#include <immintrin.h>
+#elif defined(__ARM_FEATURE_SHA2) || defined(__ARM_FEATURE_CRYPTO)
+#define SHA256_ARM
+#include <arm_neon.h>
+#endif
+
+static const uint32_t K[64] = {
+    0x428a2f98, 0x71374491, 0xb5c0fbcf, 0xe9b5dba5, 0x3956c25b, 0x59f111f1, 0x923f82a4, 0xab1c5ed5,
+    0xd807aa98, 0x12835b01, 0x243185be, 0x550c7dc3, 0x72be5d74, 0x80deb1fe, 0x9bdc06a7, 0xc19bf174,
+    0xe49b69c1, 0xefbe4786, 0x0fc19dc6, 0x240ca1cc, 0x2de92c6f, 0x4a7484aa, 0x5cb0a9dc, 0x76f988da,
+    0x983e5152, 0xa831c66d, 0xb00327c8, 0xbf597fc7, 0xc6e00bf3, 0xd5a79147, 0x06ca6351, 0x14292967,
+    0x27b70a85, 0x2e1b2138, 0x4d2c6dfc, 0x53380d13, 0x650a7354, 0x766a0abb, 0x81c2c92e, 0x92722c85,
+    0xa2bfe8a1, 0xa81a664b, 0xc24b8b70, 0xc76c51a3, 0xd192e819, 0xd6990624, 0xf40e3585, 0x106aa070,
+    0x19a4c116, 0x1e376c08, 0x2748774c, 0x34b0bcb5, 0x391c0cb3, 0x4ed8aa4a, 0x5b9cca4f, 0x682e6ff3,
+    0x748f82ee, 0x78a5636f, 0x84c87814, 0x8cc70208, 0x90befffa, 0xa4506ceb, 0xbef9a3f7, 0xc67178f2};
+
+static inline uint32_t load32be(const uint8_t *p) {
+    return (uint32_t)p[0] << 24 | (uint32_t)p[1] << 16 | (uint32_t)p[2] << 8 | (uint32_t)p[3];
+}
+
+static inline uint32_t ror32(uint32_t x, int n) {
+    return (x >> n) | (x << (32 - n));
+}
+
+/*
+ * Rounds of SHA-256: the message schedule is calculated in place in w[16]
+ */
+#define SHA256_SUM0(x) (ror32(x, 2) ^ ror32(x, 13) ^ ror32(x, 22))
+#define SHA256_SUM1(x) (ror32(x, 6) ^ ror32(x, 11) ^ ror32(x, 25))
+#define SHA256_SIG0(x) (ror32(x, 7) ^ ror32(x, 18) ^ ((x) >> 3))
+#define SHA256_SIG1(x) (ror32(x, 17) ^ ror32(x, 19) ^ ((x) >> 10))
+#define SHA256_W(i) (w[i])
+#define SHA256_SCHEDULE(i) \
+    (w[(i) & 15] += SHA256_SIG1(w[((i) - 2) & 15]) + w[((i) - 7) & 15] + SHA256_SIG0(w[((i) - 15) & 15]))
+#define SHA256_ROUND(a, b, c, d, e, f, g, h, i, W)                              \
+    t = h + SHA256_SUM1(e) + (g ^ (e & (f ^ g))) + K[i] + W(i);                \
+    d += t;                                                                     \
+    h = t + SHA256_SUM0(a) + ((a & b) | (c & (a | b)));
+#define SHA256_ROUND8(i, W)                        \
+    SHA256_ROUND(a, b, c, d, e, f, g, h, i, W)     \
+    SHA256_ROUND(h, a, b, c, d, e, f, g, i + 1, W) \
+    SHA256_ROUND(g, h, a, b, c, d, e, f, i + 2, W) \
+    SHA256_ROUND(f, g, h, a, b, c, d, e, i + 3, W) \
+    SHA256_ROUND(e, f, g, h, a, b, c, d, i + 4, W) \
+    SHA256_ROUND(d, e, f, g, h, a, b, c, i + 5, W) \
+    SHA256_ROUND(c, d, e, f, g, h, a, b, i + 6, W) \
+    SHA256_ROUND(b, c, d, e, f, g, h, a, i + 7, W)
+
+static void sha256Blocks(uint32_t state[8], const uint8_t *data, size_t blocks) {
+    uint32_t w[16];
+    uint32_t t;
+    for (; blocks > 0; --blocks, data += HashBuilder::BLOCK_SIZE) {
+        for (unsigned int i = 0; i < 16; ++i) {
+            w[i] = load32be(data + i * 4);
+        }
+        uint32_t a = state[0], b = state[1], c = state[2], d = state[3];
+        uint32_t e = state[4], f = state[5], g = state[6], h = state[7];
+
+        SHA256_ROUND8(0, SHA256_W)
+        SHA256_ROUND8(8, SHA256_W)
+        for (unsigned int i = 16; i < 64; i += 8) {
+            SHA256_ROUND8(i, SHA256_SCHEDULE)
+        }
+
+        state[0] += a;
+        state[1] += b;
+        state[2] += c;
+        state[3] += d;
+        state[4] += e;
+        state[5] += f;
+        state[6] += g;
+        state[7] += h;
+    }
+}
+
+#ifdef SHA256_X86
+/*
+ * SHA-NI: the state is kept as ABEF/CDGH and each sha256rnds2 calculates 2
+ * rounds. The message schedule of the next group is calculated while the
+ * rounds of the current group are processed.
+ */
+#define SHA256_NI_ROUNDS(i, cur)                                                 \
+    msg = _mm_add_epi32(cur, _mm_loadu_si128((const __m128i *)&K[i]));          \
+    state1 = _mm_sha256rnds2_epu32(state1, state0, msg);                        \
+    state0 = _mm_sha256rnds2_epu32(state0, state1, _mm_shuffle_epi32(msg, 0x0E));
+#define SHA256_NI_SCHEDULE(i, prev, cur, next)                                   \
+    msg = _mm_add_epi32(cur, _mm_loadu_si128((const __m128i *)&K[i]));          \
+    state1 = _mm_sha256rnds2_epu32(state1, state0, msg);                        \
+    next = _mm_sha256msg2_epu32(_mm_add_epi32(next, _mm_alignr_epi8(cur, prev, 4)), cur); \
+    state0 = _mm_sha256rnds2_epu32(state0, state1, _mm_shuffle_epi32(msg, 0x0E)); \
+    prev = _mm_sha256msg1_epu32(prev, cur);
+
+__attribute__((target("sha,sse4.1")))
+static void sha256BlocksNI(uint32_t state[8], const uint8_t *data, size_t blocks) {
+    const __m128i mask = _mm_set_epi64x(0x0c0d0e0f08090a0bULL, 0x0405060700010203ULL);
+    __m128i tmp = _mm_shuffle_epi32(_mm_loadu_si128((const __m128i *)&state[0]), 0xB1);  // CDAB
+    __m128i state1 = _mm_shuffle_epi32(_mm_loadu_si128((const __m128i *)&state[4]), 0x1B);  // EFGH
+    __m128i state0 = _mm_alignr_epi8(tmp, state1, 8);  // ABEF
+    state1 = _mm_blend_epi16(state1, tmp, 0xF0);     // CDGH
+    __m128i msg, msg0, msg1, msg2, msg3;
+
+    for (; blocks > 0; --blocks, data += HashBuilder::BLOCK_SIZE) {
+        __m128i abef_save = state0;
+        __m128i cdgh_save = state1;
+
+        msg0 = _mm_shuffle_epi8(_mm_loadu_si128((const __m128i *)(data + 0)), mask);
+        SHA256_NI_ROUNDS(0, msg0)
+        msg1 = _mm_shuffle_epi8(_mm_loadu_si128((const __m128i *)(data + 16)), mask);
+        SHA256_NI_ROUNDS(4, msg1)
+        msg0 = _mm_sha256msg1_epu32(msg0, msg1);
+        msg2 = _mm_shuffle_epi8(_mm_loadu_si128((const __m128i *)(data + 32)), mask);
+        SHA256_NI_ROUNDS(8, msg2)
+        msg1 = _mm_sha256msg1_epu32(msg1, msg2);
+        msg3 = _mm_shuffle_epi8(_mm_loadu_si128((const __m128i *)(data + 48)), mask);
+
+        // the schedule of the last rounds is not used
+        SHA256_NI_SCHEDULE(12, msg2, msg3, msg0)
+        SHA256_NI_SCHEDULE(16, msg3, msg0, msg1)
+        SHA256_NI_SCHEDULE(20, msg0, msg1, msg2)
+        SHA256_NI_SCHEDULE(24, msg1, msg2, msg3)
+        SHA256_NI_SCHEDULE(28, msg2, msg3, msg0)
+        SHA256_NI_SCHEDULE(32, msg3, msg0, msg1)
+        SHA256_NI_SCHEDULE(36, msg0, msg1, msg2)
+        SHA256_NI_SCHEDULE(40, msg1, msg2, msg3)
+        SHA256_NI_SCHEDULE(44, msg2, msg3, msg0)
+        SHA256_NI_SCHEDULE(48, msg3, msg0, msg1)
+        SHA256_NI_SCHEDULE(52, msg0, msg1, msg2)
+        SHA256_NI_SCHEDULE(56, msg1, msg2, msg3)
+        SHA256_NI_ROUNDS(60, msg3)
+
+        state0 = _mm_add_epi32(state0, abef_save);
+        state1 = _mm_add_epi32(state1, cdgh_save);
+    }
+
+    tmp = _mm_shuffle_epi32(state0, 0x1B);     // FEBA
+    state1 = _mm_shuffle_epi32(state1, 0xB1);  // DCHG
+    state0 = _mm_blend_epi16(tmp, state1, 0xF0);  // DCBA
+    state1 = _mm_alignr_epi8(state1, tmp, 8);     // HGFE
+    _mm_storeu_si128((__m128i *)&state[0], state0);
+    _mm_storeu_si128((__m128i *)&state[4], state1);
+}
+#endif
+
+#ifdef SHA256_ARM
+/*
+ * ARMv8 SHA2 instructions: each sha256h/h2 pair calculates 4 rounds.
+ */
+static void sha256BlocksNI(uint32_t state[8], const uint8_t *data, size_t blocks) {
+    uint32x4_t state0 = vld1q_u32(&state[0]);
+    uint32x4_t state1 = vld1q_u32(&state[4]);
+
+    for (; blocks > 0; --blocks, data += HashBuilder::BLOCK_SIZE) {
+        uint32x4_t abcd_save = state0;
+        uint32x4_t efgh_save = state1;
+        uint32x4_t msg[4];
+        for (unsigned int i = 0; i < 4; ++i) {
+            msg[i] = vreinterpretq_u32_u8(vrev32q_u8(vld1q_u8(data + i * 16)));
+        }
+
+        for (unsigned int g = 0; g < 16; ++g) {
+            uint32x4_t tmp = vaddq_u32(msg[g % 4], vld1q_u32(&K[g * 4]));
+            uint32x4_t abcd = state0;
+            state0 = vsha256hq_u32(state0, state1, tmp);
+            state1 = vsha256h2q_u32(state1, abcd, tmp);
+            if (g < 12) {
+                msg[g % 4] = vsha256su1q_u32(vsha256su0q_u32(msg[g % 4], msg[(g + 1) % 4]),
+                                             msg[(g + 2) % 4], msg[(g + 3) % 4]);
+            }
+        }
+
+        state0 = vaddq_u32(state0, abcd_save);
+        state1 = vaddq_u32(state1, efgh_save);
+    }
+
+    vst1q_u32(&state[0], state0);
+    vst1q_u32(&state[4], state1);
+}
+#endif
+
+void SHA256Builder::processBlocks(const uint8_t *data, size_t blocks) {
+#if defined(SHA256_X86) || defined(SHA256_ARM)
+    if (hasSHAExtensions()) {
+        sha256BlocksNI(_state, data, blocks);
+        return;
+    }
+#endif
+    sha256Blocks(_state, data, blocks);
+}
+
+void SHA256Builder::begin(void) {
+    _size = 0;
+
+    _state[0] = 0x6a09e667;
+    _state[1] = 0xbb67ae85;
+    _state[2] = 0x3c6ef372;
+    _state[3] = 0xa54ff53a;
+    _state[4] = 0x510e527f;
+    _state[5] = 0x9b05688c;
+    _state[6] = 0x1f83d9ab;
+    _state[7] = 0x5be0cd19;
+}
+
+void SHA256Builder::calculate(void) {
+    addPadding(true);
+
+    // Move the result into digest (big-endian)
+    for (unsigned int i = 0; i < 8; ++i) {
+        _digest[(i * 4) + 0] = (uint8_t)(_state[i] >> 24);
+        _digest[(i * 4) + 1] = (uint8_t)(_state[i] >> 16);
+        _digest[(i * 4) + 2] = (uint8_t)(_state[i] >> 8);
+        _digest[(i * 4) + 3] = (uint8_t)(_state[i]);
+    }
+}
@@ -21,6 +21,20 @@
 
 #if USE_SERIALLIB
 
+#include <poll.h>
+#include <sys/eventfd.h>
+#include <sys/uio.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+#include "ArduinoLogger.h"
 #include "serialib.h"
 #include "api/HardwareSerial.h"
 
@@ -29,12 +43,19 @@ namespace arduino {
 /**
  * Arduino Stream implementation which is using serialib
  * https://github.com/imabot2/serialib
+ *
+ * A background thread moves the received data into a lock-free RX ring and
+ * drains the TX ring with writev(), so that read() and write() do not need a
+ * system call per byte. flush() waits until the TX ring is empty and the
+ * data was transmitted (tcdrain).
  */
 
 class SerialImpl : public HardwareSerial {
  public:
   SerialImpl(const char* device = "/dev/ttyACM0") { this->device = device; }
 
+  ~SerialImpl() { end(); }
+
   virtual void begin(unsigned long baudrate) { open(baudrate); }
 
   virtual void begin(unsigned long baudrate, uint16_t config) {
@@ -42,34 +63,87 @@ class SerialImpl : public HardwareSerial {
   }
 
   virtual void end() {
+    stopThread();
+    if (is_open) serial.closeDevice();
     is_open = false;
-    serial.closeDevice();
   }
 
-  virtual int available(void) { return serial.available(); };
+  /// Defines the size of the RX ring (rounded up to a power of 2): call
+  /// before begin()
+  void setRxBufferSize(size_t size) { rx.resize(size); }
+
+  /// Defines the size of the TX ring (rounded up to a power of 2): call
+  /// before begin()
+  void setTxBufferSize(size_t size) { tx.resize(size); }
+
+  virtual int available(void) { return rx.available(); };
 
   virtual int peek(void) {
-    if (peek_char == -1) {
-      peek_char = read();
-    }
-    return peek_char;
+    if (!waitForData(1)) return -1;
+    return rx.peek();
   }
 
   virtual int read(void) {
-    int result = -1;
-    if (peek_char != -1) {
-      result = peek_char;
-      peek_char = -1;
-    } else {
-      char c;
-      result = serial.readChar(&c, timeout);
+    uint8_t c;
+    if (!waitForData(1)) return -1;
+    rx.read(&c, 1);
+    wakeupIfFull();
+    return c;
+  };
+
+  /// Reads the data in bulk from the RX ring: waits until the data is
+  /// available or the timeout is reached
+  size_t readBytes(uint8_t* buffer, size_t length) {
+    size_t result = 0;
+    auto end = std::chrono::steady_clock::now() + std::chrono::milliseconds(timeout);
+    while (result < length) {
+      result += rx.read(buffer + result, length - result);
+      wakeupIfFull();
+      if (result >= length) break;
+      std::unique_lock<std::mutex> lock(rx_mutex);
+      if (!rx_cond.wait_until(lock, end, [this] {
+            return rx.available() > 0 || !is_running;
+          }))
+        break;
+      if (!is_running && rx.available() == 0) break;
     }
     return result;
+  }
+
+  size_t readBytes(char* buffer, size_t length) {
+    return readBytes((uint8_t*)buffer, length);
+  }
+
+  /// Waits until all data has been transmitted
+  virtual void flush(void) {
+    if (!is_running) return;
+    wakeup();
+    {
+      std::unique_lock<std::mutex> lock(tx_mutex);
+      tx_cond.wait(lock, [this] { return tx.available() == 0 || !is_running; });
+    }
+    serial.drainTransmitter();
   };
 
-  virtual void flush(void) {};
+  virtual size_t write(uint8_t c) { return write(&c, 1); }
+
+  virtual size_t write(const uint8_t* data, size_t len) {
+    if (!is_running) return 0;
+    size_t result = 0;
+    while (result < len) {
+      size_t n = tx.write(data + result, len - result);
+      result += n;
+      if (n > 0) wakeup();
+      if (result >= len) break;
+      // the TX ring is full
+      std::unique_lock<std::mutex> lock(tx_mutex);
+      tx_cond.wait(lock, [this] { return tx.availableToWrite() > 0 || !is_running; });
+      if (!is_running) break;
+    }
+    return result;
+  }
 
-  virtual size_t write(uint8_t c) { return serial.writeChar(c); }
+  virtual int availableForWrite() { return tx.availableToWrite(); }
 
   virtual operator bool() { return is_open; }
 
@@ -80,20 +154,233 @@ class SerialImpl : public HardwareSerial {
   }
 
  protected:
+  /// Lock-free ring for a single producer and a single consumer
+  class Ring {
+   public:
+    Ring(size_t size) { resize(size); }
+
+    void resize(size_t size) {
+      size_t len = 1;
+      while (len < size) len <<= 1;
+      data.resize(len);
+      mask = len - 1;
+      head = 0;
+      tail = 0;
+    }
+
+    size_t available() {
+      return head.load(std::memory_order_acquire) -
+             tail.load(std::memory_order_relaxed);
+    }
+
+    size_t availableToWrite() {
+      return data.size() - (head.load(std::memory_order_relaxed) -
+                            tail.load(std::memory_order_acquire));
+    }
+
+    int peek() {
+      if (available() == 0) return -1;
+      return data[tail.load(std::memory_order_relaxed) & mask];
+    }
+
+    size_t read(uint8_t* buffer, size_t len) {
+      size_t t = tail.load(std::memory_order_relaxed);
+      size_t n = std::min(len, available());
+      for (size_t j = 0; j < n; j++) buffer[j] = data[(t + j) & mask];
+      tail.store(t + n, std::memory_order_release);
+      return n;
+    }
+
+    size_t write(const uint8_t* buffer, size_t len) {
+      size_t h = head.load(std::memory_order_relaxed);
+      size_t n = std::min(len, availableToWrite());
+      for (size_t j = 0; j < n; j++) data[(h + j) & mask] = buffer[j];
+      head.store(h + n, std::memory_order_release);
+      return n;
+    }
+
+    /// Provides the readable data as (max 2) io vectors
+    int readSegments(struct iovec* iov) {
+      size_t len = available();
+      if (len == 0) return 0;
+      size_t pos = tail.load(std::memory_order_relaxed) & mask;
+      size_t first = std::min(len, data.size() - pos);
+      iov[0].iov_base = &data[pos];
+      iov[0].iov_len = first;
+      if (first == len) return 1;
+      iov[1].iov_base = &data[0];
+      iov[1].iov_len = len - first;
+      return 2;
+    }
+
+    /// Provides the writable space as (max 2) io vectors
+    int writeSegments(struct iovec* iov) {
+      size_t len = availableToWrite();
+      if (len == 0) return 0;
+      size_t pos = head.load(std::memory_order_relaxed) & mask;
+      size_t first = std::min(len, data.size() - pos);
+      iov[0].iov_base = &data[pos];
+      iov[0].iov_len = first;
+      if (first == len) return 1;
+      iov[1].iov_base = &data[0];
+      iov[1].iov_len = len - first;
+      return 2;
+    }
+
+    void consumed(size_t n) {
+      tail.store(tail.load(std::memory_order_relaxed) + n,
+                 std::memory_order_release);
+    }
+
+    void produced(size_t n) {
+      head.store(head.load(std::memory_order_relaxed) + n,
+                 std::memory_order_release);
+    }
+
+   protected:
+    std::vector<uint8_t> data;
+    size_t mask = 0;
+    std::atomic<size_t> head{0};
+    std::atomic<size_t> tail{0};
+  };
+
   const char* device;
   serialib serial;
   bool is_open = false;
-  int peek_char = -1;
   long timeout = 1000;
+  Ring rx{4096};
+  Ring tx{4096};
+  std::thread io_thread;
+  std::atomic<bool> is_running{false};
+  std::atomic<bool> is_wakeup_pending{false};
+  std::atomic<bool> is_rx_full{false};
+  int wakeup_fd = -1;
+  std::mutex rx_mutex;
+  std::condition_variable rx_cond;
+  std::mutex tx_mutex;
+  std::condition_variable tx_cond;
 
   virtual void open(unsigned long baudrate) {
-    if (!serial.openDevice(device, baudrate)) {
+    end();
+    if (serial.openDevice(device, baudrate) != 1) {
       Logger.error("SerialImpl", "could not open", device);
+      return;
     }
     is_open = true;
+    startThread();
+  }
+
+  void startThread() {
+    wakeup_fd = eventfd(0, EFD_NONBLOCK);
+    if (wakeup_fd < 0) {
+      Logger.error("SerialImpl", "eventfd failed");
+      return;
+    }
+    is_running = true;
+    io_thread = std::thread(&SerialImpl::ioThread, this);
+  }
+
+  void stopThread() {
+    if (!io_thread.joinable()) return;
+    is_running = false;
+    is_wakeup_pending = false;
+    wakeup();
+    io_thread.join();
+    ::close(wakeup_fd);
+    wakeup_fd = -1;
+    rx_cond.notify_all();
+    tx_cond.notify_all();
+  }
+
+  /// Notifies the IO thread: at most once per loop of the thread
+  void wakeup() {
+    if (!is_wakeup_pending.exchange(true)) {
+      uint64_t value = 1;
+      if (::write(wakeup_fd, &value, sizeof(value)) < 0) is_wakeup_pending = false;
+    }
+  }
+
+  /// The IO thread stops reading when the RX ring is full: restart it
+  void wakeupIfFull() {
+    if (is_rx_full && is_rx_full.exchange(false)) wakeup();
+  }
+
+  bool waitForData(size_t len) {
+    if (rx.available() >= len) return true;
+    std::unique_lock<std::mutex> lock(rx_mutex);
+    return rx_cond.wait_for(lock, std::chrono::milliseconds(timeout), [&] {
+      return rx.available() >= len || !is_running;
+    }) && rx.available() >= len;
+  }
+
+  void ioThread() {
+    int fd = serial.fileDescriptor();
+    struct iovec iov[2];
+    while (is_running) {
+      struct pollfd fds[2];
+      fds[0].fd = fd;
+      fds[0].events = 0;
+      fds[0].revents = 0;
+      if (rx.availableToWrite() > 0) {
+        fds[0].events |= POLLIN;
+      } else {
+        is_rx_full = true;
+        // the reader might have emptied the ring in the meantime
+        if (rx.availableToWrite() > 0) continue;
+      }
+      if (tx.available() > 0) fds[0].events |= POLLOUT;
+      fds[1].fd = wakeup_fd;
+      fds[1].events = POLLIN;
+      fds[1].revents = 0;
+      if (poll(fds, 2, -1) < 0) {
+        if (errno == EINTR) continue;
+        Logger.error("SerialImpl", "poll failed");
+        break;
+      }
+
+      if (fds[1].revents & POLLIN) {
+        uint64_t value;
+        while (::read(wakeup_fd, &value, sizeof(value)) > 0);
+        is_wakeup_pending = false;
+      }
+
+      // receive directly into the RX ring
+      if (fds[0].revents & POLLIN) {
+        int n = rx.writeSegments(iov);
+        ssize_t len = n > 0 ? readv(fd, iov, n) : 0;
+        if (len > 0) {
+          rx.produced(len);
+          std::lock_guard<std::mutex> lock(rx_mutex);
+          rx_cond.notify_all();
+        }
+      }
+
+      // send the TX ring
+      if (fds[0].revents & POLLOUT) {
+        int n = tx.readSegments(iov);
+        ssize_t len = n > 0 ? writev(fd, iov, n) : 0;
+        if (len > 0) {
+          tx.consumed(len);
+          std::lock_guard<std::mutex> lock(tx_mutex);
+          tx_cond.notify_all();
+        }
+      }
+
+      if (fds[0].revents & (POLLERR | POLLNVAL)) {
+        Logger.error("SerialImpl", "device error", device);
+        break;
+      }
+      // avoid a busy loop if the other side was closed
+      if ((fds[0].revents & POLLHUP) && !(fds[0].revents & POLLIN)) {
+        std::this_thread::sleep_for(std::chrono::milliseconds(10));
+      }
+    }
+    is_running = false;
+    rx_cond.notify_all();
+    tx_cond.notify_all();
   }
 };
 
 }  // namespace arduino
 
-#endif
\ No newline at end of file
+#endif
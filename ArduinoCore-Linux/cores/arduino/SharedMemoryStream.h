@@ -0,0 +1,352 @@
+/*
+  SharedMemoryStream.h
+  Copyright (c) 2025 Phil Schatzmann. All right reserved.
+
+  This library is free software; you can redistribute it and/or
+  modify it under the terms of the GNU Lesser General Public
+  License as published by the Free Software Foundation; either
+  version 2.1 of the License, or (at your option) any later version.
+
+  This library is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+  Lesser General Public License for more details.
+
+  You should have received a copy of the GNU Lesser General Public
+  License along with this library; if not, write to the Free Software
+  Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA 02110-1301 USA
+*/
+
+#pragma once
+#include <errno.h>
+#include <fcntl.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#if defined(__linux__)
+#include <linux/futex.h>
+#include <sys/syscall.h>
+#include <time.h>
+#endif
+
+#include <atomic>
+#include <new>
+#include <string>
+
+#include "ArduinoLogger.h"
+#include "WaitableStream.h"
+#include "api/Stream.h"
+
+namespace arduino {
+
+/**
+ * @brief Stream between two processes on the same host via shared memory
+ *
+ * The shared memory contains two single producer / single consumer ring
+ * buffers: one for each direction. One process calls create(), the other one
+ * open() with the same name. Reading and writing only access the mapped
+ * memory: there are no syscalls unless a side needs to wait, in which case
+ * it sleeps on a futex and is woken up by the other side. So this can
+ * replace a socket based stream e.g. for the remote hardware protocol when
+ * the device is a simulator running on the same machine.
+ *
+ * read(), peek() and available() do not block. readBytes() waits up to the
+ * timeout for data, write() waits up to the timeout if the ring is full.
+ * Users which only have a Stream pointer can sleep via the WaitableStream
+ * interface.
+ */
+class SharedMemoryStream : public Stream, public WaitableStream {
+ public:
+  SharedMemoryStream() = default;
+
+  ~SharedMemoryStream() { end(); }
+
+  /// Creates the shared memory with the indicated ring size (rounded up to a
+  /// power of 2): e.g. done by the emulator. Fails if the name exists, unless
+  /// replaceStale is true: e.g. after a crash. A replaced segment is only
+  /// unlinked, so a process which still maps it is not affected.
+  bool create(const char* name, size_t ringSize = 64 * 1024,
+              bool replaceStale = false) {
+    end();
+    size_t size = 1024;
+    while (size < ringSize) size <<= 1;
+    int fd = ::shm_open(name, O_CREAT | O_EXCL | O_RDWR, 0600);
+    if (fd < 0 && errno == EEXIST && replaceStale) {
+      Logger.warning(SHM_STREAM, "replacing", name);
+      ::shm_unlink(name);
+      fd = ::shm_open(name, O_CREAT | O_EXCL | O_RDWR, 0600);
+    }
+    if (fd < 0) {
+      Logger.error(SHM_STREAM,
+                   errno == EEXIST ? "already exists" : "could not create",
+                   name);
+      return false;
+    }
+    size_t total = sizeof(SharedHeader) + 2 * size;
+    if (::ftruncate(fd, total) != 0 || !map(fd, total)) {
+      Logger.error(SHM_STREAM, "could not map", name);
+      ::close(fd);
+      ::shm_unlink(name);
+      return false;
+    }
+    ::close(fd);
+    // initialize the control blocks
+    p_header = new (p_mem) SharedHeader();
+    p_header->ring_size = size;
+    p_header->magic.store(MAGIC, std::memory_order_release);
+    shm_name = name;
+    is_owner = true;
+    setup(0);
+    return true;
+  }
+
+  /// Opens the shared memory which was created by the other process
+  bool open(const char* name) {
+    end();
+    int fd = ::shm_open(name, O_RDWR, 0600);
+    if (fd < 0) {
+      Logger.error(SHM_STREAM, "could not open", name);
+      return false;
+    }
+    struct stat st;
+    if (::fstat(fd, &st) != 0 || (size_t)st.st_size < sizeof(SharedHeader) ||
+        !map(fd, st.st_size)) {
+      Logger.error(SHM_STREAM, "could not map", name);
+      ::close(fd);
+      return false;
+    }
+    ::close(fd);
+    p_header = (SharedHeader*)p_mem;
+    if (p_header->magic.load(std::memory_order_acquire) != MAGIC ||
+        sizeof(SharedHeader) + 2 * p_header->ring_size > mem_size) {
+      Logger.error(SHM_STREAM, "invalid shared memory", name);
+      end();
+      return false;
+    }
+    setup(1);
+    return true;
+  }
+
+  /// Unmaps the memory; the creator also removes the name
+  void end() {
+    if (p_mem != nullptr) {
+      ::munmap(p_mem, mem_size);
+      p_mem = nullptr;
+    }
+    if (is_owner && !shm_name.empty()) {
+      ::shm_unlink(shm_name.c_str());
+    }
+    shm_name.clear();
+    is_owner = false;
+    p_header = nullptr;
+    p_tx = p_rx = nullptr;
+  }
+
+  int available() override {
+    if (p_rx == nullptr) return 0;
+    return p_rx->head.load(std::memory_order_acquire) -
+           p_rx->tail.load(std::memory_order_relaxed);
+  }
+
+  int read() override {
+    uint8_t c;
+    return readAvailable(&c, 1) == 1 ? c : -1;
+  }
+
+  int peek() override {
+    if (available() == 0) return -1;
+    return rx_data[p_rx->tail.load(std::memory_order_relaxed) & mask];
+  }
+
+  /// Waits up to the timeout for data and provides as many bytes as possible
+  size_t readBytes(uint8_t* data, size_t len) {
+    size_t result = 0;
+    unsigned long start = millis();
+    while (result < len) {
+      size_t n = readAvailable(data + result, len - result);
+      result += n;
+      if (n == 0) {
+        long remaining = (long)getTimeout() - (long)(millis() - start);
+        if (remaining <= 0 || !waitReadable(remaining)) break;
+      }
+    }
+    return result;
+  }
+
+  size_t readBytes(char* data, size_t len) {
+    return readBytes((uint8_t*)data, len);
+  }
+
+  /// Blocks until data is available or the timeout (in ms) has elapsed: a
+  /// negative timeout waits forever
+  bool waitReadable(int timeoutMs) override {
+    if (p_rx == nullptr) return false;
+    return waitFor(p_rx->head, p_rx->reader_waiting, timeoutMs,
+                   [this]() { return available() > 0; });
+  }
+
+  size_t write(uint8_t c) override { return write(&c, 1); }
+
+  size_t write(const uint8_t* data, size_t len) override {
+    if (p_tx == nullptr) return 0;
+    size_t result = 0;
+    while (result < len) {
+      uint32_t head = p_tx->head.load(std::memory_order_relaxed);
+      uint32_t tail = p_tx->tail.load(std::memory_order_acquire);
+      size_t n = min(len - result, (size_t)(ring_size - (head - tail)));
+      if (n == 0) {
+        // ring is full: wait for the reader
+        if (!waitFor(p_tx->tail, p_tx->writer_waiting, getTimeout(),
+                     [this]() { return availableForWrite() > 0; })) {
+          break;
+        }
+        continue;
+      }
+      copyIn(head, data + result, n);
+      p_tx->head.store(head + n, std::memory_order_seq_cst);
+      if (p_tx->reader_waiting.load(std::memory_order_seq_cst)) {
+        futexWake(p_tx->head);
+      }
+      result += n;
+    }
+    return result;
+  }
+
+  int availableForWrite() override {
+    if (p_tx == nullptr) return 0;
+    return ring_size - (p_tx->head.load(std::memory_order_relaxed) -
+                        p_tx->tail.load(std::memory_order_acquire));
+  }
+
+  /// the data is visible to the reader as soon as it has been written
+  void flush() override {}
+
+  operator bool() { return p_mem != nullptr; }
+
+ protected:
+  const char* SHM_STREAM = "SharedMemoryStream";
+  static constexpr uint32_t MAGIC = 0x53484d31;
+  /// busy polling before we go to sleep, to keep the latency low
+  static constexpr int SPIN_COUNT = 2000;
+
+  /// control block of a ring: head and tail are on separate cache lines
+  struct Ring {
+    alignas(64) std::atomic<uint32_t> head{0};
+    alignas(64) std::atomic<uint32_t> tail{0};
+    alignas(64) std::atomic<uint32_t> reader_waiting{0};
+    std::atomic<uint32_t> writer_waiting{0};
+  };
+
+  struct SharedHeader {
+    std::atomic<uint32_t> magic{0};
+    uint32_t ring_size = 0;
+    Ring ring[2];
+  };
+
+  void* p_mem = nullptr;
+  size_t mem_size = 0;
+  SharedHeader* p_header = nullptr;
+  Ring* p_tx = nullptr;
+  Ring* p_rx = nullptr;
+  uint8_t* tx_data = nullptr;
+  uint8_t* rx_data = nullptr;
+  uint32_t ring_size = 0;
+  uint32_t mask = 0;
+  std::string shm_name;
+  bool is_owner = false;
+
+  bool map(int fd, size_t size) {
+    void* mem = ::mmap(nullptr, size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    if (mem == MAP_FAILED) return false;
+    p_mem = mem;
+    mem_size = size;
+    return true;
+  }
+
+  /// the creator writes to ring 0 and the other side to ring 1
+  void setup(int txRing) {
+    ring_size = p_header->ring_size;
+    mask = ring_size - 1;
+    uint8_t* data = (uint8_t*)p_mem + sizeof(SharedHeader);
+    p_tx = &p_header->ring[txRing];
+    p_rx = &p_header->ring[1 - txRing];
+    tx_data = data + txRing * ring_size;
+    rx_data = data + (1 - txRing) * ring_size;
+  }
+
+  size_t readAvailable(uint8_t* data, size_t len) {
+    if (p_rx == nullptr) return 0;
+    uint32_t tail = p_rx->tail.load(std::memory_order_relaxed);
+    uint32_t head = p_rx->head.load(std::memory_order_acquire);
+    size_t n = min(len, (size_t)(head - tail));
+    if (n == 0) return 0;
+    // copy in max 2 parts because of the wrap around
+    size_t pos = tail & mask;
+    size_t first = min(n, (size_t)(ring_size - pos));
+    memcpy(data, rx_data + pos, first);
+    memcpy(data + first, rx_data, n - first);
+    p_rx->tail.store(tail + n, std::memory_order_seq_cst);
+    if (p_rx->writer_waiting.load(std::memory_order_seq_cst)) {
+      futexWake(p_rx->tail);
+    }
+    return n;
+  }
+
+  void copyIn(uint32_t head, const uint8_t* data, size_t n) {
+    size_t pos = head & mask;
+    size_t first = min(n, (size_t)(ring_size - pos));
+    memcpy(tx_data + pos, data, first);
+    memcpy(tx_data, data + first, n - first);
+  }
+
+  /// spins for a short time and then sleeps on the futex until the condition
+  /// is met or the timeout has elapsed (negative = no timeout)
+  template <typename Cond>
+  bool waitFor(std::atomic<uint32_t>& word, std::atomic<uint32_t>& waiting,
+               long timeoutMs, Cond isReady) {
+    for (int j = 0; j < SPIN_COUNT; j++) {
+      if (isReady()) return true;
+    }
+    unsigned long start = millis();
+    while (!isReady()) {
+      long remaining = -1;
+      if (timeoutMs >= 0) {
+        remaining = timeoutMs - (long)(millis() - start);
+        if (remaining <= 0) return false;
+      }
+      uint32_t value = word.load(std::memory_order_seq_cst);
+      waiting.store(1, std::memory_order_seq_cst);
+      // check again: the other side might have been faster
+      if (!isReady()) futexWait(word, value, remaining);
+      waiting.store(0, std::memory_order_seq_cst);
+    }
+    return true;
+  }
+
+#if defined(__linux__)
+  void futexWait(std::atomic<uint32_t>& word, uint32_t value, long timeoutMs) {
+    struct timespec ts;
+    ts.tv_sec = timeoutMs / 1000;
+    ts.tv_nsec = (timeoutMs % 1000) * 1000000;
+    ::syscall(SYS_futex, (uint32_t*)&word, FUTEX_WAIT, value,
+              timeoutMs < 0 ? nullptr : &ts, nullptr, 0);
+  }
+
+  void futexWake(std::atomic<uint32_t>& word) {
+    ::syscall(SYS_futex, (uint32_t*)&word, FUTEX_WAKE, 1, nullptr, nullptr, 0);
+  }
+#else
+  // no futex: we just poll
+  void futexWait(std::atomic<uint32_t>& word, uint32_t value, long timeoutMs) {
+    (void)word;
+    (void)value;
+    (void)timeoutMs;
+    ::usleep(50);
+  }
+
+  void futexWake(std::atomic<uint32_t>& word) { (void)word; }
+#endif
+};
+
+}  // namespace arduino
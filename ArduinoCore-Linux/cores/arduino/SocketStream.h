@@ -0,0 +1,354 @@
+/*
+  SocketStream.h
+  Copyright (c) 2025 Phil Schatzmann. All right reserved.
+
+  This library is free software; you can redistribute it and/or
+  modify it under the terms of the GNU Lesser General Public
+  License as published by the Free Software Foundation; either
+  version 2.1 of the License, or (at your option) any later version.
+
+  This library is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+  Lesser General Public License for more details.
+
+  You should have received a copy of the GNU Lesser General Public
+  License along with this library; if not, write to the Free Software
+  Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA 02110-1301 USA
+*/
+
+#pragma once
+#include <arpa/inet.h>
+#include <errno.h>
+#include <netdb.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <poll.h>
+#include <string.h>
+#include <sys/ioctl.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+#include <string>
+
+#include "ArduinoLogger.h"
+#include "WaitableStream.h"
+#include "api/Stream.h"
+
+namespace arduino {
+
+/**
+ * @brief Stream over a connected TCP or unix domain socket
+ *
+ * SocketStream provides a low latency byte stream e.g. for the remote
+ * hardware protocol. It can either wait for a single peer to connect
+ * (listenTCP(), listenUnix()) or connect to a peer (connectTCP(),
+ * connectUnix()). TCP sockets use TCP_NODELAY, so small requests are not
+ * delayed by Nagle's algorithm.
+ *
+ * Written data is collected in a buffer and sent with flush() or when the
+ * buffer is full. Received data is read in blocks into a buffer. With
+ * waitReadable() you can block in poll() until data arrives instead of
+ * polling available(). When the peer closes the connection the stream is
+ * marked as closed: operator bool and waitReadable() return false.
+ */
+class SocketStream : public Stream, public WaitableStream {
+ public:
+  SocketStream() = default;
+
+  /// Uses an already connected socket
+  SocketStream(int fd) { sock = fd; }
+
+  ~SocketStream() { end(); }
+
+  // the socket is owned by the object
+  SocketStream(const SocketStream&) = delete;
+  SocketStream& operator=(const SocketStream&) = delete;
+
+  /// Waits for a peer to connect on the indicated TCP port
+  bool listenTCP(uint16_t port, int timeoutMs = -1) {
+    end();
+    int server = ::socket(AF_INET, SOCK_STREAM, 0);
+    if (server < 0) {
+      Logger.error(SOCKET_STREAM, "could not create socket");
+      return false;
+    }
+    int yes = 1;
+    setsockopt(server, SOL_SOCKET, SO_REUSEADDR, &yes, sizeof(yes));
+    struct sockaddr_in addr;
+    memset(&addr, 0, sizeof(addr));
+    addr.sin_family = AF_INET;
+    addr.sin_addr.s_addr = INADDR_ANY;
+    addr.sin_port = htons(port);
+    if (::bind(server, (struct sockaddr*)&addr, sizeof(addr)) < 0) {
+      Logger.error(SOCKET_STREAM, "bind failed");
+      ::close(server);
+      return false;
+    }
+    return acceptPeer(server, timeoutMs);
+  }
+
+  /// Waits for a peer to connect on the indicated unix domain socket path
+  bool listenUnix(const char* path, int timeoutMs = -1) {
+    end();
+    struct sockaddr_un addr;
+    if (!unixAddress(path, addr)) return false;
+    // remove a stale socket file from a previous run, but nothing else
+    struct stat st;
+    if (::lstat(path, &st) == 0) {
+      if (!S_ISSOCK(st.st_mode)) {
+        Logger.error(SOCKET_STREAM, "path exists and is not a socket", path);
+        return false;
+      }
+      ::unlink(path);
+    }
+    int server = ::socket(AF_UNIX, SOCK_STREAM, 0);
+    if (server < 0) {
+      Logger.error(SOCKET_STREAM, "could not create socket");
+      return false;
+    }
+    if (::bind(server, (struct sockaddr*)&addr, sizeof(addr)) < 0) {
+      Logger.error(SOCKET_STREAM, "bind failed", path);
+      ::close(server);
+      return false;
+    }
+    unix_path = path;
+    return acceptPeer(server, timeoutMs);
+  }
+
+  /// Connects to a peer which is listening on the indicated TCP port
+  bool connectTCP(const char* host, uint16_t port) {
+    end();
+    struct sockaddr_in addr;
+    memset(&addr, 0, sizeof(addr));
+    addr.sin_family = AF_INET;
+    addr.sin_port = htons(port);
+    if (::inet_pton(AF_INET, host, &addr.sin_addr) <= 0) {
+      struct hostent* he = ::gethostbyname(host);
+      if (he == nullptr || he->h_addr_list[0] == nullptr) {
+        Logger.error(SOCKET_STREAM, "could not resolve", host);
+        return false;
+      }
+      memcpy(&addr.sin_addr, he->h_addr_list[0], he->h_length);
+    }
+    int fd = ::socket(AF_INET, SOCK_STREAM, 0);
+    if (fd < 0 || ::connect(fd, (struct sockaddr*)&addr, sizeof(addr)) < 0) {
+      Logger.error(SOCKET_STREAM, "could not connect to", host);
+      if (fd >= 0) ::close(fd);
+      return false;
+    }
+    setNoDelay(fd);
+    sock = fd;
+    is_peer_closed = false;
+    return true;
+  }
+
+  /// Connects to a peer which is listening on the indicated unix domain socket
+  bool connectUnix(const char* path) {
+    end();
+    struct sockaddr_un addr;
+    if (!unixAddress(path, addr)) return false;
+    int fd = ::socket(AF_UNIX, SOCK_STREAM, 0);
+    if (fd < 0 || ::connect(fd, (struct sockaddr*)&addr, sizeof(addr)) < 0) {
+      Logger.error(SOCKET_STREAM, "could not connect to", path);
+      if (fd >= 0) ::close(fd);
+      return false;
+    }
+    sock = fd;
+    is_peer_closed = false;
+    return true;
+  }
+
+  /// Closes the connection
+  void end() {
+    if (sock >= 0) {
+      flush();
+      ::close(sock);
+      sock = -1;
+    }
+    is_peer_closed = false;
+    if (!unix_path.empty()) {
+      ::unlink(unix_path.c_str());
+      unix_path.clear();
+    }
+    rx_pos = rx_len = 0;
+    tx_len = 0;
+  }
+
+  /// Blocks until data is available or the timeout (in ms, -1 = forever)
+  /// has elapsed: returns false on timeout or if the connection is closed
+  bool waitReadable(int timeoutMs) override {
+    if (rx_pos < rx_len) return true;
+    if (sock < 0 || is_peer_closed) return false;
+    struct pollfd pfd;
+    pfd.fd = sock;
+    pfd.events = POLLIN;
+    int rc;
+    do {
+      rc = ::poll(&pfd, 1, timeoutMs);
+    } while (rc < 0 && errno == EINTR);
+    if (rc <= 0) return false;
+    if (pfd.revents & POLLIN) return true;
+    // hangup or error without pending data
+    if (pfd.revents & (POLLHUP | POLLERR | POLLNVAL)) markClosed();
+    return false;
+  }
+
+  int available() override {
+    if (rx_pos < rx_len) return rx_len - rx_pos;
+    if (sock < 0) return 0;
+    int result = 0;
+    ioctl(sock, FIONREAD, &result);
+    return result;
+  }
+
+  int read() override {
+    if (rx_pos >= rx_len && !fill()) return -1;
+    return rx_buffer[rx_pos++];
+  }
+
+  int peek() override {
+    if (rx_pos >= rx_len && !fill()) return -1;
+    return rx_buffer[rx_pos];
+  }
+
+  /// Blocks until some data is available (up to the timeout) and provides
+  /// as many bytes as possible
+  size_t readBytes(uint8_t* data, size_t len) {
+    size_t result = 0;
+    unsigned long start = millis();
+    while (result < len) {
+      if (rx_pos >= rx_len && !fill()) {
+        long remaining = (long)getTimeout() - (long)(millis() - start);
+        if (remaining <= 0 || !waitReadable(remaining) || !fill()) break;
+      }
+      size_t n = min(len - result, rx_len - rx_pos);
+      memcpy(data + result, rx_buffer + rx_pos, n);
+      rx_pos += n;
+      result += n;
+    }
+    return result;
+  }
+
+  size_t readBytes(char* data, size_t len) {
+    return readBytes((uint8_t*)data, len);
+  }
+
+  size_t write(uint8_t c) override { return write(&c, 1); }
+
+  size_t write(const uint8_t* data, size_t len) override {
+    if (sock < 0) return 0;
+    // big blocks are sent directly
+    if (tx_len + len > sizeof(tx_buffer)) {
+      flush();
+      if (len >= sizeof(tx_buffer)) return sendAll(data, len);
+    }
+    memcpy(tx_buffer + tx_len, data, len);
+    tx_len += len;
+    return len;
+  }
+
+  void flush() override {
+    if (tx_len > 0 && sock >= 0) sendAll(tx_buffer, tx_len);
+    tx_len = 0;
+  }
+
+  int availableForWrite() override { return sizeof(tx_buffer) - tx_len; }
+
+  int fd() { return sock; }
+
+  /// true if the socket is open and the peer has not closed the connection
+  operator bool() { return sock >= 0 && !is_peer_closed; }
+
+ protected:
+  const char* SOCKET_STREAM = "SocketStream";
+  int sock = -1;
+  bool is_peer_closed = false;
+  std::string unix_path;
+  uint8_t rx_buffer[4096];
+  size_t rx_pos = 0;
+  size_t rx_len = 0;
+  uint8_t tx_buffer[4096];
+  size_t tx_len = 0;
+
+  /// non blocking read of the next block
+  bool fill() {
+    if (sock < 0) return false;
+    ssize_t n = ::recv(sock, rx_buffer, sizeof(rx_buffer), MSG_DONTWAIT);
+    if (n == 0 || (n < 0 && errno != EAGAIN && errno != EWOULDBLOCK &&
+                   errno != EINTR)) {
+      markClosed();
+      return false;
+    }
+    if (n < 0) return false;
+    rx_pos = 0;
+    rx_len = n;
+    return true;
+  }
+
+  void markClosed() {
+    if (!is_peer_closed) Logger.warning(SOCKET_STREAM, "connection closed");
+    is_peer_closed = true;
+  }
+
+  size_t sendAll(const uint8_t* data, size_t len) {
+    size_t result = 0;
+    while (result < len) {
+      ssize_t n = ::send(sock, data + result, len - result, MSG_NOSIGNAL);
+      if (n < 0) {
+        if (errno == EINTR) continue;
+        Logger.error(SOCKET_STREAM, "send failed");
+        break;
+      }
+      result += n;
+    }
+    return result;
+  }
+
+  bool acceptPeer(int server, int timeoutMs) {
+    bool result = false;
+    if (::listen(server, 1) == 0) {
+      struct pollfd pfd;
+      pfd.fd = server;
+      pfd.events = POLLIN;
+      int rc;
+      do {
+        rc = ::poll(&pfd, 1, timeoutMs);
+      } while (rc < 0 && errno == EINTR);
+      if (rc > 0) {
+        int fd = ::accept(server, nullptr, nullptr);
+        if (fd >= 0) {
+          setNoDelay(fd);
+          sock = fd;
+          result = true;
+        }
+      }
+    } else {
+      Logger.error(SOCKET_STREAM, "listen failed");
+    }
+    // we only serve a single peer
+    ::close(server);
+    return result;
+  }
+
+  void setNoDelay(int fd) {
+    int yes = 1;
+    // fails for unix domain sockets, which is fine
+    setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &yes, sizeof(yes));
+  }
+
+  bool unixAddress(const char* path, struct sockaddr_un& addr) {
+    memset(&addr, 0, sizeof(addr));
+    addr.sun_family = AF_UNIX;
+    if (path == nullptr || strlen(path) >= sizeof(addr.sun_path)) {
+      Logger.error(SOCKET_STREAM, "invalid unix socket path");
+      return false;
+    }
+    strncpy(addr.sun_path, path, sizeof(addr.sun_path) - 1);
+    return true;
+  }
+};
+
+}  // namespace arduino
@@ -20,8 +20,13 @@
 #include <errno.h>
 #include <fcntl.h>
 #include <netdb.h>
+#include <poll.h>
 #include <sys/socket.h>
+#include <sys/uio.h>
 #include <unistd.h>
+#if defined(__linux__)
+#include <netinet/udp.h>
+#endif
 
 #undef write
 #undef read
@@ -33,8 +38,7 @@ EthernetUDP::EthernetUDP()
       server_port(0),
       remote_port(0),
       tx_buffer(0),
-      tx_buffer_len(0),
-      rx_buffer(0) {
+      tx_buffer_len(0) {
   registerCleanup();
   active_udp().push_back(this);
 }
@@ -54,9 +58,8 @@ uint8_t EthernetUDP::begin(IPAddress address, uint16_t port) {
 
   server_port = port;
 
-  tx_buffer = new char[1460];
-  if (!tx_buffer) {
-    log_e("EthernetUDP: could not create tx buffer: %d", errno);
+  if (!allocateBuffers() || !nextTxBuffer()) {
+    log_e("EthernetUDP: could not create buffers: %d", errno);
     return 0;
   }
 
@@ -108,16 +111,9 @@ uint8_t EthernetUDP::beginMulticast(IPAddress a, uint16_t p) {
 }
 
 void EthernetUDP::stop() {
-  if (tx_buffer) {
-    delete[] tx_buffer;
-    tx_buffer = NULL;
-  }
-  tx_buffer_len = 0;
-  if (rx_buffer) {
-    RingBufferExt *b = rx_buffer;
-    rx_buffer = NULL;
-    delete b;
-  }
+  // send the packets that are still waiting in the batch
+  if (udp_server != -1) sendQueued();
+  releaseBuffers();
   if (udp_server == -1) return;
   if ((uint32_t)multicast_ip != 0) {
     struct ip_mreq mreq;
@@ -140,15 +136,16 @@ int EthernetUDP::beginMulticastPacket() {
 int EthernetUDP::beginPacket() {
   if (!remote_port) return 0;
 
-  // allocate tx_buffer if is necessary
-  if (!tx_buffer) {
-    tx_buffer = new char[1460];
-    if (!tx_buffer) {
-      log_e("EthernetUDP: could not create tx buffer: %d", errno);
-      return 0;
-    }
+  // allocate the packet pool if is necessary
+  if (!allocateBuffers()) {
+    log_e("EthernetUDP: could not create buffers: %d", errno);
+    return 0;
   }
 
+  if (!tx_buffer && !nextTxBuffer()) {
+    Logger.error("EthernetUDP: no free packet buffer");
+    return 0;
+  }
   tx_buffer_len = 0;
 
   // check whereas socket is already open
@@ -182,103 +179,318 @@ int EthernetUDP::beginPacket(const char *host, uint16_t port) {
 }
 
 int EthernetUDP::endPacket() {
-  struct sockaddr_in recipient;
-  recipient.sin_addr.s_addr = (uint32_t)remote_ip;
-  recipient.sin_family = AF_INET;
-  recipient.sin_port = htons(remote_port);
-  int sent = sendto(udp_server, tx_buffer, tx_buffer_len, 0,
-                    (struct sockaddr *)&recipient, sizeof(recipient));
-  if (sent < 0) {
-    log_e("EthernetUDP: could not send data: %d", errno);
-    return 0;
+  if (!tx_buffer) return 0;
+  Packet &packet = tx_packets[tx_count++];
+  packet.data = tx_buffer;
+  packet.len = tx_buffer_len;
+  packet.ip = (uint32_t)remote_ip;
+  packet.port = remote_port;
+  tx_buffer = NULL;
+
+  int result = 1;
+  if (tx_count >= batch_size) {
+    result = sendQueued() > 0;
   }
-  return 1;
+
+  // continue with a new buffer
+  nextTxBuffer();
+  return result;
+}
+
+bool EthernetUDP::nextTxBuffer() {
+  tx_buffer_len = 0;
+  tx_buffer = pool.acquire();
+  if (!tx_buffer && tx_count > 0) {
+    // all buffers are in use: sending the queued packets releases them
+    sendQueued();
+    tx_buffer = pool.acquire();
+  }
+  return tx_buffer != NULL;
+}
+
+int EthernetUDP::sendQueued() {
+  int count = tx_count;
+  if (count == 0) return 0;
+  int sent = 0;
+  if (udp_server != -1) sent = sendPackets(count);
+
+  // return the buffers to the pool
+  for (int j = 0; j < count; j++) {
+    pool.release(tx_packets[j].data);
+    tx_packets[j].data = NULL;
+  }
+  tx_count = 0;
+  return sent;
+}
+
+int EthernetUDP::sendPackets(int count) {
+  struct sockaddr_in recipients[MAX_BATCH_SIZE];
+  memset(recipients, 0, sizeof(struct sockaddr_in) * count);
+  for (int j = 0; j < count; j++) {
+    recipients[j].sin_addr.s_addr = tx_packets[j].ip;
+    recipients[j].sin_family = AF_INET;
+    recipients[j].sin_port = htons(tx_packets[j].port);
+  }
+
+#if defined(__linux__)
+  struct mmsghdr msgs[MAX_BATCH_SIZE];
+  struct iovec iov[MAX_BATCH_SIZE];
+  memset(msgs, 0, sizeof(struct mmsghdr) * count);
+  for (int j = 0; j < count; j++) {
+    iov[j].iov_base = tx_packets[j].data;
+    iov[j].iov_len = tx_packets[j].len;
+    msgs[j].msg_hdr.msg_name = &recipients[j];
+    msgs[j].msg_hdr.msg_namelen = sizeof(struct sockaddr_in);
+    msgs[j].msg_hdr.msg_iov = &iov[j];
+    msgs[j].msg_hdr.msg_iovlen = 1;
+  }
+#if defined(UDP_SEGMENT)
+  // let the kernel split big packets into datagrams of segment_size
+  char control[MAX_BATCH_SIZE][CMSG_SPACE(sizeof(uint16_t))];
+  for (int j = 0; j < count; j++) {
+    if (segment_size > 0 && tx_packets[j].len > (size_t)segment_size) {
+      msgs[j].msg_hdr.msg_control = control[j];
+      msgs[j].msg_hdr.msg_controllen = sizeof(control[j]);
+      struct cmsghdr *cm = CMSG_FIRSTHDR(&msgs[j].msg_hdr);
+      cm->cmsg_level = SOL_UDP;
+      cm->cmsg_type = UDP_SEGMENT;
+      cm->cmsg_len = CMSG_LEN(sizeof(uint16_t));
+      uint16_t segment = segment_size;
+      memcpy(CMSG_DATA(cm), &segment, sizeof(segment));
+    }
+  }
+#endif
+  int sent = 0;
+  while (sent < count) {
+    int rc = sendmmsg(udp_server, msgs + sent, count - sent, 0);
+    if (rc < 0) {
+      if (errno == EINTR) continue;
+      log_e("EthernetUDP: could not send data: %d", errno);
+      break;
+    }
+    sent += rc;
+  }
+#else
+  int sent = 0;
+  for (int j = 0; j < count; j++) {
+    if (sendto(udp_server, tx_packets[j].data, tx_packets[j].len, 0,
+               (struct sockaddr *)&recipients[j],
+               sizeof(struct sockaddr_in)) < 0) {
+      log_e("EthernetUDP: could not send data: %d", errno);
+      break;
+    }
+    sent++;
+  }
+#endif
+  return sent;
 }
 
 size_t EthernetUDP::write(uint8_t data) {
-  if (tx_buffer_len == 1460) {
+  if (tx_buffer && tx_buffer_len == (size_t)packet_size) {
     endPacket();
-    tx_buffer_len = 0;
   }
+  if (!tx_buffer) return 0;
   tx_buffer[tx_buffer_len++] = data;
   return 1;
 }
 
 size_t EthernetUDP::write(const uint8_t *buffer, size_t size) {
-  size_t i;
-  for (i = 0; i < size; i++) write(buffer[i]);
+  size_t i = 0;
+  while (i < size) {
+    if (tx_buffer && tx_buffer_len == (size_t)packet_size) {
+      endPacket();
+    }
+    if (!tx_buffer) break;
+    size_t len = min(size - i, packet_size - tx_buffer_len);
+    memcpy(tx_buffer + tx_buffer_len, buffer + i, len);
+    tx_buffer_len += len;
+    i += len;
+  }
   return i;
 }
 
 int EthernetUDP::parsePacket() {
-  if (rx_buffer) return 0;
-  struct sockaddr_in si_other;
-  int slen = sizeof(si_other), len;
-  char *buf = new char[1460];
-  if (!buf) {
-    return 0;
+  // the current packet has not been consumed yet
+  if (rx_pos < rx_len) return 0;
+  // return the consumed packet to the pool
+  pool.release(rx_data);
+  rx_data = NULL;
+  rx_len = rx_pos = 0;
+  if (rx_next >= rx_count && receivePackets() <= 0) return 0;
+
+  Packet &packet = rx_packets[rx_next++];
+  remote_ip = IPAddress(packet.ip);
+  remote_port = packet.port;
+  rx_data = packet.data;
+  rx_len = packet.len;
+  packet.data = NULL;
+  return rx_len;
+}
+
+bool EthernetUDP::waitForPacket(int timeoutMs) {
+  // buffered packets of the last batch
+  if (rx_pos < rx_len || rx_next < rx_count) return true;
+  if (udp_server == -1) return false;
+  struct pollfd pfd = {udp_server, POLLIN, 0};
+  return ::poll(&pfd, 1, timeoutMs) > 0;
+}
+
+int EthernetUDP::receivePackets() {
+  rx_count = rx_next = 0;
+  if (udp_server == -1 || !allocateBuffers()) return 0;
+
+  // provide as many buffers as the pool can spare
+  int n = 0;
+  while (n < batch_size && (rx_packets[n].data = pool.acquire()) != NULL) n++;
+  if (n == 0) return 0;
+
+  struct sockaddr_in senders[MAX_BATCH_SIZE];
+#if defined(__linux__)
+  struct mmsghdr msgs[MAX_BATCH_SIZE];
+  struct iovec iov[MAX_BATCH_SIZE];
+  memset(msgs, 0, sizeof(struct mmsghdr) * n);
+  for (int j = 0; j < n; j++) {
+    iov[j].iov_base = rx_packets[j].data;
+    iov[j].iov_len = packet_size;
+    msgs[j].msg_hdr.msg_name = &senders[j];
+    msgs[j].msg_hdr.msg_namelen = sizeof(struct sockaddr_in);
+    msgs[j].msg_hdr.msg_iov = &iov[j];
+    msgs[j].msg_hdr.msg_iovlen = 1;
   }
-  if ((len = recvfrom(udp_server, buf, 1460, MSG_DONTWAIT,
-                      (struct sockaddr *)&si_other, (socklen_t *)&slen)) ==
-      -1) {
-    delete[] buf;
-    if (errno == EWOULDBLOCK) {
-      return 0;
+  int count = recvmmsg(udp_server, msgs, n, MSG_DONTWAIT, NULL);
+  if (count == -1) {
+    if (errno != EWOULDBLOCK && errno != EAGAIN) {
+      log_e("EthernetUDP: could not receive data: %d", errno);
     }
-    log_e("EthernetUDP: could not receive data: %d", errno);
-    return 0;
+    count = 0;
+  }
+  for (int j = 0; j < count; j++) {
+    rx_packets[j].len = msgs[j].msg_len;
+  }
+#else
+  int count = 0;
+  for (; count < n; count++) {
+    socklen_t slen = sizeof(struct sockaddr_in);
+    int len = recvfrom(udp_server, rx_packets[count].data, packet_size,
+                       MSG_DONTWAIT, (struct sockaddr *)&senders[count], &slen);
+    if (len == -1) {
+      if (errno != EWOULDBLOCK && errno != EAGAIN) {
+        log_e("EthernetUDP: could not receive data: %d", errno);
+      }
+      break;
+    }
+    rx_packets[count].len = len;
   }
-  remote_ip = IPAddress(si_other.sin_addr.s_addr);
-  remote_port = ntohs(si_other.sin_port);
-  if (len > 0) {
-    rx_buffer = new RingBufferExt(len);
-    rx_buffer->write(buf, len);
+#endif
+  for (int j = 0; j < count; j++) {
+    rx_packets[j].ip = senders[j].sin_addr.s_addr;
+    rx_packets[j].port = ntohs(senders[j].sin_port);
   }
-  delete[] buf;
-  return len;
+  // return the unused buffers
+  for (int j = count; j < n; j++) {
+    pool.release(rx_packets[j].data);
+    rx_packets[j].data = NULL;
+  }
+  rx_count = count;
+  return count;
 }
 
-int EthernetUDP::available() {
-  if (!rx_buffer) return 0;
-  return rx_buffer->available();
-}
+int EthernetUDP::available() { return rx_len - rx_pos; }
 
 int EthernetUDP::read() {
-  if (!rx_buffer) return -1;
-  int out = rx_buffer->read();
-  if (!rx_buffer->available()) {
-    RingBufferExt *b = rx_buffer;
-    rx_buffer = 0;
-    delete b;
-  }
-  return out;
+  if (rx_pos >= rx_len) return -1;
+  return rx_data[rx_pos++];
 }
 
 int EthernetUDP::read(unsigned char *buffer, size_t len) {
-  return read((char *)buffer, len);
+  // no virtual call: subclasses may override both variants
+  return EthernetUDP::read((char *)buffer, len);
 }
 
 int EthernetUDP::read(char *buffer, size_t len) {
-  if (!rx_buffer) return 0;
-  int out = rx_buffer->read(buffer, len);
-  if (!rx_buffer->available()) {
-    RingBufferExt *b = rx_buffer;
-    rx_buffer = 0;
-    delete b;
-  }
-  return out;
+  size_t result = min(len, rx_len - rx_pos);
+  if (result == 0) return 0;
+  memcpy(buffer, rx_data + rx_pos, result);
+  rx_pos += result;
+  return result;
 }
 
 int EthernetUDP::peek() {
-  if (!rx_buffer) return -1;
-  return rx_buffer->peek();
+  if (rx_pos >= rx_len) return -1;
+  return rx_data[rx_pos];
 }
 
 void EthernetUDP::flush() {
-  if (!rx_buffer) return;
-  RingBufferExt *b = rx_buffer;
-  rx_buffer = 0;
-  delete b;
+  // discard the rest of the current packet
+  rx_pos = rx_len;
+}
+
+bool EthernetUDP::setBatchSize(int packets) {
+  if (packets < 1) packets = 1;
+  if (packets > MAX_BATCH_SIZE) packets = MAX_BATCH_SIZE;
+  if (packets == batch_size) return true;
+  if (hasPendingData()) {
+    Logger.error("EthernetUDP: batch size can not be changed with pending packets");
+    return false;
+  }
+  batch_size = packets;
+  reallocateBuffers();
+  return true;
+}
+
+bool EthernetUDP::setPacketPool(int count, int packetSize) {
+  if (packetSize < 1) packetSize = PACKET_SIZE;
+  if (packetSize > MAX_PACKET_SIZE) packetSize = MAX_PACKET_SIZE;
+  if (hasPendingData()) {
+    Logger.error("EthernetUDP: packet pool can not be changed with pending packets");
+    return false;
+  }
+  pool_count = count < 0 ? 0 : count;
+  packet_size = packetSize;
+  reallocateBuffers();
+  return true;
+}
+
+bool EthernetUDP::hasPendingData() {
+  // received packets which have not been read and a packet which is being
+  // written would be lost
+  return rx_pos < rx_len || rx_next < rx_count || tx_buffer_len > 0;
+}
+
+bool EthernetUDP::allocateBuffers() {
+  if (pool) return true;
+  // by default we need a full batch for receiving and one for sending: the
+  // tx batch must never use up all buffers, otherwise nothing can be received
+  int count = pool_count > 0 ? pool_count : 2 * batch_size;
+  if (count < batch_size + 1) count = batch_size + 1;
+  return pool.begin(count, packet_size);
+}
+
+void EthernetUDP::releaseBuffers() {
+  pool.release(tx_buffer);
+  tx_buffer = NULL;
+  tx_buffer_len = 0;
+  for (int j = 0; j < tx_count; j++) {
+    pool.release(tx_packets[j].data);
+    tx_packets[j].data = NULL;
+  }
+  tx_count = 0;
+  pool.release(rx_data);
+  rx_data = NULL;
+  rx_len = rx_pos = 0;
+  for (int j = rx_next; j < rx_count; j++) {
+    pool.release(rx_packets[j].data);
+    rx_packets[j].data = NULL;
+  }
+  rx_count = rx_next = 0;
+}
+
+void EthernetUDP::reallocateBuffers() {
+  bool is_tx_active = tx_buffer != NULL;
+  sendQueued();
+  releaseBuffers();
+  pool.end();
+  if (is_tx_active && allocateBuffers()) nextTxBuffer();
 }
 
 IPAddress EthernetUDP::remoteIP() { return remote_ip; }
@@ -20,24 +20,78 @@
 #pragma once
 #include "api/IPAddress.h"
 #include "api/Udp.h"
-#include <RingBufferExt.h>
+#include <vector>
+#include "PacketPool.h"
 #include "SignalHandler.h"
 #include "ArduinoLogger.h"
 
 namespace arduino {
 
-
+/**
+ * @brief UDP implementation based on BSD sockets.
+ *
+ * By default each endPacket() sends a single datagram and each parsePacket()
+ * receives a single datagram. With setBatchSize() you can activate the batch
+ * mode: parsePacket() then receives up to the indicated number of datagrams
+ * with a single recvmmsg() call and serves the following parsePacket() calls
+ * from the buffered packets. endPacket() only queues the packet: the queued
+ * packets are sent with a single sendmmsg() call when the batch is full or
+ * when sendQueued() is called.
+ *
+ * All packets are taken from a PacketPool which is owned by the object and
+ * allocated only once, so there is no heap allocation per datagram. The
+ * number of buffers and the packet size (e.g. for jumbo frames) can be
+ * defined with setPacketPool(). On Linux setSegmentSize() activates UDP
+ * generic segmentation offload: a big packet is then split by the kernel
+ * into datagrams of the indicated size.
+ */
 class EthernetUDP : public UDP {
+ public:
+  /// Default max size of a single datagram
+  static constexpr int PACKET_SIZE = 1460;
+  /// Max payload of an UDP datagram
+  static constexpr int MAX_PACKET_SIZE = 65507;
+  /// Max number of datagrams that can be processed with a single syscall
+  static constexpr int MAX_BATCH_SIZE = 64;
+
  private:
+  /// Datagram stored in a buffer of the packet pool
+  struct Packet {
+    uint8_t* data = nullptr;
+    size_t len = 0;
+    uint32_t ip = 0;
+    uint16_t port = 0;
+  };
+
   int udp_server;
   IPAddress multicast_ip;
   IPAddress remote_ip;
   uint16_t server_port;
   uint16_t remote_port;
-  char* tx_buffer;
+  uint8_t* tx_buffer;
   size_t tx_buffer_len;
-  RingBufferExt* rx_buffer;
+  int batch_size = 1;
+  int pool_count = 0;
+  int packet_size = PACKET_SIZE;
+  int segment_size = 0;
+  PacketPool pool;
+  Packet tx_packets[MAX_BATCH_SIZE];
+  Packet rx_packets[MAX_BATCH_SIZE];
+  int tx_count = 0;
+  int rx_count = 0;
+  int rx_next = 0;
+  uint8_t* rx_data = nullptr;
+  size_t rx_len = 0;
+  size_t rx_pos = 0;
+
   void log_e(const char* msg, int errorNo);
+  bool allocateBuffers();
+  void releaseBuffers();
+  void reallocateBuffers();
+  bool hasPendingData();
+  bool nextTxBuffer();
+  int sendPackets(int count);
+  int receivePackets();
 
   static std::vector<EthernetUDP*>& active_udp() {
     static std::vector<EthernetUDP*> udp_list;
@@ -74,7 +128,33 @@ class EthernetUDP : public UDP {
   void flush();
   IPAddress remoteIP();
   uint16_t remotePort();
-  
+  /// Defines the number of datagrams which are received/sent with a single
+  /// syscall (1 = no batching). Call it before begin(): returns false if
+  /// received or partially written packets are pending.
+  bool setBatchSize(int packets);
+  int batchSize() { return batch_size; }
+  /// Defines the number of packet buffers (0 = two per batch entry) and the
+  /// max packet size. At least batch size + 1 buffers are used, so that a
+  /// buffer is left for receiving when a full batch is queued for sending.
+  /// Call it before begin(): returns false if received or partially written
+  /// packets are pending.
+  bool setPacketPool(int count, int packetSize = PACKET_SIZE);
+  int packetSize() { return packet_size; }
+  /// Sends packets which are bigger then the indicated size as multiple
+  /// datagrams using UDP GSO (0 = inactive)
+  void setSegmentSize(int size) { segment_size = size; }
+  /// Sends all packets which have been queued by endPacket(): returns the
+  /// number of sent packets
+  int sendQueued();
+  /// Waits up to the indicated time until a datagram can be received:
+  /// returns false on timeout
+  bool waitForPacket(int timeoutMs);
+  /// Returns true if parsePacket() has provided a datagram: unlike its
+  /// result this is also true for an empty datagram
+  bool isPacketReceived() { return rx_data != nullptr; }
+  /// Socket file descriptor (-1 if not active): e.g. for poll()
+  int socketHandle() { return udp_server; }
+
 protected:
   void registerCleanup() {
     static bool signal_registered = false;
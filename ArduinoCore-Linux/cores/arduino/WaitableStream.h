@@ -0,0 +1,39 @@
+/*
+  WaitableStream.h
+  Copyright (c) 2025 Phil Schatzmann. All right reserved.
+
+  This library is free software; you can redistribute it and/or
+  modify it under the terms of the GNU Lesser General Public
+  License as published by the Free Software Foundation; either
+  version 2.1 of the License, or (at your option) any later version.
+
+  This library is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+  Lesser General Public License for more details.
+
+  You should have received a copy of the GNU Lesser General Public
+  License along with this library; if not, write to the Free Software
+  Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA 02110-1301 USA
+*/
+
+#pragma once
+
+namespace arduino {
+
+/**
+ * @brief Interface for streams which can block until data has arrived (e.g.
+ * in poll() or on a futex). Stream::readBytes() is not virtual and polls
+ * read(), so users which only have a Stream pointer (e.g. HardwareService)
+ * check for this interface to sleep instead of busy waiting.
+ */
+class WaitableStream {
+ public:
+  virtual ~WaitableStream() = default;
+
+  /// Blocks until data is available or the timeout (in ms) has elapsed:
+  /// returns false on timeout or if the stream is closed
+  virtual bool waitReadable(int timeoutMs) = 0;
+};
+
+}  // namespace arduino
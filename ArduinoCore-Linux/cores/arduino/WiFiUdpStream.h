@@ -18,8 +18,13 @@
 */
 
 #pragma once
+#include <poll.h>
+#include <stdlib.h>
 #include <string.h>
+#include <atomic>
+#include <mutex>
 #include <thread>
+#include <vector>
 #include "ArduinoLogger.h"
 #include "WiFiUdp.h"
 #include "api/ArduinoAPI.h"
@@ -47,6 +52,21 @@ namespace arduino {
  * UDP packets as needed. Data is sent when flush() is called, making it suitable
  * for protocols that require message boundaries or batch transmission.
  *
+ * With setReliable() both sides can activate a lightweight reliable mode:
+ * the written bytes are packed into datagrams of the max packet size which
+ * carry a sequence number. The receiver acknowledges them with a cumulative
+ * sequence number and a selective ack bitmap, delivers the data in order and
+ * the sender retransmits unacknowledged datagrams after a timeout. Up to
+ * window size datagrams can be in flight. By default the incoming datagrams
+ * and retransmissions are processed whenever data is written, flushed, read
+ * or checked with available(), and while write() waits for window space.
+ * setReceiverThread() processes them in a background thread instead, so that
+ * the peer is not stalled while the application does not use the stream.
+ * When the window stays full for longer than the stream timeout, write()
+ * returns a short count and sets the write error: the unsent bytes are kept.
+ * setSimulatedLoss() drops outgoing datagrams randomly to test this on
+ * loopback.
+ *
  * @see WiFiUDP
  * @see IPAddress
  * @see Stream
@@ -61,7 +81,141 @@ class WiFiUDPStream : public WiFiUDP {
     setTarget(targetAdress, port);
   }
 
-  void flush() {
+  ~WiFiUDPStream() { setReceiverThread(false); }
+
+  /// Max number of unacknowledged datagrams in reliable mode
+  static constexpr int MAX_WINDOW_SIZE = 32;
+
+  /// Activates the reliable mode: must be done on both sides. The window
+  /// size is rounded up to a power of 2, so that the slots stay consistent
+  /// when the 16 bit sequence numbers wrap around.
+  void setReliable(bool active, int windowSize = MAX_WINDOW_SIZE) {
+    setReceiverThread(false);
+    reliable = active;
+    if (windowSize > MAX_WINDOW_SIZE) windowSize = MAX_WINDOW_SIZE;
+    int size = 1;
+    while (size < windowSize) size <<= 1;
+    window_size = active ? size : 0;
+    payload_size = packetSize() - DATA_HEADER_SIZE;
+    tx_window.resize(window_size);
+    rx_window.resize(window_size);
+    for (auto& segment : tx_window) segment.data.resize(payload_size);
+    for (auto& segment : rx_window) segment.data.resize(payload_size);
+    tx_pending.resize(active ? payload_size : 0);
+    tx_pending_len = 0;
+    tx_base = tx_next = rx_read = rx_next = 0;
+  }
+
+  bool isReliable() { return reliable; }
+
+  /// Processes the acks, retransmissions and received datagrams of the
+  /// reliable mode in a background thread. Call it after setReliable().
+  void setReceiverThread(bool active) {
+    if (active == is_receiver_active) return;
+    if (active && !reliable) {
+      Logger.error("WiFiUDPStream", "receiver thread needs the reliable mode");
+      return;
+    }
+    is_receiver_active = active;
+    if (active) {
+      receiver = std::thread(&WiFiUDPStream::receiverLoop, this);
+    } else if (receiver.joinable()) {
+      receiver.join();
+    }
+  }
+
+  /// Defines the time after which an unacknowledged datagram is resent
+  void setRetransmitTimeout(unsigned long ms) { retransmit_ms = ms; }
+
+  /// Drops the indicated fraction (0.0 - 1.0) of the outgoing datagrams in
+  /// reliable mode: used for testing. The seed makes the losses repeatable.
+  void setSimulatedLoss(float rate, uint32_t seed = 1) {
+    simulated_loss = rate;
+    loss_random = seed != 0 ? seed : 1;
+  }
+
+  size_t write(uint8_t c) override {
+    if (!reliable) return WiFiUDP::write(c);
+    return write(&c, 1);
+  }
+
+  size_t write(const uint8_t* buffer, size_t size) override {
+    if (!reliable) return WiFiUDP::write(buffer, size);
+    std::lock_guard<std::recursive_mutex> lock(mtx);
+    size_t result = 0;
+    while (result < size) {
+      size_t len = min(size - result, payload_size - tx_pending_len);
+      memcpy(tx_pending.data() + tx_pending_len, buffer + result, len);
+      tx_pending_len += len;
+      result += len;
+      // a full datagram is sent right away
+      if (tx_pending_len == payload_size && !sendPending()) break;
+    }
+    return result;
+  }
+
+  int available() override {
+    if (!reliable) {
+      receiveIfEmpty();
+      return WiFiUDP::available();
+    }
+    std::lock_guard<std::recursive_mutex> lock(mtx);
+    processIncoming();
+    return readable();
+  }
+
+  int read() override {
+    uint8_t c;
+    return read(&c, 1) == 1 ? c : -1;
+  }
+
+  int read(unsigned char* buffer, size_t len) override {
+    if (!reliable) {
+      receiveIfEmpty();
+      return WiFiUDP::read(buffer, len);
+    }
+    std::lock_guard<std::recursive_mutex> lock(mtx);
+    if (readable() == 0) processIncoming();
+    size_t result = 0;
+    while (result < len && rx_read != rx_next) {
+      Segment& segment = slot(rx_window, rx_read);
+      size_t n = min(len - result, (size_t)(segment.len - segment.pos));
+      memcpy(buffer + result, segment.data.data() + segment.pos, n);
+      segment.pos += n;
+      result += n;
+      if (segment.pos == segment.len) {
+        // the segment has been consumed: the slot can be reused
+        segment.used = false;
+        rx_read++;
+      }
+    }
+    return result;
+  }
+
+  int read(char* buffer, size_t len) override {
+    return read((unsigned char*)buffer, len);
+  }
+
+  int peek() override {
+    if (!reliable) {
+      receiveIfEmpty();
+      return WiFiUDP::peek();
+    }
+    std::lock_guard<std::recursive_mutex> lock(mtx);
+    if (readable() == 0) processIncoming();
+    if (rx_read == rx_next) return -1;
+    Segment& segment = slot(rx_window, rx_read);
+    return segment.data[segment.pos];
+  }
+
+  void flush() override {
+    if (reliable) {
+      std::lock_guard<std::recursive_mutex> lock(mtx);
+      // send the pending bytes, but never an empty datagram
+      if (tx_pending_len > 0) sendPending();
+      processIncoming();
+      return;
+    }
     WiFiUDP::flush();
     endPacket();
     if (!targetDefined()) {
@@ -71,7 +225,9 @@ class WiFiUDPStream : public WiFiUDP {
   }
 
   void stop() {
+    setReceiverThread(false);
     if (active) {
+      if (reliable) flush();
       endPacket();
       WiFiUDP::stop();
       active = false;
@@ -87,6 +243,7 @@ class WiFiUDPStream : public WiFiUDP {
   }
 
   size_t readBytes(uint8_t* values, size_t len) {
+    if (reliable) return read(values, len);
     if (this->available() == 0) {
       // we need to receive the next packet
       this->parsePacket();
@@ -106,9 +263,216 @@ class WiFiUDPStream : public WiFiUDP {
   bool isActive() { return active; }
 
  protected:
+  enum FrameType : uint8_t { FrameData = 0xD1, FrameAck = 0xA1 };
+  /// type, unused, seq (2 bytes)
+  static constexpr int DATA_HEADER_SIZE = 4;
+  /// type, unused, next expected seq (2 bytes), selective ack bitmap (4 bytes)
+  static constexpr int ACK_SIZE = 8;
+
+  /// Datagram in the send or receive window
+  struct Segment {
+    std::vector<uint8_t> data;
+    uint16_t seq = 0;
+    uint16_t len = 0;
+    uint16_t pos = 0;
+    unsigned long sent_ms = 0;
+    bool used = false;
+    bool acked = false;
+  };
+
   bool active = false;
   IPAddress target_adress{0, 0, 0, 0};
   int port = 0;
+  bool reliable = false;
+  int window_size = 0;
+  size_t payload_size = 0;
+  unsigned long retransmit_ms = 100;
+  float simulated_loss = 0.0f;
+  uint32_t loss_random = 1;
+  std::vector<Segment> tx_window;
+  std::vector<Segment> rx_window;
+  std::vector<uint8_t> tx_pending;
+  size_t tx_pending_len = 0;
+  // oldest unacknowledged and next seq to send
+  uint16_t tx_base = 0;
+  uint16_t tx_next = 0;
+  // next seq to read by the application and next expected seq
+  uint16_t rx_read = 0;
+  uint16_t rx_next = 0;
+  std::recursive_mutex mtx;
+  std::thread receiver;
+  std::atomic<bool> is_receiver_active{false};
+
+  void receiverLoop() {
+    while (is_receiver_active) {
+      // wait without the lock, so that the application is not blocked
+      struct pollfd pfd = {WiFiUDP::socketHandle(), POLLIN, 0};
+      ::poll(&pfd, 1, retransmit_ms / 2 + 1);
+      std::lock_guard<std::recursive_mutex> lock(mtx);
+      processIncoming();
+    }
+  }
+
+  /// receives the next datagram when the current one has been consumed
+  void receiveIfEmpty() {
+    if (WiFiUDP::available() == 0) WiFiUDP::parsePacket();
+  }
+
+  /// signed distance between sequence numbers which handles the wrap around
+  static int seqDiff(uint16_t a, uint16_t b) { return (int16_t)(a - b); }
+
+  /// slot of a sequence number in the send or receive window
+  Segment& slot(std::vector<Segment>& window, uint16_t seq) {
+    return window[seq & (window_size - 1)];
+  }
+
+  /// number of bytes that can be read in order
+  int readable() {
+    int result = 0;
+    for (uint16_t seq = rx_read; seq != rx_next; seq++) {
+      Segment& segment = slot(rx_window, seq);
+      result += segment.len - segment.pos;
+    }
+    return result;
+  }
+
+  /// moves the pending bytes into the send window and sends them: returns
+  /// false (and keeps the bytes pending) if the window stays full
+  bool sendPending() {
+    // wait for a free slot: the acks or the next retransmission
+    unsigned long start = millis();
+    while (seqDiff(tx_next, tx_base) >= window_size) {
+      unsigned long elapsed = millis() - start;
+      if (elapsed > getTimeout()) {
+        Logger.error("WiFiUDPStream", "send window full");
+        setWriteError();
+        return false;
+      }
+      WiFiUDP::waitForPacket(min(retransmit_ms, getTimeout() - elapsed) + 1);
+      processIncoming();
+    }
+    Segment& segment = slot(tx_window, tx_next);
+    memcpy(segment.data.data(), tx_pending.data(), tx_pending_len);
+    segment.len = tx_pending_len;
+    segment.seq = tx_next++;
+    segment.used = true;
+    segment.acked = false;
+    tx_pending_len = 0;
+    sendSegment(segment);
+    return true;
+  }
+
+  void sendSegment(Segment& segment) {
+    segment.sent_ms = millis();
+    uint8_t header[DATA_HEADER_SIZE] = {FrameData, 0, (uint8_t)(segment.seq),
+                                        (uint8_t)(segment.seq >> 8)};
+    if (!beginFrame()) return;
+    WiFiUDP::write(header, DATA_HEADER_SIZE);
+    WiFiUDP::write(segment.data.data(), segment.len);
+    WiFiUDP::endPacket();
+  }
+
+  void sendAck() {
+    // bit n confirms the reception of rx_next + 1 + n
+    uint32_t bitmap = 0;
+    for (int n = 0; n < window_size - 1; n++) {
+      uint16_t seq = rx_next + 1 + n;
+      Segment& segment = slot(rx_window, seq);
+      if (segment.used && segment.seq == seq) bitmap |= (1u << n);
+    }
+    uint8_t frame[ACK_SIZE] = {FrameAck,
+                               0,
+                               (uint8_t)(rx_next),
+                               (uint8_t)(rx_next >> 8),
+                               (uint8_t)(bitmap),
+                               (uint8_t)(bitmap >> 8),
+                               (uint8_t)(bitmap >> 16),
+                               (uint8_t)(bitmap >> 24)};
+    if (!beginFrame()) return;
+    WiFiUDP::write(frame, ACK_SIZE);
+    WiFiUDP::endPacket();
+  }
+
+  /// starts a datagram to the target: returns false if it should be dropped
+  bool beginFrame() {
+    if (simulated_loss > 0.0f) {
+      // xorshift32: independent of the global rand()
+      loss_random ^= loss_random << 13;
+      loss_random ^= loss_random >> 17;
+      loss_random ^= loss_random << 5;
+      if (loss_random < simulated_loss * 4294967295.0f) return false;
+    }
+    if (targetDefined()) return WiFiUDP::beginPacket(target_adress, port);
+    return WiFiUDP::beginPacket(remoteIP(), remotePort());
+  }
+
+  /// processes all received datagrams and resends the expired ones
+  void processIncoming() {
+    bool is_ack_needed = false;
+    // an empty datagram must not stop the loop
+    while (WiFiUDP::parsePacket() > 0 || WiFiUDP::isPacketReceived()) {
+      uint8_t header[DATA_HEADER_SIZE];
+      if (WiFiUDP::read(header, DATA_HEADER_SIZE) == DATA_HEADER_SIZE) {
+        uint16_t seq = header[2] | (header[3] << 8);
+        if (header[0] == FrameData) {
+          receiveSegment(seq);
+          is_ack_needed = true;
+        } else if (header[0] == FrameAck) {
+          uint8_t bitmap[4] = {0};
+          WiFiUDP::read(bitmap, 4);
+          receiveAck(seq, bitmap[0] | (bitmap[1] << 8) | (bitmap[2] << 16) |
+                              ((uint32_t)bitmap[3] << 24));
+        }
+      }
+      // discard the rest of the datagram
+      WiFiUDP::flush();
+    }
+    if (is_ack_needed) sendAck();
+
+    // resend the expired segments
+    unsigned long now = millis();
+    for (uint16_t seq = tx_base; seq != tx_next; seq++) {
+      Segment& segment = slot(tx_window, seq);
+      if (!segment.acked && now - segment.sent_ms >= retransmit_ms) {
+        sendSegment(segment);
+      }
+    }
+    sendQueued();
+  }
+
+  void receiveSegment(uint16_t seq) {
+    // old duplicate: we just confirm it again; we also need to have a free
+    // slot which does not contain unread data
+    if (seqDiff(seq, rx_next) < 0) return;
+    if (seqDiff(seq, rx_read) >= window_size) return;
+    Segment& segment = slot(rx_window, seq);
+    if (segment.used) return;
+    segment.len = WiFiUDP::read(segment.data.data(), payload_size);
+    segment.seq = seq;
+    segment.pos = 0;
+    segment.used = true;
+    // deliver all segments that are in order
+    while (true) {
+      Segment& next = slot(rx_window, rx_next);
+      if (!next.used || next.seq != rx_next) break;
+      rx_next++;
+    }
+  }
+
+  void receiveAck(uint16_t next, uint32_t bitmap) {
+    for (uint16_t seq = tx_base; seq != tx_next; seq++) {
+      Segment& segment = slot(tx_window, seq);
+      int n = seqDiff(seq, next);
+      if (n < 0 || (n > 0 && n <= 32 && (bitmap & (1u << (n - 1))))) {
+        segment.acked = true;
+      }
+    }
+    // slide the window
+    while (tx_base != tx_next && slot(tx_window, tx_base).acked) {
+      slot(tx_window, tx_base).used = false;
+      tx_base++;
+    }
+  }
 };
 
 // Define a global function which will be used to start a thread
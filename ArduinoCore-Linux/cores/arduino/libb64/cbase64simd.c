@@ -0,0 +1,410 @@
+/*
+cbase64simd.c - c source of the vectorized base64 encoding and decoding
+
+The SSE4.1 and AVX2 kernels follow the approach of W. Mula and D. Lemire
+("Faster Base64 Encoding and Decoding Using AVX2 Instructions"): the
+sextets are moved into place with pshufb and multiplications, and the
+characters are translated and validated with nibble lookup tables.
+
+This is part of the libb64 project, and has been placed in the public domain.
+For details, see http://sourceforge.net/projects/libb64
+*/
+
+#include "cbase64simd.h"
+#include <stdint.h>
+#include <string.h>
+
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#define BASE64_X86
+#include <immintrin.h>
+#endif
+#if defined(__aarch64__) && defined(__ARM_NEON)
+#define BASE64_NEON
+#include <arm_neon.h>
+#endif
+
+static const char encoding[] = "ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz0123456789+/";
+
+/* value of each character, 255 if it is not in the alphabet */
+static const uint8_t decoding[256] = {
+    255, 255, 255, 255, 255, 255, 255, 255, 255, 255, 255, 255, 255, 255, 255, 255,
+    255, 255, 255, 255, 255, 255, 255, 255, 255, 255, 255, 255, 255, 255, 255, 255,
+    255, 255, 255, 255, 255, 255, 255, 255, 255, 255, 255,  62, 255, 255, 255,  63,
+     52,  53,  54,  55,  56,  57,  58,  59,  60,  61, 255, 255, 255, 255, 255, 255,
+    255,   0,   1,   2,   3,   4,   5,   6,   7,   8,   9,  10,  11,  12,  13,  14,
+     15,  16,  17,  18,  19,  20,  21,  22,  23,  24,  25, 255, 255, 255, 255, 255,
+    255,  26,  27,  28,  29,  30,  31,  32,  33,  34,  35,  36,  37,  38,  39,  40,
+     41,  42,  43,  44,  45,  46,  47,  48,  49,  50,  51, 255, 255, 255, 255, 255,
+    255, 255, 255, 255, 255, 255, 255, 255, 255, 255, 255, 255, 255, 255, 255, 255,
+    255, 255, 255, 255, 255, 255, 255, 255, 255, 255, 255, 255, 255, 255, 255, 255,
+    255, 255, 255, 255, 255, 255, 255, 255, 255, 255, 255, 255, 255, 255, 255, 255,
+    255, 255, 255, 255, 255, 255, 255, 255, 255, 255, 255, 255, 255, 255, 255, 255,
+    255, 255, 255, 255, 255, 255, 255, 255, 255, 255, 255, 255, 255, 255, 255, 255,
+    255, 255, 255, 255, 255, 255, 255, 255, 255, 255, 255, 255, 255, 255, 255, 255,
+    255, 255, 255, 255, 255, 255, 255, 255, 255, 255, 255, 255, 255, 255, 255, 255,
+    255, 255, 255, 255, 255, 255, 255, 255, 255, 255, 255, 255, 255, 255, 255, 255};
+
+static base64_kernel selected_kernel = base64_kernel_auto;
+
+static size_t encode_scalar(const uint8_t* in, size_t len, char* out)
+{
+    size_t done = 0;
+    for (; len - done >= 3; done += 3, out += 4) {
+        uint32_t value = (uint32_t)in[done] << 16 | (uint32_t)in[done + 1] << 8 | in[done + 2];
+        out[0] = encoding[value >> 18];
+        out[1] = encoding[(value >> 12) & 0x3f];
+        out[2] = encoding[(value >> 6) & 0x3f];
+        out[3] = encoding[value & 0x3f];
+    }
+    return done;
+}
+
+static size_t decode_scalar(const uint8_t* in, size_t len, uint8_t* out)
+{
+    size_t done = 0;
+    for (; len - done >= 4; done += 4, out += 3) {
+        uint32_t a = decoding[in[done]];
+        uint32_t b = decoding[in[done + 1]];
+        uint32_t c = decoding[in[done + 2]];
+        uint32_t d = decoding[in[done + 3]];
+        if ((a | b | c | d) & 0x80) {
+            break;
+        }
+        uint32_t value = a << 18 | b << 12 | c << 6 | d;
+        out[0] = (uint8_t)(value >> 16);
+        out[1] = (uint8_t)(value >> 8);
+        out[2] = (uint8_t)value;
+    }
+    return done;
+}
+
+/*
+ * Decoding: a character is valid if the bit of its high nibble is set in the
+ * mask of its low nibble. The value is the character plus an offset which
+ * only depends on the high nibble (except for '/').
+ */
+#define BASE64_SHIFT_LUT 0, 0, 19, 4, -65, -65, -71, -71, 0, 0, 0, 0, 0, 0, 0, 0
+#define BASE64_MASK_LUT                                                                       \
+    (char)0xa8, (char)0xf8, (char)0xf8, (char)0xf8, (char)0xf8, (char)0xf8, (char)0xf8,       \
+    (char)0xf8, (char)0xf8, (char)0xf8, (char)0xf0, 0x54, 0x50, 0x50, 0x50, 0x54
+#define BASE64_BIT_LUT 0x01, 0x02, 0x04, 0x08, 0x10, 0x20, 0x40, (char)0x80, 0, 0, 0, 0, 0, 0, 0, 0
+
+#ifdef BASE64_X86
+
+/* 3 bytes -> 4 sextets in the 4 bytes of each 32 bit word */
+__attribute__((target("sse4.1")))
+static inline __m128i encode_reshuffle_sse41(__m128i in)
+{
+    in = _mm_shuffle_epi8(in, _mm_set_epi8(10, 11, 9, 10, 7, 8, 6, 7, 4, 5, 3, 4, 1, 2, 0, 1));
+    __m128i ac = _mm_mulhi_epu16(_mm_and_si128(in, _mm_set1_epi32(0x0fc0fc00)), _mm_set1_epi32(0x04000040));
+    __m128i bd = _mm_mullo_epi16(_mm_and_si128(in, _mm_set1_epi32(0x003f03f0)), _mm_set1_epi32(0x01000010));
+    return _mm_or_si128(ac, bd);
+}
+
+/* sextet -> character: the offset is selected by the range of the value */
+__attribute__((target("sse4.1")))
+static inline __m128i encode_translate_sse41(__m128i in)
+{
+    const __m128i offsets = _mm_setr_epi8('a' - 26, '0' - 52, '0' - 52, '0' - 52, '0' - 52, '0' - 52,
+                                          '0' - 52, '0' - 52, '0' - 52, '0' - 52, '0' - 52, '+' - 62,
+                                          '/' - 63, 'A', 0, 0);
+    __m128i range = _mm_subs_epu8(in, _mm_set1_epi8(51));
+    __m128i upper = _mm_cmpgt_epi8(_mm_set1_epi8(26), in);
+    range = _mm_or_si128(range, _mm_and_si128(upper, _mm_set1_epi8(13)));
+    return _mm_add_epi8(in, _mm_shuffle_epi8(offsets, range));
+}
+
+__attribute__((target("sse4.1")))
+static size_t encode_sse41(const uint8_t* in, size_t len, char* out)
+{
+    size_t done = 0;
+    /* 16 bytes are loaded, 12 are used */
+    for (; len - done >= 16; done += 12, out += 16) {
+        __m128i block = _mm_loadu_si128((const __m128i*)(in + done));
+        _mm_storeu_si128((__m128i*)out, encode_translate_sse41(encode_reshuffle_sse41(block)));
+    }
+    return done;
+}
+
+__attribute__((target("avx2")))
+static size_t encode_avx2(const uint8_t* in, size_t len, char* out)
+{
+    const __m256i offsets = _mm256_setr_epi8('a' - 26, '0' - 52, '0' - 52, '0' - 52, '0' - 52, '0' - 52,
+                                             '0' - 52, '0' - 52, '0' - 52, '0' - 52, '0' - 52, '+' - 62,
+                                             '/' - 63, 'A', 0, 0,
+                                             'a' - 26, '0' - 52, '0' - 52, '0' - 52, '0' - 52, '0' - 52,
+                                             '0' - 52, '0' - 52, '0' - 52, '0' - 52, '0' - 52, '+' - 62,
+                                             '/' - 63, 'A', 0, 0);
+    const __m256i shuffle = _mm256_set_epi8(10, 11, 9, 10, 7, 8, 6, 7, 4, 5, 3, 4, 1, 2, 0, 1,
+                                            10, 11, 9, 10, 7, 8, 6, 7, 4, 5, 3, 4, 1, 2, 0, 1);
+    size_t done = 0;
+    /* each 128 bit lane processes 12 of the 24 bytes */
+    for (; len - done >= 28; done += 24, out += 32) {
+        __m256i block = _mm256_inserti128_si256(
+            _mm256_castsi128_si256(_mm_loadu_si128((const __m128i*)(in + done))),
+            _mm_loadu_si128((const __m128i*)(in + done + 12)), 1);
+        block = _mm256_shuffle_epi8(block, shuffle);
+        __m256i ac = _mm256_mulhi_epu16(_mm256_and_si256(block, _mm256_set1_epi32(0x0fc0fc00)),
+                                        _mm256_set1_epi32(0x04000040));
+        __m256i bd = _mm256_mullo_epi16(_mm256_and_si256(block, _mm256_set1_epi32(0x003f03f0)),
+                                        _mm256_set1_epi32(0x01000010));
+        __m256i sextets = _mm256_or_si256(ac, bd);
+        __m256i range = _mm256_subs_epu8(sextets, _mm256_set1_epi8(51));
+        __m256i upper = _mm256_cmpgt_epi8(_mm256_set1_epi8(26), sextets);
+        range = _mm256_or_si256(range, _mm256_and_si256(upper, _mm256_set1_epi8(13)));
+        __m256i result = _mm256_add_epi8(sextets, _mm256_shuffle_epi8(offsets, range));
+        _mm256_storeu_si256((__m256i*)out, result);
+    }
+    return done;
+}
+
+__attribute__((target("sse4.1")))
+static size_t decode_sse41(const uint8_t* in, size_t len, uint8_t* out)
+{
+    const __m128i shift_lut = _mm_setr_epi8(BASE64_SHIFT_LUT);
+    const __m128i mask_lut = _mm_setr_epi8(BASE64_MASK_LUT);
+    const __m128i bit_lut = _mm_setr_epi8(BASE64_BIT_LUT);
+    const __m128i pack = _mm_setr_epi8(2, 1, 0, 6, 5, 4, 10, 9, 8, 14, 13, 12, -1, -1, -1, -1);
+    size_t done = 0;
+    for (; len - done >= 16; done += 16, out += 12) {
+        __m128i block = _mm_loadu_si128((const __m128i*)(in + done));
+        __m128i hi = _mm_and_si128(_mm_srli_epi32(block, 4), _mm_set1_epi8(0x0f));
+        __m128i lo = _mm_and_si128(block, _mm_set1_epi8(0x0f));
+        __m128i valid = _mm_and_si128(_mm_shuffle_epi8(mask_lut, lo), _mm_shuffle_epi8(bit_lut, hi));
+        if (_mm_movemask_epi8(_mm_cmpeq_epi8(valid, _mm_setzero_si128())) != 0) {
+            break;
+        }
+        __m128i shift = _mm_blendv_epi8(_mm_shuffle_epi8(shift_lut, hi), _mm_set1_epi8(16),
+                                        _mm_cmpeq_epi8(block, _mm_set1_epi8('/')));
+        block = _mm_add_epi8(block, shift);
+        /* 4 sextets -> 24 bits in each 32 bit word */
+        block = _mm_maddubs_epi16(block, _mm_set1_epi32(0x01400140));
+        block = _mm_madd_epi16(block, _mm_set1_epi32(0x00011000));
+        block = _mm_shuffle_epi8(block, pack);
+        /* only write the 12 result bytes */
+        uint32_t last = (uint32_t)_mm_extract_epi32(block, 2);
+        _mm_storel_epi64((__m128i*)out, block);
+        memcpy(out + 8, &last, 4);
+    }
+    return done;
+}
+
+__attribute__((target("avx2")))
+static size_t decode_avx2(const uint8_t* in, size_t len, uint8_t* out)
+{
+    const __m256i shift_lut = _mm256_setr_epi8(BASE64_SHIFT_LUT, BASE64_SHIFT_LUT);
+    const __m256i mask_lut = _mm256_setr_epi8(BASE64_MASK_LUT, BASE64_MASK_LUT);
+    const __m256i bit_lut = _mm256_setr_epi8(BASE64_BIT_LUT, BASE64_BIT_LUT);
+    const __m256i pack = _mm256_setr_epi8(2, 1, 0, 6, 5, 4, 10, 9, 8, 14, 13, 12, -1, -1, -1, -1,
+                                          2, 1, 0, 6, 5, 4, 10, 9, 8, 14, 13, 12, -1, -1, -1, -1);
+    size_t done = 0;
+    for (; len - done >= 32; done += 32, out += 24) {
+        __m256i block = _mm256_loadu_si256((const __m256i*)(in + done));
+        __m256i hi = _mm256_and_si256(_mm256_srli_epi32(block, 4), _mm256_set1_epi8(0x0f));
+        __m256i lo = _mm256_and_si256(block, _mm256_set1_epi8(0x0f));
+        __m256i valid = _mm256_and_si256(_mm256_shuffle_epi8(mask_lut, lo), _mm256_shuffle_epi8(bit_lut, hi));
+        if (_mm256_movemask_epi8(_mm256_cmpeq_epi8(valid, _mm256_setzero_si256())) != 0) {
+            break;
+        }
+        __m256i shift = _mm256_blendv_epi8(_mm256_shuffle_epi8(shift_lut, hi), _mm256_set1_epi8(16),
+                                           _mm256_cmpeq_epi8(block, _mm256_set1_epi8('/')));
+        block = _mm256_add_epi8(block, shift);
+        block = _mm256_maddubs_epi16(block, _mm256_set1_epi32(0x01400140));
+        block = _mm256_madd_epi16(block, _mm256_set1_epi32(0x00011000));
+        block = _mm256_shuffle_epi8(block, pack);
+        /* move the 2 x 12 result bytes together and only write them */
+        block = _mm256_permutevar8x32_epi32(block, _mm256_setr_epi32(0, 1, 2, 4, 5, 6, 7, 7));
+        _mm_storeu_si128((__m128i*)out, _mm256_castsi256_si128(block));
+        _mm_storel_epi64((__m128i*)(out + 16), _mm256_extracti128_si256(block, 1));
+    }
+    return done;
+}
+
+#endif /* BASE64_X86 */
+
+#ifdef BASE64_NEON
+
+/* vld3/vst4 split the bytes into 3 and the characters into 4 vectors */
+static size_t encode_neon(const uint8_t* in, size_t len, char* out)
+{
+    uint8x16x4_t table;
+    for (int i = 0; i < 4; i++) {
+        table.val[i] = vld1q_u8((const uint8_t*)encoding + i * 16);
+    }
+    const uint8x16_t mask = vdupq_n_u8(0x3f);
+    size_t done = 0;
+    for (; len - done >= 48; done += 48, out += 64) {
+        uint8x16x3_t src = vld3q_u8(in + done);
+        uint8x16x4_t result;
+        result.val[0] = vshrq_n_u8(src.val[0], 2);
+        result.val[1] = vandq_u8(vorrq_u8(vshlq_n_u8(src.val[0], 4), vshrq_n_u8(src.val[1], 4)), mask);
+        result.val[2] = vandq_u8(vorrq_u8(vshlq_n_u8(src.val[1], 2), vshrq_n_u8(src.val[2], 6)), mask);
+        result.val[3] = vandq_u8(src.val[2], mask);
+        for (int i = 0; i < 4; i++) {
+            result.val[i] = vqtbl4q_u8(table, result.val[i]);
+        }
+        vst4q_u8((uint8_t*)out, result);
+    }
+    return done;
+}
+
+static inline uint8x16_t decode_translate_neon(uint8x16_t in, uint8x16_t* invalid)
+{
+    static const int8_t shift_lut[16] = {BASE64_SHIFT_LUT};
+    static const uint8_t mask_lut[16] = {BASE64_MASK_LUT};
+    static const uint8_t bit_lut[16] = {BASE64_BIT_LUT};
+    uint8x16_t hi = vshrq_n_u8(in, 4);
+    uint8x16_t lo = vandq_u8(in, vdupq_n_u8(0x0f));
+    uint8x16_t valid = vandq_u8(vqtbl1q_u8(vld1q_u8(mask_lut), lo), vqtbl1q_u8(vld1q_u8(bit_lut), hi));
+    *invalid = vorrq_u8(*invalid, vceqq_u8(valid, vdupq_n_u8(0)));
+    uint8x16_t shift = vqtbl1q_u8(vreinterpretq_u8_s8(vld1q_s8(shift_lut)), hi);
+    shift = vbslq_u8(vceqq_u8(in, vdupq_n_u8('/')), vdupq_n_u8(16), shift);
+    return vaddq_u8(in, shift);
+}
+
+static size_t decode_neon(const uint8_t* in, size_t len, uint8_t* out)
+{
+    size_t done = 0;
+    for (; len - done >= 64; done += 64, out += 48) {
+        uint8x16x4_t src = vld4q_u8(in + done);
+        uint8x16_t invalid = vdupq_n_u8(0);
+        for (int i = 0; i < 4; i++) {
+            src.val[i] = decode_translate_neon(src.val[i], &invalid);
+        }
+        if (vmaxvq_u8(invalid) != 0) {
+            break;
+        }
+        uint8x16x3_t result;
+        result.val[0] = vorrq_u8(vshlq_n_u8(src.val[0], 2), vshrq_n_u8(src.val[1], 4));
+        result.val[1] = vorrq_u8(vshlq_n_u8(src.val[1], 4), vshrq_n_u8(src.val[2], 2));
+        result.val[2] = vorrq_u8(vshlq_n_u8(src.val[2], 6), src.val[3]);
+        vst3q_u8(out, result);
+    }
+    return done;
+}
+
+#endif /* BASE64_NEON */
+
+static int base64_kernel_supported(base64_kernel kernel)
+{
+    switch (kernel) {
+    case base64_kernel_auto:
+    case base64_kernel_bytewise:
+    case base64_kernel_scalar:
+        return 1;
+#ifdef BASE64_X86
+    case base64_kernel_sse41:
+        return __builtin_cpu_supports("sse4.1");
+    case base64_kernel_avx2:
+        return __builtin_cpu_supports("avx2");
+#endif
+#ifdef BASE64_NEON
+    case base64_kernel_neon:
+        return 1;
+#endif
+    default:
+        return 0;
+    }
+}
+
+int base64_set_kernel(base64_kernel kernel)
+{
+    if (!base64_kernel_supported(kernel)) {
+        return 0;
+    }
+    selected_kernel = kernel;
+    return 1;
+}
+
+base64_kernel base64_get_kernel(void)
+{
+    if (selected_kernel != base64_kernel_auto) {
+        return selected_kernel;
+    }
+    if (base64_kernel_supported(base64_kernel_avx2)) {
+        return base64_kernel_avx2;
+    }
+    if (base64_kernel_supported(base64_kernel_sse41)) {
+        return base64_kernel_sse41;
+    }
+    if (base64_kernel_supported(base64_kernel_neon)) {
+        return base64_kernel_neon;
+    }
+    return base64_kernel_scalar;
+}
+
+const char* base64_kernel_name(base64_kernel kernel)
+{
+    switch (kernel) {
+    case base64_kernel_auto:
+        return "auto";
+    case base64_kernel_bytewise:
+        return "bytewise";
+    case base64_kernel_scalar:
+        return "scalar";
+    case base64_kernel_sse41:
+        return "sse4.1";
+    case base64_kernel_avx2:
+        return "avx2";
+    case base64_kernel_neon:
+        return "neon";
+    }
+    return "?";
+}
+
+size_t base64_encode_fast(const char* plaintext_in, size_t length_in, char* code_out)
+{
+    const uint8_t* in = (const uint8_t*)plaintext_in;
+    size_t done = 0;
+
+    switch (base64_get_kernel()) {
+    case base64_kernel_bytewise:
+        return 0;
+#ifdef BASE64_X86
+    case base64_kernel_avx2:
+        done = encode_avx2(in, length_in, code_out);
+        break;
+    case base64_kernel_sse41:
+        done = encode_sse41(in, length_in, code_out);
+        break;
+#endif
+#ifdef BASE64_NEON
+    case base64_kernel_neon:
+        done = encode_neon(in, length_in, code_out);
+        break;
+#endif
+    default:
+        break;
+    }
+    /* the rest which is smaller than a vector */
+    return done + encode_scalar(in + done, length_in - done, code_out + done / 3 * 4);
+}
+
+size_t base64_decode_fast(const char* code_in, size_t length_in, char* plaintext_out)
+{
+    const uint8_t* in = (const uint8_t*)code_in;
+    uint8_t* out = (uint8_t*)plaintext_out;
+    size_t done = 0;
+
+    switch (base64_get_kernel()) {
+    case base64_kernel_bytewise:
+        return 0;
+#ifdef BASE64_X86
+    case base64_kernel_avx2:
+        done = decode_avx2(in, length_in, out);
+        break;
+    case base64_kernel_sse41:
+        done = decode_sse41(in, length_in, out);
+        break;
+#endif
+#ifdef BASE64_NEON
+    case base64_kernel_neon:
+        done = decode_neon(in, length_in, out);
+        break;
+#endif
+    default:
+        break;
+    }
+    /* the rest which is smaller than a vector or the groups before an invalid character */
+    return done + decode_scalar(in + done, length_in - done, out + done / 4 * 3);
+}
@@ -0,0 +1,60 @@
+/*
+cbase64simd.h - c header for the vectorized base64 encoding and decoding
+
+This is part of the libb64 project, and has been placed in the public domain.
+For details, see http://sourceforge.net/projects/libb64
+*/
+
+#ifndef BASE64_CBASE64SIMD_H
+#define BASE64_CBASE64SIMD_H
+
+#include <stddef.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/*
+ * Implementations which are used by base64_encode_block() and
+ * base64_decode_block() for the bulk of the data: the state machine only
+ * processes the rest and (when decoding) the characters which are skipped.
+ */
+typedef enum {
+    base64_kernel_auto,     /* best kernel which is supported by the CPU */
+    base64_kernel_bytewise, /* state machine only */
+    base64_kernel_scalar,   /* 3 bytes <-> 4 characters per step */
+    base64_kernel_sse41,
+    base64_kernel_avx2,
+    base64_kernel_neon
+} base64_kernel;
+
+/*
+ * Selects the kernel (for all threads), e.g. to compare them.
+ * Returns 0 if the kernel is not supported by this build or CPU.
+ */
+int base64_set_kernel(base64_kernel kernel);
+
+/* Kernel which is actually used (never base64_kernel_auto) */
+base64_kernel base64_get_kernel(void);
+
+/* Name of the kernel for reporting */
+const char* base64_kernel_name(base64_kernel kernel);
+
+/*
+ * Encodes complete groups of 3 bytes: returns the number of consumed bytes,
+ * 4 characters are written per 3 bytes.
+ */
+size_t base64_encode_fast(const char* plaintext_in, size_t length_in, char* code_out);
+
+/*
+ * Decodes complete groups of 4 characters up to the first character which is
+ * not in the base64 alphabet (e.g. '=' or white space): returns the number of
+ * consumed characters, 3 bytes are written per 4 characters.
+ */
+size_t base64_decode_fast(const char* code_in, size_t length_in, char* plaintext_out);
+
+#ifdef __cplusplus
+} // extern "C"
+#endif
+
+#endif /* BASE64_CBASE64SIMD_H */
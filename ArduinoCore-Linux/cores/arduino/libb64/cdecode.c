@@ -6,6 +6,7 @@ For details, see http://sourceforge.net/projects/libb64
 */
 
 #include "cdecode.h"
+#include "cbase64simd.h"
 #include <stdint.h>
 
 static int base64_decode_value_signed(int8_t value_in){
@@ -81,22 +82,42 @@ static int base64_decode_block_signed(const int8_t* code_in, const int length_in
   return plainchar - plaintext_out;
 }
 
-static int base64_decode_chars_signed(const int8_t* code_in, const int length_in, int8_t* plaintext_out){
-  base64_decodestate _state;
-  base64_init_decodestate(&_state);
-  int len = base64_decode_block_signed(code_in, length_in, plaintext_out, &_state);
-  if(len > 0) plaintext_out[len] = 0;
-  return len;
-}
 
 int base64_decode_value(char value_in){
   return base64_decode_value_signed((int8_t)value_in);
 }
 
+/*
+ * Complete groups of 4 characters are decoded by the (vectorized) kernel: the
+ * state machine only processes the characters which are skipped (e.g. '=' or
+ * line breaks) and the following characters until a group is complete again.
+ */
 int base64_decode_block(const char* code_in, const int length_in, char* plaintext_out, base64_decodestate* state_in){
-  return base64_decode_block_signed((const int8_t *) code_in, length_in, (int8_t *) plaintext_out, state_in);
+  if (base64_get_kernel() == base64_kernel_bytewise || length_in <= 0){
+    return base64_decode_block_signed((const int8_t *) code_in, length_in, (int8_t *) plaintext_out, state_in);
+  }
+
+  const char* codechar = code_in;
+  const char* const codeend = code_in + length_in;
+  char* plainchar = plaintext_out;
+
+  while (codechar < codeend){
+    if (state_in->step == step_a){
+      size_t done = base64_decode_fast(codechar, codeend - codechar, plainchar);
+      codechar += done;
+      plainchar += done / 4 * 3;
+      if (codechar == codeend) break;
+    }
+    plainchar += base64_decode_block_signed((const int8_t *) codechar, 1, (int8_t *) plainchar, state_in);
+    codechar++;
+  }
+  return plainchar - plaintext_out;
 }
 
 int base64_decode_chars(const char* code_in, const int length_in, char* plaintext_out){
-  return base64_decode_chars_signed((const int8_t *) code_in, length_in, (int8_t *) plaintext_out);
+  base64_decodestate _state;
+  base64_init_decodestate(&_state);
+  int len = base64_decode_block(code_in, length_in, plaintext_out, &_state);
+  if(len > 0) plaintext_out[len] = 0;
+  return len;
 }
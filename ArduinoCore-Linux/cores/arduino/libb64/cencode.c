@@ -6,6 +6,7 @@ For details, see http://sourceforge.net/projects/libb64
 */
 
 #include "cencode.h"
+#include "cbase64simd.h"
 
 void base64_init_encodestate(base64_encodestate* state_in)
 {
@@ -31,6 +32,13 @@ int base64_encode_block(const char* plaintext_in, int length_in, char* code_out,
     char result;
     char fragment;
 
+    /* complete groups of 3 bytes are encoded by the (vectorized) kernel */
+    if (state_in->step == step_A && length_in > 0) {
+        size_t done = base64_encode_fast(plaintext_in, (size_t)length_in, code_out);
+        plainchar += done;
+        codechar += done / 3 * 4;
+    }
+
     result = state_in->result;
 
     switch (state_in->step) {
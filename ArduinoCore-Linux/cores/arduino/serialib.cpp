@@ -15,6 +15,11 @@ This is a licence-free software, it can be used by anyone who try to build a bet
 #if PROVIDE_SERIALLIB
 #include "serialib.h"
 
+#ifdef __linux__
+// Defined in serialib_termios2.cpp
+char serialib_setCustomBaudRate(int fd, unsigned int Bauds);
+#endif
+
 
 //_____________________________________
 // ::: Constructors and destructors :::
@@ -30,6 +35,10 @@ serialib::serialib()
     currentStateRTS=true;
     currentStateDTR=true;
 #endif
+#ifdef __linux__
+    fd=-1;
+    packetMode=false;
+#endif
 }
 
 
@@ -81,6 +90,9 @@ serialib::~serialib()
                         - 38400
                         - 57600
                         - 115200
+                        - 230400 up to 4000000 (standard rates)
+                        - any other rate which is supported by the device (termios2)
+                        \n The low latency mode of the driver is activated if available.
      \return 1 success
      \return -1 device not found
      \return -2 error while opening the device
@@ -168,6 +180,7 @@ char serialib::openDevice(const char *Device,const unsigned int Bauds)
     if (fd == -1) return -2;
     // Open the device in nonblocking mode
     fcntl(fd, F_SETFL, FNDELAY);
+    packetMode=false;
 
 
     // Get the current options of the port
@@ -190,11 +203,54 @@ char serialib::openDevice(const char *Device,const unsigned int Bauds)
     case 38400 :    Speed=B38400; break;
     case 57600 :    Speed=B57600; break;
     case 115200 :   Speed=B115200; break;
-    default : return -4;
-    }    
+#ifdef B230400
+    case 230400 :   Speed=B230400; break;
+#endif
+#ifdef B460800
+    case 460800 :   Speed=B460800; break;
+#endif
+#ifdef B500000
+    case 500000 :   Speed=B500000; break;
+#endif
+#ifdef B576000
+    case 576000 :   Speed=B576000; break;
+#endif
+#ifdef B921600
+    case 921600 :   Speed=B921600; break;
+#endif
+#ifdef B1000000
+    case 1000000 :  Speed=B1000000; break;
+#endif
+#ifdef B1152000
+    case 1152000 :  Speed=B1152000; break;
+#endif
+#ifdef B1500000
+    case 1500000 :  Speed=B1500000; break;
+#endif
+#ifdef B2000000
+    case 2000000 :  Speed=B2000000; break;
+#endif
+#ifdef B2500000
+    case 2500000 :  Speed=B2500000; break;
+#endif
+#ifdef B3000000
+    case 3000000 :  Speed=B3000000; break;
+#endif
+#ifdef B3500000
+    case 3500000 :  Speed=B3500000; break;
+#endif
+#ifdef B4000000
+    case 4000000 :  Speed=B4000000; break;
+#endif
+    // Other rates (e.g. 250000) are set with termios2 below
+    default :       Speed=0; break;
+    }
+    if (Bauds==0) return -4;
     // Set the baud rate
-    cfsetispeed(&options, Speed);
-    cfsetospeed(&options, Speed);
+    if (Speed!=0) {
+        cfsetispeed(&options, Speed);
+        cfsetospeed(&options, Speed);
+    }
     // Configure the device : 8 bits, no parity, no control
     options.c_cflag |= ( CLOCAL | CREAD |  CS8);
     options.c_iflag |= ( IGNPAR | IGNBRK );
@@ -204,6 +260,17 @@ char serialib::openDevice(const char *Device,const unsigned int Bauds)
     options.c_cc[VMIN]=0;
     // Activate the settings
     tcsetattr(fd, TCSANOW, &options);
+    // Non standard baud rate
+    if (Speed==0 && serialib_setCustomBaudRate(fd, Bauds)!=1) {
+        closeDevice();
+        return -4;
+    }
+    // Deliver the received data without delay (e.g. for FTDI adapters)
+    struct serial_struct serial;
+    if (ioctl(fd, TIOCGSERIAL, &serial)==0 && !(serial.flags & ASYNC_LOW_LATENCY)) {
+        serial.flags |= ASYNC_LOW_LATENCY;
+        ioctl(fd, TIOCSSERIAL, &serial);
+    }
     // Success
     return (1);
 #endif
@@ -211,6 +278,48 @@ char serialib::openDevice(const char *Device,const unsigned int Bauds)
 }
 
 
+/*!
+     \brief Configure packetized reads with VMIN/VTIME (Linux only)
+            The device is switched to blocking mode: readChar() and readBytes() wait
+            in poll() for the first byte (up to their timeout) and only then call
+            read(), which returns when minBytes are available or when no byte was
+            received for interByteTimeout_ds. Use minBytes=0 to switch back to the
+            default non-blocking mode.
+     \param minBytes : minimum number of bytes of a packet (VMIN)
+     \param interByteTimeout_ds : inter-byte timeout in 1/10 s (VTIME), must not
+            be 0 if minBytes is not 0
+     \return 1 success
+     \return -1 invalid parameters or error while writing port parameters
+  */
+char serialib::setPacketMode(unsigned char minBytes, unsigned char interByteTimeout_ds)
+{
+#if defined (_WIN32) || defined( _WIN64)
+    // Avoid warning while compiling
+    UNUSED(minBytes);
+    UNUSED(interByteTimeout_ds);
+    return -1;
+#endif
+#ifdef __linux__
+    // A read could block forever
+    if (minBytes>0 && interByteTimeout_ds==0) return -1;
+
+    struct termios options;
+    if (tcgetattr(fd, &options)!=0) return -1;
+    options.c_cc[VMIN]=minBytes;
+    options.c_cc[VTIME]=minBytes>0 ? interByteTimeout_ds : 0;
+    if (tcsetattr(fd, TCSANOW, &options)!=0) return -1;
+
+    // VMIN/VTIME are only used in blocking mode
+    int flags=fcntl(fd, F_GETFL);
+    if (minBytes>0) flags &= ~O_NONBLOCK;
+    else flags |= O_NONBLOCK;
+    fcntl(fd, F_SETFL, flags);
+    packetMode=minBytes>0;
+    return 1;
+#endif
+}
+
+
 /*!
      \brief Close the connection with the current device
 */
@@ -220,7 +329,8 @@ void serialib::closeDevice()
     CloseHandle(hSerial);
 #endif
 #ifdef __linux__
-    close (fd);
+    if (fd>=0) close (fd);
+    fd=-1;
 #endif
 }
 
@@ -362,16 +472,39 @@ char serialib::readChar(char *pByte,unsigned int timeOut_ms)
     timeOut         timer;
     // Initialise the timer
     timer.initTimer();
-    // While Timeout is not reached
-    while (timer.elapsedTime_ms()<timeOut_ms || timeOut_ms==0)
+    while (true)
     {
+        // In packet mode the device is blocking: we only read after poll()
+        // reported data, so that the timeout is respected
+        if (packetMode)
+        {
+            int Remaining=-1;
+            if (timeOut_ms!=0)
+            {
+                Remaining=(int)timeOut_ms-(int)timer.elapsedTime_ms();
+                if (Remaining<=0) return 0;
+            }
+            int Ready=waitForData(Remaining);
+            if (Ready<0) return -2;
+            // Timeout or interrupted: check the remaining time again
+            if (Ready==0) continue;
+        }
         // Try to read a byte on the device
-        switch (read(fd,pByte,1)) {
-        case 1  : return 1; // Read successfull
-        case -1 : return -2; // Error while reading
+        int Ret=read(fd,pByte,1);
+        // Read successfull
+        if (Ret==1) return 1;
+        // Error while reading
+        if (Ret==-1 && errno!=EAGAIN && errno!=EINTR) return -2;
+
+        // Block until data is available or the timeout is reached
+        int Remaining=-1;
+        if (timeOut_ms!=0)
+        {
+            Remaining=(int)timeOut_ms-(int)timer.elapsedTime_ms();
+            if (Remaining<=0) return 0;
         }
+        if (waitForData(Remaining)<0) return -2;
     }
-    return 0;
 #endif
 }
 
@@ -502,9 +635,8 @@ int serialib::readString(char *receivedString,char finalChar,unsigned int maxNbB
      \param buffer : array of bytes read from the serial device
      \param maxNbBytes : maximum allowed number of bytes read
      \param timeOut_ms : delay of timeout before giving up the reading
-     \param sleepDuration_us : delay of CPU relaxing in microseconds (Linux only)
-            In the reading loop, a sleep can be performed after each reading
-            This allows CPU to perform other tasks
+     \param sleepDuration_us : not used anymore: on Linux the reading loop blocks
+            in poll() until data is available or the timeout is reached
      \return >=0 return the number of bytes read before timeout or
                 requested data is completed
      \return -1 error while setting the Timeout
@@ -533,34 +665,58 @@ int serialib::readBytes (void *buffer,unsigned int maxNbBytes,unsigned int timeO
     return dwBytesRead;
 #endif
 #ifdef __linux__
+    // Avoid warning while compiling: we block in poll() instead of sleeping
+    UNUSED(sleepDuration_us);
+
     // Timer used for timeout
     timeOut          timer;
     // Initialise the timer
     timer.initTimer();
     unsigned int     NbByteRead=0;
-    // While Timeout is not reached
-    while (timer.elapsedTime_ms()<timeOut_ms || timeOut_ms==0)
+    while (NbByteRead<maxNbBytes)
     {
+        // In packet mode the device is blocking: we only read after poll()
+        // reported data, so that the timeout is respected
+        if (packetMode)
+        {
+            int Remaining=-1;
+            if (timeOut_ms!=0)
+            {
+                Remaining=(int)timeOut_ms-(int)timer.elapsedTime_ms();
+                if (Remaining<=0) break;
+            }
+            int Ready=waitForData(Remaining);
+            if (Ready<0) return -2;
+            // Timeout or interrupted: check the remaining time again
+            if (Ready==0) continue;
+        }
         // Compute the position of the current byte
         unsigned char* Ptr=(unsigned char*)buffer+NbByteRead;
-        // Try to read a byte on the device
+        // Read all bytes which are available
         int Ret=read(fd,(void*)Ptr,maxNbBytes-NbByteRead);
         // Error while reading
-        if (Ret==-1) return -2;
+        if (Ret==-1 && errno!=EAGAIN && errno!=EINTR) return -2;
 
         // One or several byte(s) has been read on the device
         if (Ret>0)
         {
             // Increase the number of read bytes
             NbByteRead+=Ret;
-            // Success : bytes has been read
-            if (NbByteRead>=maxNbBytes)
-                return NbByteRead;
+            // A packet is complete
+            if (packetMode) break;
+            continue;
         }
-        // Suspend the loop to avoid charging the CPU
-        usleep (sleepDuration_us);
+
+        // Block until more data is available or the timeout is reached
+        int Remaining=-1;
+        if (timeOut_ms!=0)
+        {
+            Remaining=(int)timeOut_ms-(int)timer.elapsedTime_ms();
+            if (Remaining<=0) break;
+        }
+        if (waitForData(Remaining)<0) return -2;
     }
-    // Timeout reached, return the number of bytes read
+    // Return the number of bytes read
     return NbByteRead;
 #endif
 }
@@ -568,6 +724,36 @@ int serialib::readBytes (void *buffer,unsigned int maxNbBytes,unsigned int timeO
 
 
 
+/*!
+     \brief Wait until data can be read from the device (Linux only)
+     \param timeOut_ms : max time to wait, -1 to wait without timeout
+     \return 1 data is available
+     \return 0 timeout reached or interrupted
+     \return -1 error while waiting
+  */
+int serialib::waitForData(int timeOut_ms)
+{
+#if defined (_WIN32) || defined(_WIN64)
+    UNUSED(timeOut_ms);
+    return 1;
+#endif
+#ifdef __linux__
+    struct pollfd Fds;
+    Fds.fd=fd;
+    Fds.events=POLLIN;
+    Fds.revents=0;
+    int Ret=poll(&Fds,1,timeOut_ms);
+    if (Ret<0) return errno==EINTR ? 0 : -1;
+    // The device was closed or removed
+    if (Ret>0 && (Fds.revents & (POLLERR | POLLNVAL))) return -1;
+    if (Ret>0 && (Fds.revents & POLLHUP) && !(Fds.revents & POLLIN)) return -1;
+    return Ret>0 ? 1 : 0;
+#endif
+}
+
+
+
+
 // _________________________
 // ::: Special operation :::
 
@@ -620,6 +806,39 @@ int serialib::available()
 
 
 
+/*!
+    \brief Wait until all output written to the device has been transmitted
+    \return If the function succeeds, the return value is nonzero.
+            If the function fails, the return value is zero.
+*/
+char serialib::drainTransmitter()
+{
+#if defined (_WIN32) || defined(_WIN64)
+    return FlushFileBuffers(hSerial);
+#endif
+#ifdef __linux__
+    return tcdrain(fd)==0;
+#endif
+}
+
+
+
+/*!
+    \brief Return the file descriptor of the device, e.g. to wait with poll() (Linux only)
+    \return The file descriptor or -1 if the device is not open or not supported
+*/
+int serialib::fileDescriptor()
+{
+#if defined (_WIN32) || defined(_WIN64)
+    return -1;
+#endif
+#ifdef __linux__
+    return fd;
+#endif
+}
+
+
+
 // __________________
 // ::: I/O Access :::
 
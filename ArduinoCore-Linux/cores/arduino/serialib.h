@@ -36,6 +36,10 @@ This is a licence-free software, it can be used by anyone who try to build a bet
     #include <fcntl.h>
     #include <unistd.h>
     #include <sys/ioctl.h>
+    #include <linux/serial.h>
+    // Waiting for data
+    #include <poll.h>
+    #include <errno.h>
 #endif
 
 
@@ -73,6 +77,9 @@ public:
     // Close the current device
     void    closeDevice();
 
+    // Return packets of at least minBytes or after an inter-byte gap (Linux only)
+    char    setPacketMode(unsigned char minBytes, unsigned char interByteTimeout_ds);
+
 
 
 
@@ -127,6 +134,12 @@ public:
     // Return the number of bytes in the received buffer
     int     available();
 
+    // Wait until all data has been transmitted
+    char    drainTransmitter();
+
+    // Return the file descriptor of the device (Linux only)
+    int     fileDescriptor();
+
 
 
 
@@ -164,6 +177,9 @@ public:
 
 
 private:
+    // Wait until data can be read (-1 = no timeout)
+    int             waitForData(int timeOut_ms);
+
     // Read a string (no timeout)
     int             readStringNoTimeOut  (char *String,char FinalChar,unsigned int MaxNbBytes);
 
@@ -183,6 +199,8 @@ private:
 #endif
 #ifdef __linux__
     int             fd;
+    // readBytes() returns after each packet
+    bool            packetMode;
 #endif
 
 };
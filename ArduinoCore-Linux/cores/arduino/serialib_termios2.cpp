@@ -0,0 +1,44 @@
+/*!
+ \file    serialib_termios2.cpp
+ \brief   Arbitrary baud rates for serialib on Linux (termios2 / BOTHER).
+          The kernel definitions of <asm/termbits.h> conflict with the ones of
+          the C library <termios.h>, so they need to be used in a separate
+          compilation unit.
+ */
+
+#if PROVIDE_SERIALLIB && defined(__linux__)
+#include <asm/ioctls.h>
+#include <asm/termbits.h>
+
+// <sys/ioctl.h> would pull in the C library termios definitions
+extern "C" int ioctl(int fd, unsigned long request, ...);
+
+/*!
+     \brief Set an arbitrary baud rate with TCSETS2 and BOTHER
+     \param fd : file descriptor of the open device
+     \param Bauds : baud rate in bits per second
+     \return 1 success
+     \return -1 the rate is not supported by the kernel or the device
+  */
+char serialib_setCustomBaudRate(int fd, unsigned int Bauds)
+{
+#if defined(TCGETS2) && defined(BOTHER)
+    struct termios2 options;
+    if (ioctl(fd, TCGETS2, &options) != 0) return -1;
+    options.c_cflag &= ~CBAUD;
+    options.c_cflag |= BOTHER;
+    options.c_ispeed = Bauds;
+    options.c_ospeed = Bauds;
+    if (ioctl(fd, TCSETS2, &options) != 0) return -1;
+    // Check that the device accepted the rate
+    if (ioctl(fd, TCGETS2, &options) != 0) return -1;
+    if (options.c_ospeed != Bauds) return -1;
+    return 1;
+#else
+    (void)fd;
+    (void)Bauds;
+    return -1;
+#endif
+}
+
+#endif
@@ -1,129 +1,183 @@
+/*
+  HardwareGPIO_FIR.cpp
+  Copyright (c) 2025 Phil Schatzmann. All right reserved.
 
+  This library is free software; you can redistribute it and/or
+  modify it under the terms of the GNU Lesser General Public
+  License as published by the Free Software Foundation; either
+  version 2.1 of the License, or (at your option) any later version.
 
+  This library is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+  Lesser General Public License for more details.
+
+  You should have received a copy of the GNU Lesser General Public
+  License along with this library; if not, write to the Free Software
+  Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA 02110-1301 USA
+*/
+#ifdef USE_FIRMATA
 #include "HardwareGPIO_FIR.h"
-#include "Stream.h" // or <Stream.h> if needed
-#include <map>
-#include <vector>
+#include "Arduino.h"
 #include <cstdint>
 
 namespace arduino {
 
-
-Stream* firmataStream = nullptr;
-std::map<pin_size_t, PinMode> pinModes;
-std::map<pin_size_t, PinStatus> pinStates;
-std::map<pin_size_t, int> analogValues;
-std::vector<uint8_t> rxBuffer;
-
 // Firmata protocol constants
 constexpr uint8_t DIGITAL_MESSAGE = 0x90;
 constexpr uint8_t ANALOG_MESSAGE = 0xE0;
-constexpr uint8_t SET_PIN_MODE = 0xF4;
-constexpr uint8_t REPORT_DIGITAL = 0xD0;
 constexpr uint8_t REPORT_ANALOG = 0xC0;
+constexpr uint8_t REPORT_DIGITAL = 0xD0;
+constexpr uint8_t SET_PIN_MODE = 0xF4;
+constexpr uint8_t REPORT_VERSION = 0xF9;
+constexpr uint8_t START_SYSEX = 0xF0;
+constexpr uint8_t END_SYSEX = 0xF7;
+
+// Sysex commands
+constexpr uint8_t ANALOG_MAPPING_QUERY = 0x69;
+constexpr uint8_t ANALOG_MAPPING_RESPONSE = 0x6A;
+constexpr uint8_t CAPABILITY_QUERY = 0x6B;
+constexpr uint8_t CAPABILITY_RESPONSE = 0x6C;
+constexpr uint8_t EXTENDED_ANALOG = 0x6F;
+constexpr uint8_t SERVO_CONFIG = 0x70;
+constexpr uint8_t STRING_DATA = 0x71;
+constexpr uint8_t I2C_REPLY = 0x77;
+constexpr uint8_t REPORT_FIRMWARE = 0x79;
+constexpr uint8_t SAMPLING_INTERVAL = 0x7A;
+
+// Firmata pin modes
+constexpr uint8_t MODE_INPUT = 0x00;
+constexpr uint8_t MODE_OUTPUT = 0x01;
+constexpr uint8_t MODE_PWM = 0x03;
+constexpr uint8_t MODE_SERVO = 0x04;
+constexpr uint8_t MODE_PULLUP = 0x0B;
 
 HardwareGPIO_FIRMATA::~HardwareGPIO_FIRMATA() {
     end();
 }
 
-bool HardwareGPIO_FIRMATA::begin(Stream &stream) {
-    firmataStream = &stream;
+bool HardwareGPIO_FIRMATA::begin(Stream &stream, int samplingIntervalMs) {
+    end();
+    firmata_stream = &stream;
+    for (int j = 0; j < MAX_PORTS; j++) {
+        digital_inputs[j] = 0;
+        reported_ports[j] = false;
+        output_ports[j] = 0;
+    }
+    dirty_ports = 0;
+    for (int j = 0; j < MAX_PINS; j++) {
+        pin_modes[j] = MODE_UNDEFINED;
+        analog_values[j] = 0;
+        capabilities[j] = 0;
+        analog_map[j] = -1;
+    }
+    for (int j = 0; j < MAX_ANALOG; j++) {
+        reported_analog[j] = false;
+    }
+    has_capabilities = false;
+    has_analog_mapping = false;
+    i2c_replies.clear();
+    command = 0;
+    data_len = 0;
+    in_sysex = false;
     is_open = true;
-    rxBuffer.clear();
+
+    parser_running = true;
+    parser_thread = std::thread(&HardwareGPIO_FIRMATA::parserThreadFunction, this);
+
+    // query the device
+    const uint8_t queries[] = {START_SYSEX, REPORT_FIRMWARE, END_SYSEX,
+                               START_SYSEX, CAPABILITY_QUERY, END_SYSEX,
+                               START_SYSEX, ANALOG_MAPPING_QUERY, END_SYSEX};
+    send(queries, sizeof(queries));
+    setSamplingInterval(samplingIntervalMs);
     return true;
 }
 
 void HardwareGPIO_FIRMATA::end() {
+    if (is_open) flush();
+    parser_running = false;
+    if (parser_thread.joinable()) {
+        parser_thread.join();
+    }
     is_open = false;
-    firmataStream = nullptr;
-    pinModes.clear();
-    pinStates.clear();
-    analogValues.clear();
-    rxBuffer.clear();
+    firmata_stream = nullptr;
 }
 
 void HardwareGPIO_FIRMATA::pinMode(pin_size_t pinNumber, PinMode pinMode) {
-    pinModes[pinNumber] = pinMode;
-    if (firmataStream) {
-        firmataStream->write(SET_PIN_MODE);
-        firmataStream->write(pinNumber);
-        firmataStream->write(pinMode);
+    uint8_t mode = firmataMode(pinMode);
+    if (pinNumber < MAX_PINS) {
+        std::lock_guard<std::mutex> lock(write_mutex);
+        pin_modes[pinNumber] = mode;
+    }
+    const uint8_t msg[] = {SET_PIN_MODE, (uint8_t)(pinNumber & 0x7F), mode};
+    send(msg, sizeof(msg));
+    if (pinMode == INPUT || pinMode == INPUT_PULLUP) {
+        reportDigital(pinNumber / 8);
     }
 }
 
 void HardwareGPIO_FIRMATA::digitalWrite(pin_size_t pinNumber, PinStatus status) {
-    pinStates[pinNumber] = status;
-    if (firmataStream) {
-        uint8_t port = pinNumber / 8;
-        uint8_t portValue = 0;
-        for (int i = 0; i < 8; ++i) {
-            pin_size_t p = port * 8 + i;
-            if (pinStates[p] == HIGH) {
-                portValue |= (1 << i);
-            }
+    if (pinNumber >= MAX_PINS) return;
+    uint8_t port = pinNumber / 8;
+    uint8_t msg[3];
+    {
+        std::lock_guard<std::mutex> lock(write_mutex);
+        uint8_t value = output_ports[port];
+        if (status == HIGH) {
+            value |= (1 << (pinNumber % 8));
+        } else {
+            value &= ~(1 << (pinNumber % 8));
         }
-        firmataStream->write(DIGITAL_MESSAGE | port);
-        firmataStream->write(portValue & 0x7F);
-        firmataStream->write((portValue >> 7) & 0x7F);
+        output_ports[port] = value;
+        if (!is_auto_flush) {
+            // sent with the next flush()
+            dirty_ports |= (1 << port);
+            return;
+        }
+        dirty_ports &= ~(1 << port);
+        msg[0] = DIGITAL_MESSAGE | port;
+        msg[1] = value & 0x7F;
+        msg[2] = (value >> 7) & 0x7F;
     }
+    send(msg, sizeof(msg));
 }
 
-PinStatus HardwareGPIO_FIRMATA::digitalRead(pin_size_t pinNumber) {
-    // Request digital report for the port
-    if (firmataStream) {
-        uint8_t port = pinNumber / 8;
-        firmataStream->write(REPORT_DIGITAL | port);
-        firmataStream->write(1); // enable reporting
-    }
-    // Try to parse digital message from rxBuffer
-    for (size_t i = 0; i + 2 < rxBuffer.size(); ++i) {
-        uint8_t msg = rxBuffer[i];
-        if ((msg & 0xF0) == DIGITAL_MESSAGE) {
-            uint8_t port = msg & 0x0F;
-            uint8_t lsb = rxBuffer[i+1];
-            uint8_t msb = rxBuffer[i+2];
-            uint16_t portValue = lsb | (msb << 7);
-            pin_size_t p = port * 8;
-            for (int j = 0; j < 8; ++j) {
-                pinStates[p + j] = (portValue & (1 << j)) ? HIGH : LOW;
-            }
-            // Remove processed message
-            rxBuffer.erase(rxBuffer.begin(), rxBuffer.begin() + i + 3);
-            break;
+void HardwareGPIO_FIRMATA::flush() {
+    uint8_t msg[MAX_PORTS * 3];
+    int len = 0;
+    {
+        std::lock_guard<std::mutex> lock(write_mutex);
+        for (int port = 0; port < MAX_PORTS; port++) {
+            if (!(dirty_ports & (1 << port))) continue;
+            msg[len++] = DIGITAL_MESSAGE | port;
+            msg[len++] = output_ports[port] & 0x7F;
+            msg[len++] = (output_ports[port] >> 7) & 0x7F;
         }
+        dirty_ports = 0;
     }
-    auto it = pinStates.find(pinNumber);
-    if (it != pinStates.end()) {
-        return it->second;
-    }
-    return LOW;
+    if (len > 0) send(msg, len);
+}
+
+PinStatus HardwareGPIO_FIRMATA::digitalRead(pin_size_t pinNumber) {
+    if (pinNumber >= MAX_PINS) return LOW;
+    uint8_t port = pinNumber / 8;
+    reportDigital(port);
+    uint16_t portValue = digital_inputs[port].load(std::memory_order_relaxed);
+    return (portValue & (1 << (pinNumber % 8))) ? HIGH : LOW;
 }
 
 int HardwareGPIO_FIRMATA::analogRead(pin_size_t pinNumber) {
-    // Request analog report for the pin
-    if (firmataStream) {
-        firmataStream->write(REPORT_ANALOG | (pinNumber & 0x0F));
-        firmataStream->write(1); // enable reporting
-    }
-    // Try to parse analog message from rxBuffer
-    for (size_t i = 0; i + 2 < rxBuffer.size(); ++i) {
-        uint8_t msg = rxBuffer[i];
-        if ((msg & 0xF0) == ANALOG_MESSAGE) {
-            uint8_t pin = msg & 0x0F;
-            uint8_t lsb = rxBuffer[i+1];
-            uint8_t msb = rxBuffer[i+2];
-            int value = lsb | (msb << 7);
-            analogValues[pin] = value;
-            // Remove processed message
-            rxBuffer.erase(rxBuffer.begin(), rxBuffer.begin() + i + 3);
-            break;
-        }
-    }
-    auto it = analogValues.find(pinNumber);
-    if (it != analogValues.end()) {
-        return it->second;
+    // we accept the pin number or the analog channel
+    int channel = analogChannel(pinNumber);
+    if (channel < 0) channel = pinNumber;
+    if (channel >= MAX_PINS) return 0;
+    // enable the reporting only once
+    if (channel < MAX_ANALOG && !reported_analog[channel].exchange(true)) {
+        const uint8_t msg[] = {(uint8_t)(REPORT_ANALOG | channel), 1};
+        send(msg, sizeof(msg));
     }
-    return 0;
+    return analog_values[channel].load(std::memory_order_relaxed);
 }
 
 void HardwareGPIO_FIRMATA::analogReference(uint8_t mode) {
@@ -131,10 +185,20 @@ void HardwareGPIO_FIRMATA::analogReference(uint8_t mode) {
 }
 
 void HardwareGPIO_FIRMATA::analogWrite(pin_size_t pinNumber, int value) {
-    if (firmataStream) {
-        firmataStream->write(ANALOG_MESSAGE | (pinNumber & 0x0F));
-        firmataStream->write(value & 0x7F);
-        firmataStream->write((value >> 7) & 0x7F);
+    if (pinNumber >= MAX_PINS) return;
+    // servo pins keep their mode
+    if (pin_modes[pinNumber] != MODE_SERVO) setFirmataMode(pinNumber, MODE_PWM);
+    if (pinNumber < 16 && value >= 0 && value < 0x4000) {
+        const uint8_t msg[] = {(uint8_t)(ANALOG_MESSAGE | pinNumber),
+                               (uint8_t)(value & 0x7F),
+                               (uint8_t)((value >> 7) & 0x7F)};
+        send(msg, sizeof(msg));
+    } else {
+        // pin followed by the value in 7 bit groups
+        const uint8_t data[] = {(uint8_t)pinNumber, (uint8_t)(value & 0x7F),
+                                (uint8_t)((value >> 7) & 0x7F),
+                                (uint8_t)((value >> 14) & 0x7F)};
+        sendSysex(EXTENDED_ANALOG, data, sizeof(data));
     }
 }
 
@@ -164,4 +228,270 @@ void HardwareGPIO_FIRMATA::analogWriteResolution(uint8_t bits) {
     // Firmata supports 8-bit resolution, do nothing
 }
 
+void HardwareGPIO_FIRMATA::setSamplingInterval(int ms) {
+    const uint8_t msg[] = {START_SYSEX, SAMPLING_INTERVAL, (uint8_t)(ms & 0x7F),
+                           (uint8_t)((ms >> 7) & 0x7F), END_SYSEX};
+    send(msg, sizeof(msg));
+}
+
+void HardwareGPIO_FIRMATA::servoConfig(pin_size_t pin, int minPulse, int maxPulse) {
+    const uint8_t data[] = {(uint8_t)(pin & 0x7F),
+                            (uint8_t)(minPulse & 0x7F), (uint8_t)((minPulse >> 7) & 0x7F),
+                            (uint8_t)(maxPulse & 0x7F), (uint8_t)((maxPulse >> 7) & 0x7F)};
+    sendSysex(SERVO_CONFIG, data, sizeof(data));
+    // the servo config implicitly sets the mode on the device
+    if (pin < MAX_PINS) {
+        std::lock_guard<std::mutex> lock(write_mutex);
+        pin_modes[pin] = MODE_SERVO;
+    }
+}
+
+void HardwareGPIO_FIRMATA::sendSysex(uint8_t command, const uint8_t* data, size_t len) {
+    std::vector<uint8_t> msg;
+    msg.reserve(len + 3);
+    msg.push_back(START_SYSEX);
+    msg.push_back(command);
+    msg.insert(msg.end(), data, data + len);
+    msg.push_back(END_SYSEX);
+    send(msg.data(), msg.size());
+}
+
+bool HardwareGPIO_FIRMATA::waitForI2CReply(uint8_t address, int reg, uint32_t lastCount,
+                                           std::vector<uint8_t>& data, int timeoutMs) {
+    unsigned long start = millis();
+    while (millis() - start <= (unsigned long)timeoutMs) {
+        if (i2c_reply_count != lastCount) {
+            // the replies of other devices or registers stay queued
+            std::lock_guard<std::mutex> lock(info_mutex);
+            for (auto it = i2c_replies.begin(); it != i2c_replies.end(); it++) {
+                if ((int32_t)(it->count - lastCount) >= 0 && it->address == address &&
+                    (reg < 0 || it->reg == reg)) {
+                    data = std::move(it->data);
+                    i2c_replies.erase(it);
+                    return true;
+                }
+            }
+        }
+        std::this_thread::sleep_for(std::chrono::microseconds(100));
+    }
+    return false;
+}
+
+bool HardwareGPIO_FIRMATA::waitForCapabilities(int timeoutMs) {
+    unsigned long start = millis();
+    while (!(has_capabilities && has_analog_mapping)) {
+        if (millis() - start > (unsigned long)timeoutMs) return false;
+        delay(1);
+    }
+    return true;
+}
+
+uint32_t HardwareGPIO_FIRMATA::pinCapabilities(pin_size_t pin) {
+    if (pin >= MAX_PINS) return 0;
+    std::lock_guard<std::mutex> lock(info_mutex);
+    return capabilities[pin];
+}
+
+int HardwareGPIO_FIRMATA::analogChannel(pin_size_t pin) {
+    if (pin >= MAX_PINS || !has_analog_mapping) return -1;
+    std::lock_guard<std::mutex> lock(info_mutex);
+    return analog_map[pin];
+}
+
+std::string HardwareGPIO_FIRMATA::firmwareName() {
+    std::lock_guard<std::mutex> lock(info_mutex);
+    return firmware_name;
+}
+
+void HardwareGPIO_FIRMATA::parserThreadFunction() {
+    uint8_t buffer[256];
+    while (parser_running) {
+        int available = firmata_stream->available();
+        if (available <= 0) {
+            std::this_thread::sleep_for(std::chrono::microseconds(200));
+            continue;
+        }
+        int n = firmata_stream->readBytes(buffer, min(available, (int)sizeof(buffer)));
+        for (int j = 0; j < n; j++) {
+            parse(buffer[j]);
+        }
+    }
+}
+
+void HardwareGPIO_FIRMATA::parse(uint8_t byte) {
+    if (in_sysex) {
+        if (byte == END_SYSEX) {
+            in_sysex = false;
+            processSysex();
+        } else if (sysex_len < MAX_SYSEX) {
+            sysex[sysex_len++] = byte;
+        }
+        return;
+    }
+
+    if (byte & 0x80) {
+        // start of a new message
+        data_len = 0;
+        if (byte == START_SYSEX) {
+            in_sysex = true;
+            sysex_len = 0;
+            command = 0;
+            return;
+        }
+        uint8_t type = byte < 0xF0 ? byte & 0xF0 : byte;
+        switch (type) {
+            case DIGITAL_MESSAGE:
+            case ANALOG_MESSAGE:
+            case REPORT_VERSION:
+                command = byte;
+                data_expected = 2;
+                break;
+            default:
+                // messages which we do not expect from the device
+                command = 0;
+        }
+        return;
+    }
+
+    // data byte
+    if (command == 0) return;
+    data[data_len++] = byte;
+    if (data_len == data_expected) {
+        processMessage();
+        data_len = 0;
+    }
+}
+
+void HardwareGPIO_FIRMATA::processMessage() {
+    uint16_t value = data[0] | (data[1] << 7);
+    if (command == REPORT_VERSION) {
+        command = 0;
+        return;
+    }
+    switch (command & 0xF0) {
+        case DIGITAL_MESSAGE:
+            digital_inputs[command & 0x0F].store(value, std::memory_order_relaxed);
+            break;
+        case ANALOG_MESSAGE:
+            analog_values[command & 0x0F].store(value, std::memory_order_relaxed);
+            break;
+    }
+}
+
+void HardwareGPIO_FIRMATA::processSysex() {
+    if (sysex_len == 0) return;
+    const uint8_t* msg = sysex + 1;
+    int len = sysex_len - 1;
+    switch (sysex[0]) {
+        case CAPABILITY_RESPONSE: {
+            // per pin: (mode, resolution) pairs terminated by 0x7F
+            std::lock_guard<std::mutex> lock(info_mutex);
+            int pin = 0;
+            uint32_t modes = 0;
+            for (int j = 0; j < len && pin < MAX_PINS; j++) {
+                if (msg[j] == 0x7F) {
+                    capabilities[pin++] = modes;
+                    modes = 0;
+                } else {
+                    if (msg[j] < 32) modes |= (1u << msg[j]);
+                    j++;  // skip resolution
+                }
+            }
+            has_capabilities = true;
+            break;
+        }
+        case ANALOG_MAPPING_RESPONSE: {
+            // per pin: analog channel or 0x7F
+            std::lock_guard<std::mutex> lock(info_mutex);
+            for (int pin = 0; pin < len && pin < MAX_PINS; pin++) {
+                analog_map[pin] = msg[pin] == 0x7F ? -1 : msg[pin];
+            }
+            has_analog_mapping = true;
+            break;
+        }
+        case EXTENDED_ANALOG: {
+            // pin followed by the value in 7 bit groups
+            if (len < 2 || msg[0] >= MAX_PINS) break;
+            // the values are stored by channel like the ANALOG_MESSAGE
+            int channel = analogChannel(msg[0]);
+            if (channel < 0) break;
+            uint32_t value = 0;
+            for (int j = len - 1; j >= 1; j--) value = (value << 7) | msg[j];
+            analog_values[channel].store(value, std::memory_order_relaxed);
+            break;
+        }
+        case REPORT_FIRMWARE: {
+            // major, minor and the name as 7 bit pairs
+            std::lock_guard<std::mutex> lock(info_mutex);
+            firmware_name.clear();
+            for (int j = 2; j + 1 < len; j += 2) {
+                firmware_name += (char)(msg[j] | (msg[j + 1] << 7));
+            }
+            break;
+        }
+        case I2C_REPLY: {
+            // address, register and the data as 7 bit pairs
+            if (len < 4) break;
+            std::lock_guard<std::mutex> lock(info_mutex);
+            I2CReply reply;
+            reply.count = i2c_reply_count;
+            reply.address = msg[0] | (msg[1] << 7);
+            reply.reg = msg[2] | (msg[3] << 7);
+            for (int j = 4; j + 1 < len; j += 2) {
+                reply.data.push_back(msg[j] | (msg[j + 1] << 7));
+            }
+            // drop the oldest replies which were never requested
+            if (i2c_replies.size() >= MAX_I2C_REPLIES) i2c_replies.pop_front();
+            i2c_replies.push_back(std::move(reply));
+            i2c_reply_count++;
+            break;
+        }
+        case STRING_DATA: {
+            std::string str;
+            for (int j = 0; j + 1 < len; j += 2) {
+                str += (char)(msg[j] | (msg[j + 1] << 7));
+            }
+            Logger.info("Firmata", str.c_str());
+            break;
+        }
+        default:
+            break;
+    }
+}
+
+void HardwareGPIO_FIRMATA::send(const uint8_t* msg, size_t len) {
+    if (firmata_stream == nullptr) return;
+    std::lock_guard<std::mutex> lock(write_mutex);
+    firmata_stream->write(msg, len);
+}
+
+void HardwareGPIO_FIRMATA::reportDigital(uint8_t port) {
+    if (port >= MAX_PORTS || reported_ports[port].exchange(true)) return;
+    const uint8_t msg[] = {(uint8_t)(REPORT_DIGITAL | (port & 0x0F)), 1};
+    send(msg, sizeof(msg));
+}
+
+void HardwareGPIO_FIRMATA::setFirmataMode(pin_size_t pin, uint8_t mode) {
+    {
+        std::lock_guard<std::mutex> lock(write_mutex);
+        if (pin_modes[pin] == mode) return;
+        pin_modes[pin] = mode;
+    }
+    const uint8_t msg[] = {SET_PIN_MODE, (uint8_t)(pin & 0x7F), mode};
+    send(msg, sizeof(msg));
+}
+
+uint8_t HardwareGPIO_FIRMATA::firmataMode(PinMode mode) {
+    switch (mode) {
+        case OUTPUT:
+            return MODE_OUTPUT;
+        case INPUT_PULLUP:
+            return MODE_PULLUP;
+        default:
+            return MODE_INPUT;
+    }
+}
+
 } // namespace arduino
+
+#endif  // USE_FIRMATA
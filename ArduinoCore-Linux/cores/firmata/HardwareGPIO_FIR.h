@@ -1,6 +1,6 @@
 #pragma once
 /*
-  HardwareGPIO_FIR.h 
+  HardwareGPIO_FIR.h
   Copyright (c) 2025 Phil Schatzmann. All right reserved.
 
   This library is free software; you can redistribute it and/or
@@ -23,94 +23,109 @@
 #undef DEPRECATED
 #endif
 #include "HardwareGPIO.h"
-#include <map>
+#include "api/Stream.h"
+#include <string>
+#include <vector>
 #include <thread>
 #include <atomic>
 #include <mutex>
 #include <chrono>
+#include <deque>
 
 namespace arduino {
 
 /**
  * @class HardwareGPIO_FIRMATA
+ * @brief GPIO implementation for a device which is running Firmata.
+ *
+ * A background thread parses the messages from the device incrementally
+ * (digital and analog reports, version, sysex messages like the capability
+ * and analog mapping responses) and updates a snapshot of the pin states.
+ * digitalRead() and analogRead() just read this snapshot: the reporting of a
+ * port or analog channel is enabled with the first read.
+ *
+ * The output values are kept in port bitmaps. With setAutoFlush(false) the
+ * changed ports are only sent with flush(), so that repeated updates of a
+ * port are coalesced into a single message. Analog values for pins > 15 or
+ * values > 14 bits are sent with EXTENDED_ANALOG. Servos are supported via
+ * servoConfig() and the I2C messages are used by HardwareI2C_FIRMATA.
  */
 class HardwareGPIO_FIRMATA : public HardwareGPIO {
  public:
   /**
    * @brief Constructor for HardwareGPIO_FIRMATA.
    */
-  HardwareGPIO_FIRMA() = default;
+  HardwareGPIO_FIRMATA() = default;
 
   /**
-   * @brief Destructor for HardwareGPIO_FTDI.
+   * @brief Destructor for HardwareGPIO_FIRMATA.
    */
-  ~HardwareGPIO_FIRMA();
+  ~HardwareGPIO_FIRMATA();
 
   /**
-   * @brief Initialize the GPIO hardware interface for FTDI FT2232HL.
-   * @param vendor_id USB vendor ID (default: 0x0403)
-   * @param product_id USB product ID (default: 0x6010 for FT2232HL)
-   * @param description Device description string (optional)
-   * @param serial Device serial number (optional)
+   * @brief Start the communication with the Firmata device.
+   * @param stream Stream which is connected to the device (e.g. Serial)
+   * @param samplingIntervalMs Interval in ms in which the device reports
+   *        the analog values
    * @return true if initialization successful, false otherwise
    */
-  bool begin(Stream &stream);
+  bool begin(Stream &stream, int samplingIntervalMs = 19);
 
   /**
-   * @brief Close the FTDI connection and cleanup resources.
+   * @brief Stop the parser thread and cleanup resources.
    */
   void end();
 
   /**
    * @brief Set the mode of a GPIO pin (INPUT, OUTPUT, etc).
-   * @param pinNumber Pin number (0-15 for FT2232HL)
+   * @param pinNumber Pin number
    * @param pinMode Pin mode (INPUT, OUTPUT, INPUT_PULLUP)
    */
   void pinMode(pin_size_t pinNumber, PinMode pinMode) override;
 
   /**
    * @brief Write a digital value to a GPIO pin.
-   * @param pinNumber Pin number (0-15)
+   * @param pinNumber Pin number
    * @param status Pin status (HIGH or LOW)
    */
   void digitalWrite(pin_size_t pinNumber, PinStatus status) override;
 
   /**
    * @brief Read a digital value from a GPIO pin.
-   * @param pinNumber Pin number (0-15)
-   * @return Pin status (HIGH or LOW)
+   * @param pinNumber Pin number
+   * @return Pin status (HIGH or LOW) from the last report of the device
    */
   PinStatus digitalRead(pin_size_t pinNumber) override;
 
   /**
-   * @brief Read an analog value from a pin (not supported by FT2232HL).
-   * @param pinNumber Pin number
-   * @return Always returns 0 (no ADC on FT2232HL)
+   * @brief Read an analog value from a pin.
+   * @param pinNumber Pin number or analog channel
+   * @return Last value reported by the device
    */
   int analogRead(pin_size_t pinNumber) override;
 
   /**
-   * @brief Set the analog reference mode (not supported by FT2232HL).
+   * @brief Set the analog reference mode (not supported by Firmata).
    * @param mode Reference mode (ignored)
    */
   void analogReference(uint8_t mode) override;
 
   /**
-   * @brief Write an analog value (PWM) to a pin using software PWM.
-   * @param pinNumber Pin number (0-15)
-   * @param value PWM duty cycle (0-255, where 0=0% and 255=100%)
+   * @brief Write an analog value (PWM or servo angle) to a pin.
+   * @param pinNumber Pin number
+   * @param value PWM duty cycle or servo angle
    */
   void analogWrite(pin_size_t pinNumber, int value) override;
 
   /**
-   * @brief Set the PWM frequency for analogWrite() on a specific pin.
-   * @param pinNumber Pin number (0-15)
-   * @param frequency PWM frequency in Hz (default: 1000Hz)
+   * @brief Set the PWM frequency (not supported by Firmata).
+   * @param pinNumber Pin number
+   * @param frequency PWM frequency in Hz
    */
   void analogWriteFrequency(pin_size_t pinNumber, uint32_t frequency);
 
   /**
-   * @brief Generate a tone on a pin (not supported by FT2232HL).
+   * @brief Generate a tone on a pin (not supported by Firmata).
    * @param _pin Pin number
    * @param frequency Frequency in Hz (ignored)
    * @param duration Duration in ms (ignored)
@@ -119,13 +134,13 @@ class HardwareGPIO_FIRMATA : public HardwareGPIO {
             unsigned long duration = 0) override;
 
   /**
-   * @brief Stop tone generation on a pin (not supported by FT2232HL).
+   * @brief Stop tone generation on a pin (not supported by Firmata).
    * @param _pin Pin number (ignored)
    */
   void noTone(uint8_t _pin) override;
 
   /**
-   * @brief Measure pulse duration on a pin 
+   * @brief Measure pulse duration on a pin
    * @param pin Pin number
    * @param state Pin state to measure
    * @param timeout Timeout in microseconds
@@ -146,23 +161,192 @@ class HardwareGPIO_FIRMATA : public HardwareGPIO {
 
   /**
    * @brief Set the resolution for analogWrite() operations.
-   * @param bits The resolution in bits (8-bit by default for FTDI)
-   * @note FT2232HL supports 8-bit PWM resolution (0-255)
+   * @param bits The resolution in bits
    */
   void analogWriteResolution(uint8_t bits) override;
 
   /**
-   * @brief Boolean conversion operator.
-   * @return true if the FTDI interface is open and initialized, false otherwise.
+   * @brief Define the interval in which the device reports analog values.
+   * @param ms Interval in milliseconds
+   */
+  void setSamplingInterval(int ms);
+
+  /**
+   * @brief Define if digitalWrite() sends the port immediately (default) or
+   * only with flush().
+   * @param active true to send each update immediately
+   */
+  void setAutoFlush(bool active) { is_auto_flush = active; }
+
+  /**
+   * @brief Send all ports which have been changed since the last flush with
+   * a single write.
+   */
+  void flush();
+
+  /**
+   * @brief Configure a pin as servo output: then analogWrite() defines the
+   * angle.
+   * @param pin Pin number
+   * @param minPulse Pulse width in us for 0 degrees
+   * @param maxPulse Pulse width in us for 180 degrees
+   */
+  void servoConfig(pin_size_t pin, int minPulse = 544, int maxPulse = 2400);
+
+  /**
+   * @brief Send a sysex message: the data must already be 7 bit encoded.
+   * @param command Sysex command
+   * @param data Data bytes
+   * @param len Number of data bytes
+   */
+  void sendSysex(uint8_t command, const uint8_t* data, size_t len);
+
+  /**
+   * @brief Number of I2C replies which have been received: used to detect a
+   * new reply.
+   */
+  uint32_t i2cReplyCount() { return i2c_reply_count; }
+
+  /**
+   * @brief Wait for an I2C reply of the indicated device and take it from
+   * the queue of received replies.
+   * @param address I2C address
+   * @param reg Requested register or -1 if none was requested
+   * @param lastCount Value of i2cReplyCount() before the request was sent:
+   * older replies are ignored
+   * @param data Receives the data of the reply
+   * @param timeoutMs Max time to wait in milliseconds
+   * @return true if the reply was received
+   */
+  bool waitForI2CReply(uint8_t address, int reg, uint32_t lastCount,
+                       std::vector<uint8_t>& data, int timeoutMs = 1000);
+
+  /**
+   * @brief Wait until the device has answered the capability and analog
+   * mapping queries which are sent in begin().
+   * @param timeoutMs Max time to wait in milliseconds
+   * @return true if both responses have been received
    */
-  operator bool() { return is_open && ftdi_context != nullptr; }
+  bool waitForCapabilities(int timeoutMs = 2000);
 
+  /**
+   * @brief Firmata pin modes which are supported by a pin.
+   * @param pin Pin number
+   * @return Bitmask of the supported Firmata modes (bit n = mode n)
+   */
+  uint32_t pinCapabilities(pin_size_t pin);
+
+  /**
+   * @brief Analog channel of a pin from the analog mapping response.
+   * @param pin Pin number
+   * @return Analog channel or -1 if the pin does not support analog input
+   */
+  int analogChannel(pin_size_t pin);
+
+  /**
+   * @brief Name of the firmware reported by the device.
+   */
+  std::string firmwareName();
+
+  /**
+   * @brief Boolean conversion operator.
+   * @return true if the Firmata device was started, false otherwise.
+   */
+  operator bool() { return is_open; }
 
  protected:
+  static constexpr int MAX_PINS = 128;
+  static constexpr int MAX_PORTS = MAX_PINS / 8;
+  static constexpr int MAX_ANALOG = 16;
+  static constexpr int MAX_SYSEX = 1024;
+  /// max number of I2C replies which are kept until they are requested
+  static constexpr int MAX_I2C_REPLIES = 16;
+
+  static constexpr uint8_t MODE_UNDEFINED = 0xFF;
+
+  Stream* firmata_stream = nullptr;
   bool is_open = false;
-  
+  bool is_auto_flush = true;
+  std::mutex write_mutex;
+  // output state: protected by write_mutex
+  uint8_t pin_modes[MAX_PINS];
+  uint8_t output_ports[MAX_PORTS] = {0};
+  uint16_t dirty_ports = 0;
+
+  // snapshot which is updated by the parser thread
+  std::atomic<uint16_t> digital_inputs[MAX_PORTS];
+  // indexed by the analog channel
+  std::atomic<uint16_t> analog_values[MAX_PINS];
+  std::atomic<bool> reported_ports[MAX_PORTS];
+  std::atomic<bool> reported_analog[MAX_ANALOG];
+  std::atomic<bool> has_capabilities{false};
+  std::atomic<bool> has_analog_mapping{false};
+  std::mutex info_mutex;
+  uint32_t capabilities[MAX_PINS] = {0};
+  int8_t analog_map[MAX_PINS];
+  std::string firmware_name;
+  std::atomic<uint32_t> i2c_reply_count{0};
+  /// received I2C reply: protected by info_mutex
+  struct I2CReply {
+    uint32_t count;
+    uint16_t address;
+    uint16_t reg;
+    std::vector<uint8_t> data;
+  };
+  std::deque<I2CReply> i2c_replies;
+
+  // parser state
+  std::thread parser_thread;
+  std::atomic<bool> parser_running{false};
+  uint8_t command = 0;
+  uint8_t data[2];
+  int data_len = 0;
+  int data_expected = 0;
+  bool in_sysex = false;
+  uint8_t sysex[MAX_SYSEX];
+  int sysex_len = 0;
+
+  /**
+   * @brief Thread which reads and parses the data from the device.
+   */
+  void parserThreadFunction();
+
+  /**
+   * @brief Process a single received byte.
+   */
+  void parse(uint8_t byte);
+
+  /**
+   * @brief Process a complete (non sysex) message.
+   */
+  void processMessage();
+
+  /**
+   * @brief Process a complete sysex message.
+   */
+  void processSysex();
+
+  /**
+   * @brief Write a message to the device.
+   */
+  void send(const uint8_t* msg, size_t len);
+
+  /**
+   * @brief Set the Firmata mode of a pin if it is not already active.
+   */
+  void setFirmataMode(pin_size_t pin, uint8_t mode);
+
+  /**
+   * @brief Enable the digital reporting of a port (only once).
+   */
+  void reportDigital(uint8_t port);
+
+  /**
+   * @brief Maps the Arduino pin mode to the Firmata pin mode.
+   */
+  uint8_t firmataMode(PinMode mode);
 };
 
 }  // namespace arduino
 
-#endif  // USE_FTDI
\ No newline at end of file
+#endif  // USE_FIRMATA
@@ -0,0 +1,182 @@
+/*
+  HardwareI2C_FIR.cpp
+  Copyright (c) 2025 Phil Schatzmann. All right reserved.
+
+  This library is free software; you can redistribute it and/or
+  modify it under the terms of the GNU Lesser General Public
+  License as published by the Free Software Foundation; either
+  version 2.1 of the License, or (at your option) any later version.
+
+  This library is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+  Lesser General Public License for more details.
+
+  You should have received a copy of the GNU Lesser General Public
+  License along with this library; if not, write to the Free Software
+  Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA 02110-1301 USA
+*/
+#ifdef USE_FIRMATA
+#include "HardwareI2C_FIR.h"
+#include "Arduino.h"
+
+namespace arduino {
+
+// Firmata I2C sysex commands
+constexpr uint8_t I2C_REQUEST = 0x76;
+constexpr uint8_t I2C_CONFIG = 0x78;
+
+// I2C_REQUEST mode bits
+constexpr uint8_t I2C_WRITE = 0x00;
+constexpr uint8_t I2C_READ_ONCE = 0x08;
+constexpr uint8_t I2C_RESTART = 0x40;
+
+void HardwareI2C_FIRMATA::begin() {
+    if (!firmata) {
+        Logger.error("Firmata", "I2C: device not started");
+        return;
+    }
+    // no delay between write and read
+    const uint8_t data[] = {0, 0};
+    firmata.sendSysex(I2C_CONFIG, data, sizeof(data));
+    is_open = true;
+}
+
+void HardwareI2C_FIRMATA::begin(uint8_t address) {
+    Logger.error("Firmata", "I2C slave mode not supported");
+}
+
+void HardwareI2C_FIRMATA::end() {
+    sendPending();
+    is_open = false;
+    is_pending = false;
+    tx_buffer.clear();
+    rx_buffer.clear();
+    rx_pos = 0;
+}
+
+void HardwareI2C_FIRMATA::setClock(uint32_t freq) {
+    sendPending();
+    Logger.warning("Firmata", "I2C setClock not supported");
+}
+
+void HardwareI2C_FIRMATA::beginTransmission(uint8_t address) {
+    // a pending register selection which is not followed by a read is sent
+    // now, so that the new transmission starts with an empty buffer
+    sendPending();
+    tx_buffer.clear();
+    is_pending = false;
+    tx_address = address;
+}
+
+size_t HardwareI2C_FIRMATA::write(uint8_t data) {
+    tx_buffer.push_back(data);
+    return 1;
+}
+
+size_t HardwareI2C_FIRMATA::write(const uint8_t* data, size_t len) {
+    tx_buffer.insert(tx_buffer.end(), data, data + len);
+    return len;
+}
+
+uint8_t HardwareI2C_FIRMATA::endTransmission(bool stopBit) {
+    if (!is_open) return 4;
+    if (!stopBit && tx_buffer.size() == 1) {
+        // register selection: sent together with the next read or by any
+        // other call (see sendPending())
+        is_pending = true;
+        return 0;
+    }
+    sendRequest(tx_address, I2C_WRITE, stopBit, tx_buffer.data(),
+                tx_buffer.size());
+    tx_buffer.clear();
+    is_pending = false;
+    return 0;
+}
+
+size_t HardwareI2C_FIRMATA::requestFrom(uint8_t address, size_t quantity,
+                                        bool stopBit) {
+    rx_buffer.clear();
+    rx_pos = 0;
+    if (!is_open || quantity == 0) return 0;
+    // the register and the quantity are sent as 14 bit values
+    std::vector<uint8_t> request;
+    request.push_back(address & 0x7F);
+    request.push_back(I2C_READ_ONCE | (stopBit ? 0 : I2C_RESTART));
+    int reg = -1;
+    if (is_pending && address == tx_address) {
+        reg = tx_buffer[0];
+        request.push_back(tx_buffer[0] & 0x7F);
+        request.push_back((tx_buffer[0] >> 7) & 0x7F);
+    } else {
+        sendPending();
+    }
+    is_pending = false;
+    tx_buffer.clear();
+    request.push_back(quantity & 0x7F);
+    request.push_back((quantity >> 7) & 0x7F);
+
+    uint32_t count = firmata.i2cReplyCount();
+    firmata.sendSysex(I2C_REQUEST, request.data(), request.size());
+
+    if (!firmata.waitForI2CReply(address, reg, count, rx_buffer, timeout_ms)) {
+        Logger.error("Firmata", "I2C reply timeout");
+        return 0;
+    }
+    if (rx_buffer.size() > quantity) rx_buffer.resize(quantity);
+    return rx_buffer.size();
+}
+
+int HardwareI2C_FIRMATA::available() {
+    sendPending();
+    return rx_buffer.size() - rx_pos;
+}
+
+int HardwareI2C_FIRMATA::peek() {
+    sendPending();
+    if (rx_pos >= rx_buffer.size()) return -1;
+    return rx_buffer[rx_pos];
+}
+
+int HardwareI2C_FIRMATA::read() {
+    sendPending();
+    if (rx_pos >= rx_buffer.size()) return -1;
+    return rx_buffer[rx_pos++];
+}
+
+void HardwareI2C_FIRMATA::flush() {
+    sendPending();
+    firmata.flush();
+}
+
+void HardwareI2C_FIRMATA::onReceive(void (*function)(int)) {
+    sendPending();
+    Logger.warning("Firmata", "I2C onReceive not supported");
+}
+
+void HardwareI2C_FIRMATA::onRequest(void (*function)(void)) {
+    sendPending();
+    Logger.warning("Firmata", "I2C onRequest not supported");
+}
+
+void HardwareI2C_FIRMATA::sendPending() {
+    if (is_pending) endTransmission(true);
+}
+
+void HardwareI2C_FIRMATA::sendRequest(uint8_t address, uint8_t mode,
+                                      bool stopBit, const uint8_t* data,
+                                      size_t len) {
+    std::vector<uint8_t> request;
+    request.reserve(2 + len * 2);
+    request.push_back(address & 0x7F);
+    request.push_back(mode | (stopBit ? 0 : I2C_RESTART));
+    for (size_t j = 0; j < len; j++) {
+        request.push_back(data[j] & 0x7F);
+        request.push_back((data[j] >> 7) & 0x7F);
+    }
+    firmata.sendSysex(I2C_REQUEST, request.data(), request.size());
+}
+
+}  // namespace arduino
+
+#endif  // USE_FIRMATA
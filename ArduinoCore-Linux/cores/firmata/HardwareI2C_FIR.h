@@ -0,0 +1,197 @@
+#pragma once
+/*
+  HardwareI2C_FIR.h
+  Copyright (c) 2025 Phil Schatzmann. All right reserved.
+
+  This library is free software; you can redistribute it and/or
+  modify it under the terms of the GNU Lesser General Public
+  License as published by the Free Software Foundation; either
+  version 2.1 of the License, or (at your option) any later version.
+
+  This library is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+  Lesser General Public License for more details.
+
+  You should have received a copy of the GNU Lesser General Public
+  License along with this library; if not, write to the Free Software
+  Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA 02110-1301 USA
+*/
+#ifdef USE_FIRMATA
+#include <inttypes.h>
+#include <vector>
+
+#include "HardwareGPIO_FIR.h"
+#include "api/Common.h"
+#include "api/HardwareI2C.h"
+
+namespace arduino {
+
+/**
+ * @class HardwareI2C_FIRMATA
+ * @brief I2C master which uses the I2C sysex messages of a Firmata device.
+ *
+ * The communication with the device is done by HardwareGPIO_FIRMATA, which
+ * must have been started before. A transmission is buffered and sent as a
+ * single I2C_REQUEST with endTransmission(). A register read, i.e.
+ * endTransmission(false) with a single byte followed by requestFrom() for the
+ * same address, is sent as one read request with register, so that it needs
+ * only one round trip. In all other cases the register selection is sent
+ * with the next call.
+ *
+ * @note This class is only available when USE_FIRMATA is defined.
+ * @note The device only supports the master mode.
+ */
+class HardwareI2C_FIRMATA : public HardwareI2C {
+ public:
+  /**
+   * @brief Constructor
+   * @param gpio Firmata device which is used for the communication
+   */
+  HardwareI2C_FIRMATA(HardwareGPIO_FIRMATA& gpio) : firmata(gpio) {}
+
+  /**
+   * @brief Sends a pending register selection.
+   */
+  ~HardwareI2C_FIRMATA() { sendPending(); }
+
+  /**
+   * @brief Enable I2C on the device (I2C_CONFIG).
+   */
+  void begin() override;
+
+  /**
+   * @brief Initialize I2C as slave (not supported by Firmata).
+   * @param address Slave address (ignored)
+   */
+  void begin(uint8_t address) override;
+
+  /**
+   * @brief Nothing to do: the device keeps I2C enabled.
+   */
+  void end() override;
+
+  /**
+   * @brief Set the I2C clock frequency (not supported by Firmata).
+   * @param freq Frequency in Hz (ignored)
+   */
+  void setClock(uint32_t freq) override;
+
+  /**
+   * @brief Begin transmission to an I2C slave device.
+   * @param address 7-bit slave address
+   */
+  void beginTransmission(uint8_t address) override;
+
+  /**
+   * @brief Write a single byte into the transmission buffer.
+   * @param data Byte to write
+   * @return Number of bytes written
+   */
+  size_t write(uint8_t data) override;
+
+  /**
+   * @brief Write multiple bytes into the transmission buffer.
+   * @param data Pointer to data buffer
+   * @param len Number of bytes to write
+   * @return Number of bytes written
+   */
+  size_t write(const uint8_t* data, size_t len) override;
+
+  /**
+   * @brief Send the buffered data to the slave device.
+   * @param stopBit false to keep a register selection pending for the next
+   * requestFrom()
+   * @return 0 on success, 4 if the device is not available
+   */
+  uint8_t endTransmission(bool stopBit) override;
+
+  /**
+   * @brief Send the buffered data to the slave device (with stop condition).
+   * @return 0 on success, 4 if the device is not available
+   */
+  uint8_t endTransmission(void) override { return endTransmission(true); }
+
+  /**
+   * @brief Request data from an I2C slave device and wait for the reply.
+   * @param address 7-bit slave address
+   * @param quantity Number of bytes to request
+   * @param stopBit Whether to send stop condition
+   * @return Number of bytes received
+   */
+  size_t requestFrom(uint8_t address, size_t quantity, bool stopBit) override;
+  size_t requestFrom(uint8_t address, size_t quantity) override {
+    return requestFrom(address, quantity, true);
+  }
+
+  /**
+   * @brief Get the number of received bytes which have not been read yet.
+   */
+  int available() override;
+
+  /**
+   * @brief Peek at the next received byte.
+   * @return Next byte, or -1 if no data available
+   */
+  int peek() override;
+
+  /**
+   * @brief Read a received byte.
+   * @return Received byte, or -1 if no data available
+   */
+  int read() override;
+
+  /**
+   * @brief Send the queued port updates of the Firmata device.
+   */
+  void flush() override;
+
+  /**
+   * @brief Not supported: Firmata operates in master mode only.
+   */
+  void onReceive(void (*function)(int)) override;
+
+  /**
+   * @brief Not supported: Firmata operates in master mode only.
+   */
+  void onRequest(void (*function)(void)) override;
+
+  /**
+   * @brief Define the max time to wait for a reply.
+   * @param ms Timeout in milliseconds
+   */
+  void setTimeout(int ms) { timeout_ms = ms; }
+
+  /**
+   * @brief Boolean conversion operator.
+   * @return true if I2C has been enabled on an open Firmata device
+   */
+  operator bool() { return is_open && firmata; }
+
+ protected:
+  HardwareGPIO_FIRMATA& firmata;
+  bool is_open = false;
+  int timeout_ms = 1000;
+  uint8_t tx_address = 0;
+  std::vector<uint8_t> tx_buffer;
+  // endTransmission(false) which is merged into the next requestFrom()
+  bool is_pending = false;
+  std::vector<uint8_t> rx_buffer;
+  size_t rx_pos = 0;
+
+  /**
+   * @brief Send the register selection of endTransmission(false) which was
+   * not followed by a requestFrom() for the same address.
+   */
+  void sendPending();
+
+  /**
+   * @brief Send an I2C_REQUEST: the data is 7 bit encoded.
+   */
+  void sendRequest(uint8_t address, uint8_t mode, bool stopBit,
+                   const uint8_t* data, size_t len);
+};
+
+}  // namespace arduino
+
+#endif  // USE_FIRMATA
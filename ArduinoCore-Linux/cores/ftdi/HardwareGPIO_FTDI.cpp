@@ -19,6 +19,8 @@
 #ifdef USE_FTDI
 #include "HardwareGPIO_FTDI.h"
 #include "Arduino.h"
+#include <algorithm>
+#include <numeric>
 
 namespace arduino {
 
@@ -29,80 +31,110 @@ HardwareGPIO_FTDI::~HardwareGPIO_FTDI() {
 bool HardwareGPIO_FTDI::begin(int vendor_id, int product_id, 
                               const char* description, const char* serial) {
   Logger.info("Initializing FTDI GPIO interface");
-  
-  // Initialize FTDI context
-  ftdi_context = ftdi_new();
+
+  // Each channel uses its own context, so that no interface switching is needed
+  ftdi_context = openChannel(0, vendor_id, product_id, description, serial);
   if (!ftdi_context) {
-    Logger.error("Failed to create FTDI context");
     return false;
   }
-
-  // Open device
-  int ret;
-  if (serial) {
-    ret = ftdi_usb_open_desc(ftdi_context, vendor_id, product_id, description, serial);
-  } else if (description) {
-    ret = ftdi_usb_open_desc(ftdi_context, vendor_id, product_id, description, nullptr);
-  } else {
-    ret = ftdi_usb_open(ftdi_context, vendor_id, product_id);
+  ftdi_context_b = openChannel(1, vendor_id, product_id, description, serial);
+  if (!ftdi_context_b) {
+    Logger.warning("FTDI channel B not available: pins 8-15 are not supported");
   }
 
-  if (ret < 0) {
-    Logger.error("Failed to open FTDI device: %s", ftdi_get_error_string(ftdi_context));
-    ftdi_free(ftdi_context);
-    ftdi_context = nullptr;
-    return false;
+  is_open = true;
+  Logger.info("FTDI GPIO interface initialized successfully");
+  return true;
+}
+
+struct ftdi_context* HardwareGPIO_FTDI::openChannel(int channel, int vendor_id, int product_id,
+                                                    const char* description, const char* serial) {
+  struct ftdi_context* ctx = ftdi_new();
+  if (!ctx) {
+    Logger.error("Failed to create FTDI context");
+    return nullptr;
   }
 
-  // Reset device
-  ret = ftdi_usb_reset(ftdi_context);
+  int ret = ftdi_set_interface(ctx, channel == 0 ? INTERFACE_A : INTERFACE_B);
   if (ret < 0) {
-    Logger.error("Failed to reset FTDI device: %s", ftdi_get_error_string(ftdi_context));
-    end();
-    return false;
+    Logger.error("Failed to set FTDI interface: %s", ftdi_get_error_string(ctx));
+    ftdi_free(ctx);
+    return nullptr;
   }
 
-  // Set bitbang mode for GPIO
-  // Enable all pins as outputs initially (will be changed by pinMode)
-  ret = ftdi_set_bitmode(ftdi_context, 0xFF, BITMODE_BITBANG);
+  // Open device
+  if (serial) {
+    ret = ftdi_usb_open_desc(ctx, vendor_id, product_id, description, serial);
+  } else if (description) {
+    ret = ftdi_usb_open_desc(ctx, vendor_id, product_id, description, nullptr);
+  } else {
+    ret = ftdi_usb_open(ctx, vendor_id, product_id);
+  }
   if (ret < 0) {
-    Logger.error("Failed to set bitbang mode: %s", ftdi_get_error_string(ftdi_context));
-    end();
-    return false;
+    Logger.error("Failed to open FTDI device: %s", ftdi_get_error_string(ctx));
+    ftdi_free(ctx);
+    return nullptr;
   }
 
-  // Set reasonable baud rate for GPIO operations
-  ret = ftdi_set_baudrate(ftdi_context, 9600);
+  // Reset device
+  ret = ftdi_usb_reset(ctx);
   if (ret < 0) {
-    Logger.error("Failed to set baud rate: %s", ftdi_get_error_string(ftdi_context));
-    end();
-    return false;
+    Logger.error("Failed to reset FTDI device: %s", ftdi_get_error_string(ctx));
+    ftdi_usb_close(ctx);
+    ftdi_free(ctx);
+    return nullptr;
   }
 
   // Set low latency timer for better PWM performance (default is 16ms, set to 1ms)
-  ret = ftdi_set_latency_timer(ftdi_context, 1);
+  ret = ftdi_set_latency_timer(ctx, 1);
   if (ret < 0) {
-    Logger.warning("Failed to set latency timer: %s", ftdi_get_error_string(ftdi_context));
+    Logger.warning("Failed to set latency timer: %s", ftdi_get_error_string(ctx));
   }
-  
+
   // Enable USB transfer chunking for better performance
-  ftdi_write_data_set_chunksize(ftdi_context, 256);
-  ftdi_read_data_set_chunksize(ftdi_context, 256);
+  ftdi_write_data_set_chunksize(ctx, 256);
+  ftdi_read_data_set_chunksize(ctx, 256);
 
-  is_open = true;
-  Logger.info("FTDI GPIO interface initialized successfully");
-  return true;
+  // MPSSE mode for GPIO: all pins are inputs until pinMode() is called
+  if (channel == 0) {
+    ftdi_context = ctx;
+  } else {
+    ftdi_context_b = ctx;
+  }
+  current_bitmode[channel] = BITMODE_UNDEFINED;
+  commands[channel].clear();
+  bool ok;
+  {
+    std::lock_guard<std::mutex> lock(ftdi_mutex);
+    ok = setBitmode(channel, 0, BITMODE_MPSSE);
+  }
+  if (!ok || !updateGPIOState(channel)) {
+    ftdi_usb_close(ctx);
+    ftdi_free(ctx);
+    if (channel == 0) {
+      ftdi_context = nullptr;
+    } else {
+      ftdi_context_b = nullptr;
+    }
+    return nullptr;
+  }
+  return ctx;
 }
 
 void HardwareGPIO_FTDI::end() {
-  // Stop PWM thread first
+  // Stop PWM threads first
+  stopWaveformThread();
   stopPWMThread();
-  
-  if (ftdi_context) {
-    ftdi_usb_close(ftdi_context);
-    ftdi_free(ftdi_context);
-    ftdi_context = nullptr;
+  if (is_open) flush();
+
+  for (struct ftdi_context** ctx : {&ftdi_context, &ftdi_context_b}) {
+    if (*ctx) {
+      ftdi_usb_close(*ctx);
+      ftdi_free(*ctx);
+      *ctx = nullptr;
+    }
   }
+  current_bitmode[0] = current_bitmode[1] = BITMODE_UNDEFINED;
   is_open = false;
   pin_modes.clear();
   pwm_pins.clear();
@@ -227,6 +259,24 @@ void HardwareGPIO_FTDI::analogWrite(pin_size_t pinNumber, int value) {
       pwm_pins[pinNumber].enabled = false;
     }
     digitalWrite(pinNumber, HIGH);
+  } else if (isWaveformPin(pinNumber)) {
+    // Enable PWM in the streamed waveform
+    uint32_t frequency = 1000;
+    {
+      std::lock_guard<std::mutex> lock(pwm_mutex);
+      auto it = pwm_pins.find(pinNumber);
+      if (it != pwm_pins.end() && it->second.frequency > 0) {
+        frequency = it->second.frequency;
+      }
+    }
+    updatePWMPin(pinNumber, value, frequency);
+    {
+      std::lock_guard<std::mutex> lock(pwm_mutex);
+      updateWaveform();
+    }
+    if (!waveform_thread_running) {
+      startWaveformThread();
+    }
   } else {
     // Enable PWM for this pin
     uint32_t frequency = 1000;  // Default 1 kHz PWM frequency
@@ -247,6 +297,16 @@ void HardwareGPIO_FTDI::analogWrite(pin_size_t pinNumber, int value) {
       startPWMThread();
     }
   }
+
+  // Stop streaming when the last PWM pin of the waveform was disabled
+  if ((value == 0 || value == 255) && waveform_thread_running) {
+    bool is_empty;
+    {
+      std::lock_guard<std::mutex> lock(pwm_mutex);
+      is_empty = waveform.empty();
+    }
+    if (is_empty) stopWaveformThread();
+  }
 }
 
 void HardwareGPIO_FTDI::analogWriteFrequency(pin_size_t pinNumber, uint32_t frequency) {
@@ -280,6 +340,7 @@ void HardwareGPIO_FTDI::analogWriteFrequency(pin_size_t pinNumber, uint32_t freq
     if (was_enabled) {
       pwm.on_time_us = (pwm.period_us * current_duty) / 255;
       pwm.period_start = std::chrono::high_resolution_clock::now();
+      if (isWaveformPin(pinNumber)) updateWaveform();
       Logger.debug("Updated PWM frequency for active pin");
     }
   }
@@ -304,82 +365,115 @@ unsigned long HardwareGPIO_FTDI::pulseInLong(uint8_t pin, uint8_t state, unsigne
 }
 
 bool HardwareGPIO_FTDI::updateGPIOState(int channel) {
-  if (!is_open) {
+  if (!getContext(channel)) {
     return false;
   }
 
-  int ret;
-  if (channel == 0) {
-    // Update Channel A
-    ret = ftdi_set_bitmode(ftdi_context, pin_directions_a, BITMODE_BITBANG);
-    if (ret < 0) {
-      Logger.error("Failed to set Channel A direction: %s", ftdi_get_error_string(ftdi_context));
-      return false;
-    }
-    
-    // Write the output values
-    ret = ftdi_write_data(ftdi_context, &pin_values_a, 1);
-    if (ret < 0) {
-      Logger.error("Failed to write Channel A values: %s", ftdi_get_error_string(ftdi_context));
-      return false;
-    }
-  } else {
-    // For Channel B, we need to select it first
-    ret = ftdi_set_interface(ftdi_context, INTERFACE_B);
-    if (ret < 0) {
-      Logger.error("Failed to select Channel B: %s", ftdi_get_error_string(ftdi_context));
-      return false;
-    }
-    
-    ret = ftdi_set_bitmode(ftdi_context, pin_directions_b, BITMODE_BITBANG);
-    if (ret < 0) {
-      Logger.error("Failed to set Channel B direction: %s", ftdi_get_error_string(ftdi_context));
-      return false;
-    }
-    
-    ret = ftdi_write_data(ftdi_context, &pin_values_b, 1);
-    if (ret < 0) {
-      Logger.error("Failed to write Channel B values: %s", ftdi_get_error_string(ftdi_context));
-      return false;
-    }
-    
-    // Switch back to Channel A
-    ftdi_set_interface(ftdi_context, INTERFACE_A);
+  if (channel == 0 && waveform_thread_running) {
+    // The outputs of channel A are combined with the next streamed chunk
+    std::lock_guard<std::mutex> lock(pwm_mutex);
+    waveform_outputs = pin_values_a;
+    waveform_directions = pin_directions_a;
+    return true;
   }
-  
-  return true;
+
+  // Values and directions are set with a single MPSSE command
+  std::lock_guard<std::mutex> lock(ftdi_mutex);
+  std::vector<uint8_t>& cmd = commands[channel];
+  cmd.push_back(SET_BITS_LOW);
+  cmd.push_back(channel == 0 ? pin_values_a : pin_values_b);
+  cmd.push_back(channel == 0 ? pin_directions_a : pin_directions_b);
+  if (!is_auto_flush) {
+    return true;
+  }
+  return flushChannel(channel);
 }
 
 bool HardwareGPIO_FTDI::readGPIOState(int channel, uint8_t& value) {
-  if (!is_open) {
+  struct ftdi_context* ctx = getContext(channel);
+  if (!ctx) {
+    return false;
+  }
+
+  if (channel == 0 && waveform_thread_running) {
+    // Sampled by the synchronous bitbang mode
+    value = waveform_input;
+    return true;
+  }
+
+  // Pending updates are sent together with the read command
+  std::lock_guard<std::mutex> lock(ftdi_mutex);
+  std::vector<uint8_t>& cmd = commands[channel];
+  cmd.push_back(GET_BITS_LOW);
+  cmd.push_back(SEND_IMMEDIATE);
+  if (!flushChannel(channel)) {
     return false;
   }
 
-  int ret;
-  if (channel == 1) {
-    // Select Channel B
-    ret = ftdi_set_interface(ftdi_context, INTERFACE_B);
+  // Wait for the result
+  for (int retry = 0; retry < 1000; retry++) {
+    int ret = ftdi_read_data(ctx, &value, 1);
     if (ret < 0) {
-      Logger.error("Failed to select Channel B: %s", ftdi_get_error_string(ftdi_context));
+      Logger.error("Failed to read pin states: %s", ftdi_get_error_string(ctx));
       return false;
     }
+    if (ret == 1) {
+      return true;
+    }
+    std::this_thread::sleep_for(std::chrono::microseconds(10));
   }
-  
-  // Read the pin states
-  ret = ftdi_read_pins(ftdi_context, &value);
+  Logger.error("Timeout reading pin states");
+  return false;
+}
+
+void HardwareGPIO_FTDI::setAutoFlush(bool active) {
+  is_auto_flush = active;
+  if (active) flush();
+}
+
+void HardwareGPIO_FTDI::flush() {
+  std::lock_guard<std::mutex> lock(ftdi_mutex);
+  flushChannel(0);
+  flushChannel(1);
+}
+
+bool HardwareGPIO_FTDI::flushChannel(int channel) {
+  std::vector<uint8_t>& cmd = commands[channel];
+  struct ftdi_context* ctx = getContext(channel);
+  if (cmd.empty() || !ctx) {
+    cmd.clear();
+    return true;
+  }
+  if (!setBitmode(channel, 0, BITMODE_MPSSE)) {
+    return false;
+  }
+  int ret = ftdi_write_data(ctx, cmd.data(), cmd.size());
+  cmd.clear();
   if (ret < 0) {
-    Logger.error("Failed to read pin states: %s", ftdi_get_error_string(ftdi_context));
-    if (channel == 1) {
-      ftdi_set_interface(ftdi_context, INTERFACE_A); // Switch back
-    }
+    Logger.error("Failed to write GPIO values: %s", ftdi_get_error_string(ctx));
     return false;
   }
-  
-  if (channel == 1) {
-    // Switch back to Channel A
-    ftdi_set_interface(ftdi_context, INTERFACE_A);
+  return true;
+}
+
+bool HardwareGPIO_FTDI::setBitmode(int channel, uint8_t mask, uint8_t mode) {
+  if (current_bitmode[channel] == mode && current_bitmask[channel] == mask) {
+    return true;
   }
-  
+  struct ftdi_context* ctx = getContext(channel);
+  // A reset is needed when switching between the modes
+  if (current_bitmode[channel] != mode) {
+    ftdi_set_bitmode(ctx, 0, BITMODE_RESET);
+    ftdi_usb_purge_rx_buffer(ctx);
+  }
+  int ret = ftdi_set_bitmode(ctx, mask, mode);
+  if (ret < 0) {
+    Logger.error("Failed to set bitmode: %s", ftdi_get_error_string(ctx));
+    current_bitmode[channel] = BITMODE_UNDEFINED;
+    return false;
+  }
+  current_bitmode[channel] = mode;
+  current_bitmask[channel] = mask;
   return true;
 }
 
@@ -399,7 +493,7 @@ void HardwareGPIO_FTDI::pwmThreadFunction() {
         pin_size_t pin = pair.first;
         PWMPin& pwm = pair.second;
         
-        if (!pwm.enabled) continue;
+        if (!pwm.enabled || isWaveformPin(pin)) continue;
         
         auto elapsed = std::chrono::duration_cast<std::chrono::microseconds>(
           current_time - pwm.period_start).count();
@@ -472,7 +566,7 @@ void HardwareGPIO_FTDI::pwmThreadFunction() {
     {
       std::lock_guard<std::mutex> lock(pwm_mutex);
       for (const auto& pair : pwm_pins) {
-        if (pair.second.enabled) {
+        if (pair.second.enabled && !isWaveformPin(pair.first)) {
           auto period = std::chrono::microseconds(pair.second.period_us);
           min_period = std::min(min_period, period);
         }
@@ -547,11 +641,229 @@ void HardwareGPIO_FTDI::updatePWMPin(pin_size_t pin, uint8_t duty_cycle, uint32_
   Logger.debug("PWM pin configured");
 }
 
+void HardwareGPIO_FTDI::updateWaveform() {
+  uint32_t max_frequency = 0;
+  uint32_t min_frequency = MAX_TICK_RATE;
+  uint8_t pwm_mask = 0;
+  for (auto& pair : pwm_pins) {
+    if (!pair.second.enabled || !isWaveformPin(pair.first)) continue;
+    max_frequency = std::max(max_frequency, pair.second.frequency);
+    min_frequency = std::min(min_frequency, pair.second.frequency);
+    pwm_mask |= (1 << getBitPosition(pair.first));
+  }
+  is_waveform_changed = true;
+  waveform_mask = pwm_mask;
+  waveform_outputs = pin_values_a;
+  waveform_directions = pin_directions_a;
+  if (max_frequency == 0) {
+    waveform.clear();
+    return;
+  }
+
+  // The fastest pin defines the resolution, the period of the slowest pin
+  // must fit into the buffer
+  uint64_t tick_rate = (uint64_t)max_frequency * TICKS_PER_PERIOD;
+  tick_rate = std::min<uint64_t>(tick_rate, MAX_TICK_RATE);
+  tick_rate = std::min<uint64_t>(tick_rate, (uint64_t)min_frequency * MAX_WAVEFORM_SIZE);
+
+  // The super-period is the least common multiple of all periods
+  size_t len = 1;
+  size_t max_period = 1;
+  for (auto& pair : pwm_pins) {
+    PWMPin& pwm = pair.second;
+    if (!pwm.enabled || !isWaveformPin(pair.first)) continue;
+    pwm.period_ticks = std::max<uint32_t>(1, tick_rate / pwm.frequency);
+    pwm.on_ticks = ((uint64_t)pwm.period_ticks * pwm.duty_cycle) / 255;
+    max_period = std::max<size_t>(max_period, pwm.period_ticks);
+    len = std::min<size_t>(std::lcm<size_t>(len, pwm.period_ticks),
+                           MAX_WAVEFORM_SIZE + 1);
+  }
+  if (len > MAX_WAVEFORM_SIZE) {
+    // No common period: the slower pins get a phase step at the wrap around
+    len = max_period * (MAX_WAVEFORM_SIZE / max_period);
+  }
+  // Provide enough data for an efficient USB transfer
+  if (len < MIN_WAVEFORM_SIZE) {
+    len *= (MIN_WAVEFORM_SIZE + len - 1) / len;
+  }
+
+  waveform.assign(len, 0);
+  for (auto& pair : pwm_pins) {
+    PWMPin& pwm = pair.second;
+    if (!pwm.enabled || !isWaveformPin(pair.first)) continue;
+    uint8_t bit = 1 << getBitPosition(pair.first);
+    for (size_t start = 0; start < len; start += pwm.period_ticks) {
+      size_t end = std::min<size_t>(start + pwm.on_ticks, len);
+      for (size_t j = start; j < end; j++) waveform[j] |= bit;
+    }
+  }
+  waveform_tick_rate = tick_rate;
+}
+
+void HardwareGPIO_FTDI::waveformThreadFunction() {
+  std::vector<uint8_t> buffer;
+  std::vector<uint8_t> chunk(WAVEFORM_CHUNK_SIZE);
+  std::vector<uint8_t> samples(WAVEFORM_CHUNK_SIZE * WAVEFORM_CHUNKS_IN_FLIGHT);
+  uint32_t tick_rate = 0;
+  size_t in_flight = 0;  // Written bytes whose samples were not read yet
+
+  while (waveform_thread_running) {
+    uint32_t new_tick_rate;
+    {
+      std::lock_guard<std::mutex> lock(pwm_mutex);
+      if (is_waveform_changed) {
+        buffer = waveform;
+        is_waveform_changed = false;
+      }
+      new_tick_rate = waveform_tick_rate;
+    }
+    if (buffer.empty()) {
+      std::this_thread::sleep_for(std::chrono::milliseconds(1));
+      continue;
+    }
+
+    // The chip stalls when its read buffer is full: so we keep max one FIFO
+    // of samples in flight and read back the oldest chunk while the next one
+    // is clocked out. The context is only locked per chunk, so that channel B
+    // is not blocked for the whole waveform.
+    for (size_t offset = 0; offset < buffer.size() && waveform_thread_running;
+         offset += WAVEFORM_CHUNK_SIZE) {
+      uint8_t outputs, directions;
+      {
+        std::lock_guard<std::mutex> lock(pwm_mutex);
+        outputs = waveform_outputs & ~waveform_mask;
+        directions = waveform_directions;
+      }
+      std::lock_guard<std::mutex> lock(ftdi_mutex);
+      // An other user might have switched the mode since the last chunk: the
+      // samples in flight were purged
+      if (current_bitmode[0] != BITMODE_SYNCBB) {
+        tick_rate = 0;
+        in_flight = 0;
+      }
+      // A new mode or tick rate must not affect the chunks in flight
+      if (in_flight > 0 &&
+          (tick_rate != new_tick_rate || current_bitmask[0] != directions)) {
+        if (!readWaveformSamples(in_flight, samples.data(), tick_rate)) {
+          waveform_thread_running = false;
+          break;
+        }
+        in_flight = 0;
+      }
+      if (!setBitmode(0, directions, BITMODE_SYNCBB)) {
+        waveform_thread_running = false;
+        break;
+      }
+      if (tick_rate != new_tick_rate) {
+        // In bitbang mode the baud rate defines the tick
+        if (ftdi_set_baudrate(ftdi_context, new_tick_rate) < 0) {
+          Logger.error("Failed to set PWM tick rate: %s", ftdi_get_error_string(ftdi_context));
+          waveform_thread_running = false;
+          break;
+        }
+        tick_rate = new_tick_rate;
+      }
+
+      // The digital outputs are combined with the PWM bits
+      size_t len = std::min(WAVEFORM_CHUNK_SIZE, buffer.size() - offset);
+      for (size_t j = 0; j < len; j++) chunk[j] = buffer[offset + j] | outputs;
+      if (!writeWaveformChunk(chunk.data(), len)) {
+        waveform_thread_running = false;
+        break;
+      }
+      in_flight += len;
+
+      // Read the samples of the oldest chunks, so that the next write fits
+      size_t max_in_flight = WAVEFORM_CHUNK_SIZE * (WAVEFORM_CHUNKS_IN_FLIGHT - 1);
+      if (in_flight > max_in_flight) {
+        if (!readWaveformSamples(in_flight - max_in_flight, samples.data(), tick_rate)) {
+          waveform_thread_running = false;
+          break;
+        }
+        in_flight = max_in_flight;
+      }
+    }
+  }
+  waveform_thread_running = false;
+}
+
+bool HardwareGPIO_FTDI::writeWaveformChunk(const uint8_t* data, size_t len) {
+  int ret = ftdi_write_data(ftdi_context, data, len);
+  if (ret < 0) {
+    Logger.error("Failed to write PWM waveform: %s", ftdi_get_error_string(ftdi_context));
+    return false;
+  }
+  waveform_ticks += ret;
+  return true;
+}
+
+bool HardwareGPIO_FTDI::readWaveformSamples(size_t len, uint8_t* samples,
+                                            uint32_t tick_rate) {
+  // Synchronous bitbang returns one pin sample for each written byte: we
+  // wait max for the duration of the samples in flight plus the USB latency
+  size_t pending = len;
+  auto timeout = std::chrono::steady_clock::now() +
+                 std::chrono::microseconds(1000000ULL * WAVEFORM_CHUNK_SIZE *
+                                           WAVEFORM_CHUNKS_IN_FLIGHT / tick_rate) +
+                 std::chrono::milliseconds(WAVEFORM_READ_TIMEOUT_MS);
+  while (pending > 0) {
+    int n = ftdi_read_data(ftdi_context, samples, pending);
+    if (n < 0) {
+      Logger.error("Failed to read PWM samples: %s", ftdi_get_error_string(ftdi_context));
+      return false;
+    }
+    if (n == 0) {
+      if (std::chrono::steady_clock::now() > timeout) {
+        Logger.error("Timeout reading PWM samples");
+        return false;
+      }
+      continue;
+    }
+    pending -= n;
+    waveform_input = samples[n - 1];
+  }
+  return true;
+}
+
+void HardwareGPIO_FTDI::startWaveformThread() {
+  if (waveform_thread_running) return;
+  // Cleanup after a stop caused by an error
+  if (waveform_thread.joinable()) waveform_thread.join();
+
+  waveform_ticks = 0;
+  waveform_input = pin_values_a;
+  waveform_thread_running = true;
+  waveform_thread = std::thread(&HardwareGPIO_FTDI::waveformThreadFunction, this);
+  Logger.info("PWM waveform streaming started");
+}
+
+void HardwareGPIO_FTDI::stopWaveformThread() {
+  if (!waveform_thread.joinable()) return;
+
+  waveform_thread_running = false;
+  waveform_thread.join();
+  {
+    std::lock_guard<std::mutex> lock(pwm_mutex);
+    waveform.clear();
+    is_waveform_changed = false;
+  }
+
+  // Back to MPSSE for digitalWrite()
+  updateGPIOState(0);
+  Logger.info("PWM waveform streaming stopped");
+}
+
 void HardwareGPIO_FTDI::getPWMStatistics(pin_size_t pin, uint64_t& cycles, 
                                          uint64_t& max_jitter_us, uint64_t& avg_jitter_us) {
   std::lock_guard<std::mutex> lock(pwm_mutex);
   auto it = pwm_pins.find(pin);
-  if (it != pwm_pins.end() && it->second.enabled) {
+  if (it != pwm_pins.end() && it->second.enabled && isWaveformPin(pin) &&
+      it->second.period_ticks > 0) {
+    // The timing is defined by the FTDI chip
+    cycles = waveform_ticks / it->second.period_ticks;
+    max_jitter_us = 0;
+    avg_jitter_us = 0;
+  } else if (it != pwm_pins.end() && it->second.enabled) {
     cycles = it->second.cycle_count;
     max_jitter_us = it->second.max_jitter_us;
     avg_jitter_us = (cycles > 0) ? it->second.total_jitter_us / cycles : 0;
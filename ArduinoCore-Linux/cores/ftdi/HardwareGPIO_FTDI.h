@@ -25,6 +25,7 @@
 #endif
 #include "HardwareGPIO.h"
 #include <map>
+#include <vector>
 #include <thread>
 #include <atomic>
 #include <mutex>
@@ -47,11 +48,25 @@ namespace arduino {
  * The class inherits from HardwareGPIO and is intended for use within the emulator when 
  * communicating with FTDI FT2232HL devices. It manages pin state and direction for supported pins.
  *
+ * Each channel is opened with its own context in MPSSE mode: the outputs and directions are
+ * updated with a single SET_BITS_LOW command, so the bitmode is only set when the mode
+ * changes. With setAutoFlush(false) the commands are collected and sent with flush().
+ *
+ * PWM on channel A is generated by the chip in the default PWM_WAVEFORM mode: one
+ * super-period of all PWM pins is precomputed with one byte per tick and streamed
+ * continuously in synchronous bitbang mode, where the tick is defined by the baud rate.
+ * The waveform is only regenerated when a duty cycle or frequency changes: the outputs
+ * of the other pins are combined with each chunk while it is streamed.
+ * Channel B and the PWM_SOFTWARE mode use a thread which toggles the pins.
+ *
  * @note This class is only available when USE_FTDI is defined.
  * @note Requires libftdi1 development library to be installed.
  */
 class HardwareGPIO_FTDI : public HardwareGPIO {
  public:
+  /// Implementation of analogWrite()
+  enum PWMMode { PWM_WAVEFORM, PWM_SOFTWARE };
+
   /**
    * @brief Constructor for HardwareGPIO_FTDI.
    */
@@ -174,6 +189,24 @@ class HardwareGPIO_FTDI : public HardwareGPIO {
    */
   operator bool() { return is_open && ftdi_context != nullptr; }
 
+  /**
+   * @brief Define if digitalWrite() and pinMode() are sent immediately (default)
+   * or collected until flush().
+   * @param active true to send each update immediately
+   */
+  void setAutoFlush(bool active);
+
+  /**
+   * @brief Send all collected pin updates with one USB write per channel.
+   */
+  void flush();
+
+  /**
+   * @brief Define how PWM is generated: must be called before analogWrite().
+   * @param mode PWM_WAVEFORM (default) or PWM_SOFTWARE
+   */
+  void setPWMMode(PWMMode mode) { pwm_mode = mode; }
+
   /**
    * @brief Get PWM statistics for monitoring timing accuracy.
    * @param pin Pin number
@@ -185,8 +218,22 @@ class HardwareGPIO_FTDI : public HardwareGPIO {
                        uint64_t& max_jitter_us, uint64_t& avg_jitter_us);
 
  protected:
-  struct ftdi_context* ftdi_context = nullptr;
+  struct ftdi_context* ftdi_context = nullptr;    // Channel A
+  struct ftdi_context* ftdi_context_b = nullptr;  // Channel B
   bool is_open = false;
+  bool is_auto_flush = true;
+
+  // Current bitmode per channel: only changed when needed
+  static constexpr uint8_t BITMODE_UNDEFINED = 0xFF;
+  uint8_t current_bitmode[2] = {BITMODE_UNDEFINED, BITMODE_UNDEFINED};
+  uint8_t current_bitmask[2] = {0, 0};
+
+  // MPSSE commands
+  static constexpr uint8_t SET_BITS_LOW = 0x80;
+  static constexpr uint8_t GET_BITS_LOW = 0x81;
+  static constexpr uint8_t SEND_IMMEDIATE = 0x87;
+  // Collected commands per channel which are sent by flush()
+  std::vector<uint8_t> commands[2];
   
   // Pin state tracking
   uint8_t pin_directions_a = 0x00;  // Channel A direction mask (1=output, 0=input)
@@ -210,12 +257,67 @@ class HardwareGPIO_FTDI : public HardwareGPIO {
     // Statistics for monitoring
     uint64_t max_jitter_us = 0;
     uint64_t total_jitter_us = 0;
+    // Waveform timing in ticks
+    uint32_t period_ticks = 0;
+    uint32_t on_ticks = 0;
   };
   
   std::map<pin_size_t, PWMPin> pwm_pins;
   std::thread pwm_thread;
   std::atomic<bool> pwm_thread_running{false};
   std::mutex pwm_mutex;
+  PWMMode pwm_mode = PWM_WAVEFORM;
+
+  // Waveform streaming (channel A): protected by pwm_mutex
+  static constexpr uint32_t MAX_TICK_RATE = 1000000;     // Ticks per second
+  static constexpr uint32_t TICKS_PER_PERIOD = 256;      // Of the fastest pin
+  static constexpr size_t MIN_WAVEFORM_SIZE = 4096;      // Bytes per USB write
+  static constexpr size_t MAX_WAVEFORM_SIZE = 64 * 1024;
+  static constexpr size_t WAVEFORM_CHUNK_SIZE = 2048;
+  static constexpr size_t WAVEFORM_CHUNKS_IN_FLIGHT = 2;  // 4 KB RX FIFO of the FT2232H
+  static constexpr int WAVEFORM_READ_TIMEOUT_MS = 100;
+  std::vector<uint8_t> waveform;  // PWM bits only
+  uint8_t waveform_mask = 0;      // PWM bits of the waveform
+  uint8_t waveform_outputs = 0;   // Values and directions of channel A
+  uint8_t waveform_directions = 0;
+  uint32_t waveform_tick_rate = 0;
+  bool is_waveform_changed = false;
+  std::thread waveform_thread;
+  std::atomic<bool> waveform_thread_running{false};
+  std::atomic<uint64_t> waveform_ticks{0};
+  std::atomic<uint8_t> waveform_input{0};  // Last pin sample of channel A
+  std::mutex ftdi_mutex;  // Serializes the access to ftdi_context
+
+  /**
+   * @brief Context of a channel.
+   * @param channel Channel (0 for A, 1 for B)
+   */
+  struct ftdi_context* getContext(int channel) {
+    return channel == 0 ? ftdi_context : ftdi_context_b;
+  }
+
+  /**
+   * @brief Open a channel of the device.
+   * @return Context or nullptr on error
+   */
+  struct ftdi_context* openChannel(int channel, int vendor_id, int product_id,
+                                   const char* description, const char* serial);
+
+  /**
+   * @brief Set the bitmode of a channel if it has changed: ftdi_mutex must be locked.
+   * @param channel Channel (0 for A, 1 for B)
+   * @param mask Direction mask (ignored in MPSSE mode)
+   * @param mode Bitmode
+   * @return true if successful, false on error
+   */
+  bool setBitmode(int channel, uint8_t mask, uint8_t mode);
+
+  /**
+   * @brief Write the collected commands of a channel: ftdi_mutex must be locked.
+   * @param channel Channel (0 for A, 1 for B)
+   * @return true if successful, false on error
+   */
+  bool flushChannel(int channel);
 
   /**
    * @brief Update the GPIO state on the FTDI device.
@@ -261,6 +363,48 @@ class HardwareGPIO_FTDI : public HardwareGPIO {
    */
   void stopPWMThread();
   
+  /**
+   * @brief true if the PWM of the pin is generated by the waveform.
+   */
+  bool isWaveformPin(pin_size_t pin) {
+    return pwm_mode == PWM_WAVEFORM && getChannel(pin) == 0;
+  }
+
+  /**
+   * @brief Recalculate the waveform of channel A: pwm_mutex must be locked.
+   */
+  void updateWaveform();
+
+  /**
+   * @brief Thread which streams the waveform in synchronous bitbang mode.
+   */
+  void waveformThreadFunction();
+
+  /**
+   * @brief Write a part of the waveform: ftdi_mutex must be locked.
+   * @param len Number of bytes (max WAVEFORM_CHUNK_SIZE)
+   * @return false on error
+   */
+  bool writeWaveformChunk(const uint8_t* data, size_t len);
+
+  /**
+   * @brief Read back the pin samples of the written waveform: ftdi_mutex
+   * must be locked.
+   * @param len Number of samples
+   * @return false on error or timeout
+   */
+  bool readWaveformSamples(size_t len, uint8_t* samples, uint32_t tick_rate);
+
+  /**
+   * @brief Start streaming the waveform.
+   */
+  void startWaveformThread();
+
+  /**
+   * @brief Stop streaming and restore the asynchronous bitbang mode.
+   */
+  void stopWaveformThread();
+
   /**
    * @brief Update PWM pin configuration.
    * @param pin Pin number
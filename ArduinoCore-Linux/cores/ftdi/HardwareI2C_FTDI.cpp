@@ -20,6 +20,7 @@
 #include "HardwareI2C_FTDI.h"
 #include "Arduino.h"
 #include <chrono>
+#include <cstring>
 #include <thread>
 
 // Helper function for microsecond delays
@@ -143,36 +144,34 @@ uint8_t HardwareI2C_FTDI::endTransmission(bool stopBit) {
     return 4; // Other error
   }
 
-  // Send start condition
-  if (!sendStart()) {
-    Logger.error("Failed to send I2C start condition");
+  // Build the whole transaction: one ACK bit per byte is returned
+  command_buffer.clear();
+  addStart();
+  addWriteByte((current_slave_address << 1) | 0);
+  for (size_t i = 0; i < tx_buffer_length; i++) {
+    addWriteByte(tx_buffer[i]);
+  }
+  if (stopBit) {
+    addStop();
+  }
+
+  uint8_t acks[sizeof(tx_buffer) + 1];
+  if (!execute(acks, tx_buffer_length + 1)) {
+    Logger.error("Failed to execute I2C transaction");
     return 4;
   }
 
-  // Send slave address with write bit
-  if (!sendByteCheckAck((current_slave_address << 1) | 0)) {
+  if (acks[0] & 0x01) {
     Logger.error("I2C slave address NACK");
-    if (stopBit) sendStop();
     return 2; // Address NACK
   }
-
-  // Send data bytes
   for (size_t i = 0; i < tx_buffer_length; i++) {
-    if (!sendByteCheckAck(tx_buffer[i])) {
+    if (acks[i + 1] & 0x01) {
       Logger.error("I2C data NACK");
-      if (stopBit) sendStop();
       return 3; // Data NACK
     }
   }
 
-  // Send stop condition if requested
-  if (stopBit) {
-    if (!sendStop()) {
-      Logger.error("Failed to send I2C stop condition");
-      return 4;
-    }
-  }
-
   tx_buffer_length = 0;
   return 0; // Success
 }
@@ -186,36 +185,36 @@ size_t HardwareI2C_FTDI::requestFrom(uint8_t address, size_t quantity, bool stop
   if (quantity > sizeof(rx_buffer)) {
     quantity = sizeof(rx_buffer);
   }
-
-  // Send start condition
-  if (!sendStart()) {
-    Logger.error("Failed to send I2C start condition");
+  rx_buffer_length = 0;
+  rx_buffer_index = 0;
+  if (quantity == 0) {
     return 0;
   }
 
-  // Send slave address with read bit
-  if (!sendByteCheckAck((address << 1) | 1)) {
-    Logger.error("I2C slave address NACK on read");
-    if (stopBit) sendStop();
-    return 0;
+  // Build the whole transaction: the address ACK followed by the data
+  command_buffer.clear();
+  addStart();
+  addWriteByte((address << 1) | 1);
+  for (size_t i = 0; i < quantity; i++) {
+    addReadByte(i < quantity - 1); // ACK all but last byte
+  }
+  if (stopBit) {
+    addStop();
   }
 
-  // Read data bytes
-  rx_buffer_length = 0;
-  rx_buffer_index = 0;
-  
-  for (uint8_t i = 0; i < quantity; i++) {
-    bool send_ack = (i < quantity - 1); // ACK all but last byte
-    rx_buffer[rx_buffer_length++] = receiveByteSendAck(send_ack);
+  uint8_t result[sizeof(rx_buffer) + 1];
+  if (!execute(result, quantity + 1)) {
+    Logger.error("Failed to execute I2C transaction");
+    return 0;
   }
 
-  // Send stop condition if requested
-  if (stopBit) {
-    if (!sendStop()) {
-      Logger.error("Failed to send I2C stop condition");
-    }
+  if (result[0] & 0x01) {
+    Logger.error("I2C slave address NACK on read");
+    return 0;
   }
 
+  memcpy(rx_buffer, result + 1, quantity);
+  rx_buffer_length = quantity;
   return rx_buffer_length;
 }
 
@@ -299,87 +298,104 @@ bool HardwareI2C_FTDI::setClockFrequency(uint32_t frequency) {
   return sendData(clock_cmd, sizeof(clock_cmd)) == sizeof(clock_cmd);
 }
 
-bool HardwareI2C_FTDI::sendStart() {
+void HardwareI2C_FTDI::addStart() {
   // I2C start: SDA high->low while SCL high
-  if (!setLineStates(true, true)) return false;   // Both high
-  std::this_thread::sleep_for(std::chrono::microseconds(1));
-  if (!setLineStates(false, true)) return false;  // SDA low, SCL high  
-  std::this_thread::sleep_for(std::chrono::microseconds(1));
-  if (!setLineStates(false, false)) return false; // Both low
-  return true;
+  for (int j = 0; j < I2C_HOLD_REPEAT; j++) addLineStates(true, true);
+  for (int j = 0; j < I2C_HOLD_REPEAT; j++) addLineStates(false, true);
+  for (int j = 0; j < I2C_HOLD_REPEAT; j++) addLineStates(false, false);
 }
 
-bool HardwareI2C_FTDI::sendStop() {
+void HardwareI2C_FTDI::addStop() {
   // I2C stop: SDA low->high while SCL high
-  if (!setLineStates(false, false)) return false; // Both low
-  std::this_thread::sleep_for(std::chrono::microseconds(1));
-  if (!setLineStates(false, true)) return false;  // SDA low, SCL high
-  std::this_thread::sleep_for(std::chrono::microseconds(1));
-  if (!setLineStates(true, true)) return false;   // Both high
-  return true;
+  for (int j = 0; j < I2C_HOLD_REPEAT; j++) addLineStates(false, false);
+  for (int j = 0; j < I2C_HOLD_REPEAT; j++) addLineStates(false, true);
+  for (int j = 0; j < I2C_HOLD_REPEAT; j++) addLineStates(true, true);
 }
 
-bool HardwareI2C_FTDI::sendRepeatedStart() {
-  return sendStart();
-}
-
-bool HardwareI2C_FTDI::sendByteCheckAck(uint8_t data) {
+void HardwareI2C_FTDI::addWriteByte(uint8_t data) {
   // Send 8 data bits
-  uint8_t send_cmd[] = {
+  addLineStates(false, false);
+  const uint8_t send_cmd[] = {
     I2C_DATA_SHIFT_OUT,
-    0x07,  // 8 bits - 1
+    0x00, 0x00,  // 1 byte - 1
     data
   };
-  
-  if (sendData(send_cmd, sizeof(send_cmd)) != sizeof(send_cmd)) {
-    return false;
-  }
+  command_buffer.insert(command_buffer.end(), send_cmd, send_cmd + sizeof(send_cmd));
 
-  // Read ACK bit
-  uint8_t read_ack_cmd[] = {
-    I2C_DATA_SHIFT_IN,
+  // Release SDA and read the ACK bit
+  addLineStates(false, false, false);
+  const uint8_t read_ack_cmd[] = {
+    I2C_BITS_IN,
     0x00  // 1 bit - 1
   };
-  
-  if (sendData(read_ack_cmd, sizeof(read_ack_cmd)) != sizeof(read_ack_cmd)) {
-    return false;
-  }
+  command_buffer.insert(command_buffer.end(), read_ack_cmd, read_ack_cmd + sizeof(read_ack_cmd));
+}
 
-  uint8_t ack_bit;
-  if (receiveData(&ack_bit, 1) != 1) {
-    return false;
-  }
+void HardwareI2C_FTDI::addReadByte(bool send_ack) {
+  // Release SDA and read 8 data bits
+  addLineStates(false, false, false);
+  const uint8_t read_cmd[] = {
+    I2C_BYTES_IN,
+    0x00, 0x00  // 1 byte - 1
+  };
+  command_buffer.insert(command_buffer.end(), read_cmd, read_cmd + sizeof(read_cmd));
 
-  return (ack_bit & 0x01) == 0; // ACK is low
+  // Send ACK/NACK
+  addLineStates(false, false);
+  const uint8_t send_ack_cmd[] = {
+    I2C_BITS_OUT,
+    0x00,  // 1 bit - 1
+    (uint8_t)(send_ack ? 0x00 : 0x80)  // ACK=low, NACK=high
+  };
+  command_buffer.insert(command_buffer.end(), send_ack_cmd, send_ack_cmd + sizeof(send_ack_cmd));
 }
 
-uint8_t HardwareI2C_FTDI::receiveByteSendAck(bool send_ack) {
-  // Read 8 data bits
-  uint8_t read_cmd[] = {
-    I2C_DATA_SHIFT_IN,
-    0x07  // 8 bits - 1
-  };
-  
-  if (sendData(read_cmd, sizeof(read_cmd)) != sizeof(read_cmd)) {
-    return 0;
+void HardwareI2C_FTDI::addLineStates(bool sda_state, bool scl_state, bool sda_output) {
+  uint8_t pin_value = 0;
+  uint8_t pin_direction = (1 << SCL_BIT);
+  if (sda_output) {
+    pin_direction |= (1 << SDA_OUT_BIT);
   }
-
-  uint8_t data;
-  if (receiveData(&data, 1) != 1) {
-    return 0;
+  if (scl_state) {
+    pin_value |= (1 << SCL_BIT);
+  }
+  if (sda_state) {
+    pin_value |= (1 << SDA_OUT_BIT);
   }
 
-  // Send ACK/NACK
-  uint8_t ack_bit = send_ack ? 0x00 : 0x80; // ACK=low, NACK=high
-  uint8_t send_ack_cmd[] = {
-    I2C_DATA_SHIFT_OUT,
-    0x00,   // 1 bit - 1
-    ack_bit
-  };
-  
-  sendData(send_ack_cmd, sizeof(send_ack_cmd));
+  command_buffer.push_back(I2C_SET_DATA_BITS_LOW_BYTE);
+  command_buffer.push_back(pin_value);
+  command_buffer.push_back(pin_direction);
+}
+
+bool HardwareI2C_FTDI::execute(uint8_t* result, size_t length) {
+  // Make the device return the data without waiting for the latency timer
+  command_buffer.push_back(I2C_SEND_IMMEDIATE);
+  int ret = sendData(command_buffer.data(), command_buffer.size());
+  command_buffer.clear();
+  if (ret < 0) {
+    Logger.error("Failed to send I2C commands: %s", ftdi_get_error_string(ftdi_context));
+    return false;
+  }
 
-  return data;
+  // Read the whole reply
+  size_t received = 0;
+  for (int retry = 0; received < length && retry < 1000; retry++) {
+    int n = receiveData(result + received, length - received);
+    if (n < 0) {
+      Logger.error("Failed to read I2C reply: %s", ftdi_get_error_string(ftdi_context));
+      return false;
+    }
+    if (n == 0) {
+      std::this_thread::sleep_for(std::chrono::microseconds(10));
+    }
+    received += n;
+  }
+  if (received < length) {
+    Logger.error("Timeout reading I2C reply");
+    return false;
+  }
+  return true;
 }
 
 int HardwareI2C_FTDI::sendData(const uint8_t* data, size_t length) {
@@ -397,27 +413,13 @@ int HardwareI2C_FTDI::receiveData(uint8_t* data, size_t length) {
 }
 
 bool HardwareI2C_FTDI::setLineStates(bool sda_state, bool scl_state) {
-  uint8_t pin_value = 0;
-  uint8_t pin_direction = (1 << SCL_BIT) | (1 << SDA_OUT_BIT); // SCL and SDA_OUT as outputs
-  
-  if (scl_state) {
-    pin_value |= (1 << SCL_BIT);
-  }
-  if (sda_state) {
-    pin_value |= (1 << SDA_OUT_BIT);
-  }
-
-  uint8_t cmd[] = {
-    I2C_SET_DATA_BITS_LOW_BYTE,
-    pin_value,
-    pin_direction
-  };
-
-  return sendData(cmd, sizeof(cmd)) == sizeof(cmd);
+  command_buffer.clear();
+  addLineStates(sda_state, scl_state);
+  int ret = sendData(command_buffer.data(), command_buffer.size());
+  command_buffer.clear();
+  return ret == 3;
 }
 
-
-
 size_t HardwareI2C_FTDI::requestFrom(uint8_t address, size_t quantity) {
   return requestFrom(address, quantity, true);
 }
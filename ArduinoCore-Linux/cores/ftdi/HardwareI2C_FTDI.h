@@ -20,6 +20,7 @@
 #ifdef USE_FTDI
 #include <inttypes.h>
 #include <ftdi.h>
+#include <vector>
 // Undefine DEPRECATED macro from libftdi1 to avoid conflict with Arduino API
 #ifdef DEPRECATED
 #undef DEPRECATED
@@ -48,6 +49,11 @@ namespace arduino {
  * The class inherits from HardwareI2C and implements all required methods for
  * I2C communication, including device addressing, data transfer, and bus management.
  *
+ * A whole transaction (start, address, data, ACK checks and stop) is built into a single
+ * MPSSE command buffer which is terminated with SEND_IMMEDIATE. All ACK bits and received
+ * bytes are read back with one read and evaluated afterwards, so a transaction needs only
+ * one USB round trip. Consequently the remaining bytes are still clocked out after a NACK.
+ *
  * @note This class is only available when USE_FTDI is defined.
  * @note Requires libftdi1 development library to be installed.
  * @note External pull-up resistors (typically 4.7kΩ) are required on SCL and SDA lines.
@@ -204,13 +210,22 @@ class HardwareI2C_FTDI : public HardwareI2C {
   size_t rx_buffer_index = 0;
   
   // MPSSE I2C command constants
-  static const uint8_t I2C_DATA_SHIFT_OUT = 0x11;
-  static const uint8_t I2C_DATA_SHIFT_IN = 0x24;
-  static const uint8_t I2C_DATA_SHIFT_OUT_IN = 0x31;
-  static const uint8_t I2C_SET_DATA_BITS_LOW_BYTE = 0x80;
-  static const uint8_t I2C_SET_DATA_BITS_HIGH_BYTE = 0x82;
-  static const uint8_t I2C_GET_DATA_BITS_LOW_BYTE = 0x81;
-  static const uint8_t I2C_GET_DATA_BITS_HIGH_BYTE = 0x83;
+  static constexpr uint8_t I2C_DATA_SHIFT_OUT = 0x11;
+  static constexpr uint8_t I2C_DATA_SHIFT_IN = 0x24;
+  static constexpr uint8_t I2C_DATA_SHIFT_OUT_IN = 0x31;
+  static constexpr uint8_t I2C_SET_DATA_BITS_LOW_BYTE = 0x80;
+  static constexpr uint8_t I2C_SET_DATA_BITS_HIGH_BYTE = 0x82;
+  static constexpr uint8_t I2C_GET_DATA_BITS_LOW_BYTE = 0x81;
+  static constexpr uint8_t I2C_GET_DATA_BITS_HIGH_BYTE = 0x83;
+  static constexpr uint8_t I2C_BITS_OUT = 0x13;      // Bits out on -ve clock edge
+  static constexpr uint8_t I2C_BYTES_IN = 0x20;      // Bytes in on +ve clock edge
+  static constexpr uint8_t I2C_BITS_IN = 0x22;       // Bits in on +ve clock edge
+  static constexpr uint8_t I2C_SEND_IMMEDIATE = 0x87;
+  // Repetitions of a line state to respect the I2C setup and hold times
+  static constexpr int I2C_HOLD_REPEAT = 4;
+
+  // MPSSE commands of the current transaction
+  std::vector<uint8_t> command_buffer;
 
   // Pin assignments for I2C on ADBUS
   static const uint8_t SCL_BIT = 0;   // ADBUS0
@@ -231,36 +246,44 @@ class HardwareI2C_FTDI : public HardwareI2C {
   bool setClockFrequency(uint32_t frequency);
 
   /**
-   * @brief Send I2C start condition.
-   * @return true if successful, false on error
+   * @brief Add the I2C start (or repeated start) condition to the command buffer.
    */
-  bool sendStart();
+  void addStart();
 
   /**
-   * @brief Send I2C stop condition.
-   * @return true if successful, false on error
+   * @brief Add the I2C stop condition to the command buffer.
    */
-  bool sendStop();
+  void addStop();
 
   /**
-   * @brief Send I2C repeated start condition.
-   * @return true if successful, false on error
+   * @brief Add the commands to send a byte and to read the ACK bit: this results
+   * in one byte of the reply where bit 0 is the ACK (0) or NACK (1).
+   * @param data Byte to send
    */
-  bool sendRepeatedStart();
+  void addWriteByte(uint8_t data);
 
   /**
-   * @brief Send a byte over I2C and check for ACK.
-   * @param data Byte to send
-   * @return true if ACK received, false if NACK or error
+   * @brief Add the commands to read a byte and to send the ACK/NACK: this results
+   * in one byte of the reply.
+   * @param send_ack Whether to send ACK (true) or NACK (false)
    */
-  bool sendByteCheckAck(uint8_t data);
+  void addReadByte(bool send_ack);
 
   /**
-   * @brief Receive a byte over I2C and send ACK/NACK.
-   * @param send_ack Whether to send ACK (true) or NACK (false)
-   * @return Received byte
+   * @brief Add a SET_BITS_LOW command for the I2C lines.
+   * @param sda_state State of SDA line (true = high, false = low)
+   * @param scl_state State of SCL line (true = high, false = low)
+   * @param sda_output false to release SDA for reading
+   */
+  void addLineStates(bool sda_state, bool scl_state, bool sda_output = true);
+
+  /**
+   * @brief Send the command buffer with SEND_IMMEDIATE and read the whole reply.
+   * @param result Buffer for the reply
+   * @param length Expected number of bytes
+   * @return true if successful, false on error
    */
-  uint8_t receiveByteSendAck(bool send_ack);
+  bool execute(uint8_t* result, size_t length);
 
   /**
    * @brief Send raw data to FTDI device.
@@ -19,6 +19,9 @@
 #ifdef USE_FTDI
 #include "HardwareSPI_FTDI.h"
 #include "Arduino.h"
+#include <algorithm>
+#include <chrono>
+#include <thread>
 
 namespace arduino {
 
@@ -100,33 +103,31 @@ uint8_t HardwareSPI_FTDI::transfer(uint8_t data) {
     return 0;
   }
 
-  uint8_t command = getMPSSECommand(true, true);
-  uint8_t tx_buffer[3] = {command, 0, data}; // Command, length-1, data
   uint8_t rx_data = 0;
-
-  if (sendData(tx_buffer, 3) != 3) {
-    Logger.error("Failed to send SPI data");
-    return 0;
-  }
-
-  if (receiveData(&rx_data, 1) != 1) {
-    Logger.error("Failed to receive SPI data");
+  addCommand(transfer_command, 1);
+  command_buffer.push_back(data);
+  if (!execute(&rx_data, 1)) {
+    Logger.error("Failed to transfer SPI data");
     return 0;
   }
-
   return rx_data;
 }
 
 uint16_t HardwareSPI_FTDI::transfer16(uint16_t data) {
-  uint16_t result;
+  // Both bytes in a single transfer
+  uint8_t buffer[2];
   if (current_bit_order == MSBFIRST) {
-    result = transfer((data >> 8) & 0xFF) << 8;
-    result |= transfer(data & 0xFF);
+    buffer[0] = (data >> 8) & 0xFF;
+    buffer[1] = data & 0xFF;
   } else {
-    result = transfer(data & 0xFF);
-    result |= transfer((data >> 8) & 0xFF) << 8;
+    buffer[0] = data & 0xFF;
+    buffer[1] = (data >> 8) & 0xFF;
+  }
+  transfer(buffer, 2);
+  if (current_bit_order == MSBFIRST) {
+    return (buffer[0] << 8) | buffer[1];
   }
-  return result;
+  return (buffer[1] << 8) | buffer[0];
 }
 
 void HardwareSPI_FTDI::transfer(void* buf, size_t count) {
@@ -136,38 +137,51 @@ void HardwareSPI_FTDI::transfer(void* buf, size_t count) {
   }
 
   uint8_t* data = static_cast<uint8_t*>(buf);
-  uint8_t command = getMPSSECommand(true, true);
   
-  // MPSSE can handle up to 65536 bytes at once
-  for (size_t i = 0; i < count; i += 65536) {
-    size_t chunk_size = (count - i > 65536) ? 65536 : count - i;
-    
-    // Prepare command buffer
-    uint8_t cmd_buffer[3];
-    cmd_buffer[0] = command;
-    cmd_buffer[1] = (chunk_size - 1) & 0xFF;       // Length low byte
-    cmd_buffer[2] = ((chunk_size - 1) >> 8) & 0xFF; // Length high byte
-    
-    // Send command
-    if (sendData(cmd_buffer, 3) != 3) {
-      Logger.error("Failed to send SPI command");
-      return;
-    }
-    
-    // Send data
-    if (sendData(&data[i], chunk_size) != (int)chunk_size) {
-      Logger.error("Failed to send SPI data chunk");
+  // The received data of a chunk is read before the next one is sent, so
+  // that the chip does not stall with a full RX FIFO
+  for (size_t i = 0; i < count; i += MAX_TRANSFER_CHUNK_SIZE) {
+    size_t chunk_size = std::min(count - i, MAX_TRANSFER_CHUNK_SIZE);
+
+    // Command and data are sent with one write
+    addCommand(transfer_command, chunk_size);
+    command_buffer.insert(command_buffer.end(), data + i, data + i + chunk_size);
+
+    // Receive data (overwrites the same buffer)
+    if (!execute(&data[i], chunk_size)) {
+      Logger.error("Failed to transfer SPI data chunk");
       return;
     }
-    
-    // Receive data (overwrites the same buffer)
-    if (receiveData(&data[i], chunk_size) != (int)chunk_size) {
-      Logger.error("Failed to receive SPI data chunk");
+  }
+}
+
+void HardwareSPI_FTDI::writeBytes(const void* buf, size_t count) {
+  if (!is_open || !buf || count == 0) {
+    Logger.error("Invalid parameters for SPI transfer");
+    return;
+  }
+
+  const uint8_t* data = static_cast<const uint8_t*>(buf);
+  for (size_t i = 0; i < count; i += MAX_CHUNK_SIZE) {
+    size_t chunk_size = std::min(count - i, MAX_CHUNK_SIZE);
+    addCommand(write_command, chunk_size);
+    command_buffer.insert(command_buffer.end(), data + i, data + i + chunk_size);
+    if (!execute(nullptr, 0)) {
+      Logger.error("Failed to write SPI data chunk");
       return;
     }
   }
 }
 
+void HardwareSPI_FTDI::setAutoChipSelect(bool active) {
+  is_auto_cs = active;
+  if (is_open && active) {
+    // Release CS
+    addPinStates(false);
+    execute(nullptr, 0);
+  }
+}
+
 void HardwareSPI_FTDI::usingInterrupt(int interruptNumber) {
   Logger.warning("Interrupt handling not supported by FTDI SPI");
 }
@@ -185,13 +199,26 @@ void HardwareSPI_FTDI::beginTransaction(SPISettings settings) {
   current_clock = settings.getClockFreq();
   current_mode = settings.getDataMode();
   current_bit_order = settings.getBitOrder();
+  transfer_command = getMPSSECommand(true, true);
+  write_command = getMPSSECommand(false, true);
 
-  // Update clock frequency
-  setClockFrequency(current_clock);
+  // Update clock frequency: queued with the next transfer
+  if (current_clock != applied_clock) {
+    setClockFrequency(current_clock);
+  }
+
+  if (is_auto_cs) {
+    addPinStates(true);
+  }
 }
 
 void HardwareSPI_FTDI::endTransaction(void) {
-  // Nothing specific to do for FTDI
+  if (!is_open) return;
+  if (is_auto_cs) {
+    addPinStates(false);
+  }
+  // Send queued commands
+  execute(nullptr, 0);
 }
 
 void HardwareSPI_FTDI::attachInterrupt() {
@@ -231,7 +258,15 @@ bool HardwareSPI_FTDI::configureMPSSE() {
   }
 
   // Set initial clock frequency
+  command_buffer.clear();
+  applied_clock = 0;
+  transfer_command = getMPSSECommand(true, true);
+  write_command = getMPSSECommand(false, true);
   setClockFrequency(current_clock);
+  if (!execute(nullptr, 0)) {
+    Logger.error("Failed to set SPI clock");
+    return false;
+  }
 
   // Configure initial pin states
   // ADBUS0 = SCK (output), ADBUS1 = MOSI (output), ADBUS2 = MISO (input)
@@ -260,13 +295,11 @@ bool HardwareSPI_FTDI::setClockFrequency(uint32_t frequency) {
     divisor = 65535; // Minimum frequency ~457 Hz
   }
 
-  uint8_t clock_cmd[] = {
-    0x86,                          // Set clock divisor command
-    (uint8_t)(divisor & 0xFF),     // Divisor low byte
-    (uint8_t)((divisor >> 8) & 0xFF) // Divisor high byte
-  };
-
-  return sendData(clock_cmd, sizeof(clock_cmd)) == sizeof(clock_cmd);
+  command_buffer.push_back(0x86);                        // Set clock divisor command
+  command_buffer.push_back(divisor & 0xFF);              // Divisor low byte
+  command_buffer.push_back((divisor >> 8) & 0xFF);       // Divisor high byte
+  applied_clock = frequency;
+  return true;
 }
 
 uint8_t HardwareSPI_FTDI::getMPSSECommand(bool read_enable, bool write_enable) {
@@ -297,6 +330,59 @@ uint8_t HardwareSPI_FTDI::getMPSSECommand(bool read_enable, bool write_enable) {
   return command;
 }
 
+void HardwareSPI_FTDI::addPinStates(bool cs_active) {
+  uint8_t value = cs_active ? 0 : CS_BIT;
+  // Clock idle level for CPOL = 1
+  if (current_mode == SPI_MODE2 || current_mode == SPI_MODE3) {
+    value |= SCK_BIT;
+  }
+  command_buffer.push_back(CMD_SET_BITS_LOW);
+  command_buffer.push_back(value);
+  command_buffer.push_back(PIN_DIRECTIONS);
+}
+
+void HardwareSPI_FTDI::addCommand(uint8_t command, size_t length) {
+  command_buffer.push_back(command);
+  command_buffer.push_back((length - 1) & 0xFF);         // Length low byte
+  command_buffer.push_back(((length - 1) >> 8) & 0xFF);  // Length high byte
+}
+
+bool HardwareSPI_FTDI::execute(uint8_t* result, size_t length) {
+  if (command_buffer.empty()) {
+    return true;
+  }
+  // Make the device return the data without waiting for the latency timer
+  if (length > 0) {
+    command_buffer.push_back(CMD_SEND_IMMEDIATE);
+  }
+  int ret = sendData(command_buffer.data(), command_buffer.size());
+  bool ok = ret == (int)command_buffer.size();
+  command_buffer.clear();
+  if (!ok) {
+    Logger.error("Failed to send SPI commands");
+    return false;
+  }
+
+  // Read the whole response
+  size_t received = 0;
+  for (int retry = 0; received < length && retry < 1000; retry++) {
+    int n = receiveData(result + received, length - received);
+    if (n < 0) {
+      Logger.error("Failed to receive SPI data");
+      return false;
+    }
+    if (n == 0) {
+      std::this_thread::sleep_for(std::chrono::microseconds(10));
+    }
+    received += n;
+  }
+  if (received < length) {
+    Logger.error("Timeout receiving SPI data");
+    return false;
+  }
+  return true;
+}
+
 int HardwareSPI_FTDI::sendData(const uint8_t* data, size_t length) {
   if (!ftdi_context || !data) {
     return -1;
@@ -20,6 +20,7 @@
 #ifdef USE_FTDI
 #include <inttypes.h>
 #include <ftdi.h>
+#include <vector>
 // Undefine DEPRECATED macro from libftdi1 to avoid conflict with Arduino API
 #ifdef DEPRECATED
 #undef DEPRECATED
@@ -48,6 +49,12 @@ namespace arduino {
  * The class inherits from HardwareSPI and implements all required methods for
  * SPI communication, including data transfer, transaction management, and configuration.
  *
+ * MPSSE commands are collected in a command buffer, so that the command and the payload
+ * of a transfer are sent with a single USB write. The clock divisor is only sent when it
+ * changes. With setAutoChipSelect(true) the CS pin (ADBUS3) is asserted by
+ * beginTransaction() and released by endTransaction() within the same buffer. writeBytes()
+ * uses write-only commands, e.g. for displays which do not need MISO.
+ *
  * @note This class is only available when USE_FTDI is defined.
  * @note Requires libftdi1 development library to be installed.
  */
@@ -105,6 +112,20 @@ class HardwareSPI_FTDI : public HardwareSPI {
    */
   void transfer(void* buf, size_t count) override;
 
+  /**
+   * @brief Write a buffer without reading the response (write-only MPSSE command).
+   * @param buf Buffer containing data to send
+   * @param count Number of bytes to send
+   */
+  void writeBytes(const void* buf, size_t count);
+
+  /**
+   * @brief Drive the CS pin (ADBUS3, active low) in beginTransaction() and
+   * endTransaction().
+   * @param active true to control CS automatically
+   */
+  void setAutoChipSelect(bool active);
+
   // Transaction Functions
   /**
    * @brief Register interrupt usage (not implemented for FTDI).
@@ -155,6 +176,21 @@ class HardwareSPI_FTDI : public HardwareSPI {
   uint32_t current_clock = 1000000;     // Default 1MHz
   SPIMode current_mode = SPI_MODE0;     // Default mode 0
   BitOrder current_bit_order = MSBFIRST; // Default MSB first
+  uint32_t applied_clock = 0;            // Clock of the last divisor command
+  uint8_t transfer_command = 0;          // Cached MPSSE commands for the current mode
+  uint8_t write_command = 0;
+  bool is_auto_cs = false;
+
+  // Collected MPSSE commands which are sent with the next transfer
+  std::vector<uint8_t> command_buffer;
+  static constexpr size_t MAX_CHUNK_SIZE = 65536;
+  // Full duplex data must fit into the RX FIFO of the FT2232H until it is read
+  static constexpr size_t MAX_TRANSFER_CHUNK_SIZE = 4096;
+  static constexpr uint8_t CMD_SET_BITS_LOW = 0x80;
+  static constexpr uint8_t CMD_SEND_IMMEDIATE = 0x87;
+  static constexpr uint8_t SCK_BIT = 0x01;  // ADBUS0
+  static constexpr uint8_t CS_BIT = 0x08;   // ADBUS3
+  static constexpr uint8_t PIN_DIRECTIONS = 0x0B;
   
     // MPSSE command definitions for SPI (using different names to avoid macro conflicts)
   static const uint8_t CMD_WRITE_NEG = 0x01;     // Write TDI/DO on negative clock edge
@@ -172,7 +208,7 @@ class HardwareSPI_FTDI : public HardwareSPI {
   bool configureMPSSE();
 
   /**
-   * @brief Set the SPI clock frequency.
+   * @brief Add the clock divisor for the SPI clock frequency to the command buffer.
    * @param frequency Clock frequency in Hz
    * @return true if successful, false on error
    */
@@ -186,6 +222,27 @@ class HardwareSPI_FTDI : public HardwareSPI {
    */
   uint8_t getMPSSECommand(bool read_enable, bool write_enable);
 
+  /**
+   * @brief Add the pin states (clock idle level and CS) to the command buffer.
+   * @param cs_active true to assert CS
+   */
+  void addPinStates(bool cs_active);
+
+  /**
+   * @brief Add a transfer command with its length to the command buffer.
+   * @param command MPSSE command
+   * @param length Number of bytes (1 - 65536)
+   */
+  void addCommand(uint8_t command, size_t length);
+
+  /**
+   * @brief Send the command buffer and read the expected response.
+   * @param result Buffer for the response (may be nullptr if length is 0)
+   * @param length Number of bytes to read
+   * @return true if successful, false on error
+   */
+  bool execute(uint8_t* result, size_t length);
+
   /**
    * @brief Send raw data to FTDI device.
    * @param data Pointer to data buffer
@@ -0,0 +1,540 @@
+/*
+  PosixFile.h
+  Copyright (c) 2025 Phil Schatzmann. All right reserved.
+
+  This library is free software; you can redistribute it and/or
+  modify it under the terms of the GNU Lesser General Public
+  License as published by the Free Software Foundation; either
+  version 2.1 of the License, or (at your option) any later version.
+
+  This library is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+  Lesser General Public License for more details.
+
+  You should have received a copy of the GNU Lesser General Public
+  License along with this library; if not, write to the Free Software
+  Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA 02110-1301 USA
+*/
+#pragma once
+
+#include <dirent.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/syscall.h>
+#include <sys/types.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+/**
+ * @brief Writes pages of a file with a background thread: used by PosixFile
+ * for the write-behind mode.
+ *
+ * The number of pages is fixed: acquire() blocks while all pages are queued,
+ * which throttles the writer to the speed of the storage.
+ */
+class AsyncFileWriter {
+ public:
+  struct Page {
+    std::vector<uint8_t> data;
+    size_t len = 0;
+    uint64_t offset = 0;
+  };
+
+  AsyncFileWriter(int fd, size_t pageCount, size_t pageSize) : fd(fd) {
+    pages.resize(pageCount);
+    for (auto& page : pages) {
+      page.data.resize(pageSize);
+      free_pages.push_back(&page);
+    }
+    thread = std::thread(&AsyncFileWriter::run, this);
+  }
+
+  ~AsyncFileWriter() {
+    {
+      std::lock_guard<std::mutex> lock(mtx);
+      is_running = false;
+    }
+    cond.notify_all();
+    thread.join();
+  }
+
+  /// Provides an empty page: waits while all pages are queued. Returns
+  /// nullptr after a write error.
+  Page* acquire() {
+    std::unique_lock<std::mutex> lock(mtx);
+    cond.wait(lock, [this] { return !free_pages.empty() || is_error; });
+    if (is_error) return nullptr;
+    Page* page = free_pages.back();
+    free_pages.pop_back();
+    page->len = 0;
+    return page;
+  }
+
+  /// Queues the page for writing
+  void submit(Page* page) {
+    {
+      std::lock_guard<std::mutex> lock(mtx);
+      queue.push_back(page);
+    }
+    cond.notify_all();
+  }
+
+  /// Waits until all queued pages have been written
+  bool sync() {
+    std::unique_lock<std::mutex> lock(mtx);
+    cond.wait(lock, [this] { return (queue.empty() && busy == 0) || is_error; });
+    return !is_error;
+  }
+
+ protected:
+  int fd;
+  std::vector<Page> pages;
+  std::vector<Page*> free_pages;
+  std::deque<Page*> queue;
+  std::mutex mtx;
+  std::condition_variable cond;
+  std::thread thread;
+  bool is_running = true;
+  bool is_error = false;
+  int busy = 0;
+
+  void run() {
+    std::unique_lock<std::mutex> lock(mtx);
+    while (true) {
+      cond.wait(lock, [this] { return !queue.empty() || !is_running; });
+      if (queue.empty()) break;
+      Page* page = queue.front();
+      queue.pop_front();
+      busy++;
+      lock.unlock();
+      bool ok = writeAll(page);
+      lock.lock();
+      busy--;
+      if (!ok) is_error = true;
+      free_pages.push_back(page);
+      cond.notify_all();
+    }
+  }
+
+  bool writeAll(Page* page) {
+    const uint8_t* data = page->data.data();
+    size_t len = page->len;
+    uint64_t offset = page->offset;
+    while (len > 0) {
+      ssize_t n = ::pwrite(fd, data, len, offset);
+      if (n < 0 && errno == EINTR) continue;
+      if (n <= 0) return false;
+      data += n;
+      len -= n;
+      offset += n;
+    }
+    return true;
+  }
+};
+
+/**
+ * @brief Buffered file on a POSIX file descriptor: used by the SD and SdFat
+ * emulation.
+ *
+ * The data is read and written with pread()/pwrite() through a single buffer,
+ * requests which are bigger than the buffer bypass it. The position and the
+ * size are tracked locally, so position(), size() and available() do not need
+ * any system call. Read-only files can be mapped into memory with map(), then
+ * the reads are just a memcpy().
+ *
+ * O_APPEND and O_SYNC are emulated: appending writes are positioned at the end
+ * of the file and flush() calls fdatasync() if the file was opened with
+ * O_SYNC.
+ *
+ * With setAsyncWrite() the file switches to write-behind: write() copies the
+ * data into pages which are written by a background thread, so that the
+ * caller is not blocked by the latency of the storage. sync() is the barrier
+ * which waits until everything was written.
+ */
+class PosixFile {
+ public:
+  static constexpr size_t BUFFER_SIZE = 64 * 1024;
+
+  PosixFile() = default;
+  PosixFile(const PosixFile&) = delete;
+  PosixFile& operator=(const PosixFile&) = delete;
+  PosixFile(PosixFile&& other) { *this = std::move(other); }
+
+  PosixFile& operator=(PosixFile&& other) {
+    if (this != &other) {
+      close();
+      fd = other.fd;
+      p_map = other.p_map;
+      map_size = other.map_size;
+      pos = other.pos;
+      file_size = other.file_size;
+      is_readable = other.is_readable;
+      is_writable = other.is_writable;
+      is_append = other.is_append;
+      is_sync = other.is_sync;
+      buffer = std::move(other.buffer);
+      buffer_pos = other.buffer_pos;
+      buffer_len = other.buffer_len;
+      dirty_len = other.dirty_len;
+      p_async = std::move(other.p_async);
+      p_page = other.p_page;
+      other.p_page = nullptr;
+      other.fd = -1;
+      other.p_map = nullptr;
+      other.dirty_len = other.buffer_len = 0;
+    }
+    return *this;
+  }
+
+  ~PosixFile() { close(); }
+
+  /// Opens the file with the open() flags
+  bool open(const char* path, int flags, mode_t mode = 0666) {
+    close();
+    is_append = flags & O_APPEND;
+    is_sync = flags & O_SYNC;
+    // pwrite() would ignore the position with O_APPEND and O_SYNC would make
+    // each write synchronous: both are handled here
+    flags &= ~(O_APPEND | O_SYNC);
+    fd = ::open(path, flags | O_CLOEXEC, mode);
+    if (fd < 0) return false;
+    struct stat info;
+    if (::fstat(fd, &info) != 0) {
+      close();
+      return false;
+    }
+    file_size = info.st_size;
+    int access = flags & O_ACCMODE;
+    is_readable = access != O_WRONLY;
+    is_writable = access != O_RDONLY;
+    pos = 0;
+    buffer_pos = buffer_len = dirty_len = 0;
+    return true;
+  }
+
+  /// Maps a read-only file into memory
+  bool map() {
+    if (fd < 0 || is_writable || file_size == 0) return false;
+    if (p_map != nullptr) return true;
+    void* mem = ::mmap(nullptr, file_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    if (mem == MAP_FAILED) return false;
+    ::madvise(mem, file_size, MADV_SEQUENTIAL);
+    p_map = (uint8_t*)mem;
+    map_size = file_size;
+    return true;
+  }
+
+  bool isMapped() { return p_map != nullptr; }
+
+  /// Activates the write-behind mode with the indicated number of 64 KB
+  /// pages: write() only blocks when all pages are waiting to be written.
+  bool setAsyncWrite(bool active, size_t pages = 2) {
+    if (fd < 0 || !is_writable) return false;
+    bool result = drain();
+    p_async.reset();
+    if (active) {
+      p_async.reset(new AsyncFileWriter(fd, std::max<size_t>(pages, 1),
+                                        BUFFER_SIZE));
+    }
+    return result;
+  }
+
+  bool isAsyncWrite() { return p_async != nullptr; }
+
+  bool close() {
+    if (fd < 0) return true;
+    bool result = drain();
+    p_async.reset();
+    if (p_map != nullptr) {
+      ::munmap(p_map, map_size);
+      p_map = nullptr;
+    }
+    if (::close(fd) != 0) result = false;
+    fd = -1;
+    return result;
+  }
+
+  bool isOpen() { return fd >= 0; }
+
+  int fileDescriptor() { return fd; }
+
+  size_t read(uint8_t* data, size_t len) {
+    if (fd < 0 || !is_readable) return 0;
+    if (p_map != nullptr) {
+      size_t n = pos < map_size ? std::min(len, (size_t)(map_size - pos)) : 0;
+      memcpy(data, p_map + pos, n);
+      pos += n;
+      return n;
+    }
+    if (!drain()) return 0;
+    size_t result = 0;
+    while (result < len) {
+      if (pos >= buffer_pos && pos < buffer_pos + buffer_len) {
+        size_t n = std::min(len - result, (size_t)(buffer_pos + buffer_len - pos));
+        memcpy(data + result, buffer.data() + (pos - buffer_pos), n);
+        pos += n;
+        result += n;
+        continue;
+      }
+      ssize_t n;
+      if (len - result >= BUFFER_SIZE) {
+        // big requests are read directly into the target
+        n = readAt(data + result, len - result, pos);
+        if (n <= 0) break;
+        pos += n;
+        result += n;
+      } else {
+        buffer.resize(BUFFER_SIZE);
+        n = readAt(buffer.data(), BUFFER_SIZE, pos);
+        if (n <= 0) break;
+        buffer_pos = pos;
+        buffer_len = n;
+      }
+    }
+    // the file might have been extended by somebody else
+    if (pos > file_size) file_size = pos;
+    return result;
+  }
+
+  int read() {
+    if (p_map == nullptr && dirty_len == 0 && pos >= buffer_pos &&
+        pos < buffer_pos + buffer_len) {
+      return buffer[pos++ - buffer_pos];
+    }
+    uint8_t c;
+    return read(&c, 1) == 1 ? c : -1;
+  }
+
+  int peek() {
+    int result = read();
+    if (result >= 0) pos--;
+    return result;
+  }
+
+  size_t write(const uint8_t* data, size_t len) {
+    if (fd < 0 || !is_writable || len == 0) return 0;
+    if (is_append) pos = file_size;
+    // the read cache might become invalid
+    buffer_len = 0;
+    if (p_async != nullptr) return writeAsync(data, len);
+    if (dirty_len > 0 &&
+        (pos != buffer_pos + dirty_len || dirty_len + len > BUFFER_SIZE)) {
+      if (!flushBuffer()) return 0;
+    }
+    if (dirty_len == 0 && len >= BUFFER_SIZE) {
+      // big requests are written directly
+      if (!writeAt(data, len, pos)) return 0;
+    } else {
+      buffer.resize(BUFFER_SIZE);
+      if (dirty_len == 0) buffer_pos = pos;
+      memcpy(buffer.data() + dirty_len, data, len);
+      dirty_len += len;
+    }
+    pos += len;
+    if (pos > file_size) file_size = pos;
+    return len;
+  }
+
+  /// Writes the buffered data (in write-behind mode it is only queued): with
+  /// O_SYNC the data is also committed to the storage
+  bool flush() {
+    if (fd < 0) return false;
+    if (is_sync) return sync();
+    return flushBuffer();
+  }
+
+  /// Waits until all data was written and commits it to the storage
+  bool sync() {
+    if (fd < 0) return false;
+    bool result = drain();
+    if (::fdatasync(fd) != 0) result = false;
+    return result;
+  }
+
+  bool seek(uint64_t newPos) {
+    if (fd < 0) return false;
+    pos = newPos;
+    return true;
+  }
+
+  uint64_t position() { return pos; }
+
+  uint64_t size() { return file_size; }
+
+  uint64_t available() { return file_size > pos ? file_size - pos : 0; }
+
+  /// Number of bytes by which the file grows when len bytes are written
+  uint64_t growth(size_t len) {
+    uint64_t start = is_append ? file_size : pos;
+    return start + len > file_size ? start + len - file_size : 0;
+  }
+
+  bool truncate(uint64_t len) {
+    if (fd < 0 || !drain() || ::ftruncate(fd, len) != 0) return false;
+    buffer_len = 0;
+    file_size = len;
+    return true;
+  }
+
+ protected:
+  int fd = -1;
+  uint8_t* p_map = nullptr;
+  uint64_t map_size = 0;
+  uint64_t pos = 0;
+  uint64_t file_size = 0;
+  bool is_readable = false;
+  bool is_writable = false;
+  bool is_append = false;
+  bool is_sync = false;
+  // read cache or pending writes (dirty_len > 0) starting at buffer_pos
+  std::vector<uint8_t> buffer;
+  uint64_t buffer_pos = 0;
+  size_t buffer_len = 0;
+  size_t dirty_len = 0;
+  // write-behind
+  std::unique_ptr<AsyncFileWriter> p_async;
+  AsyncFileWriter::Page* p_page = nullptr;
+
+  /// Writes the buffer or hands the current page to the writer thread
+  bool flushBuffer() {
+    if (p_page != nullptr) {
+      p_async->submit(p_page);
+      p_page = nullptr;
+    }
+    if (dirty_len == 0) return true;
+    bool result = writeAt(buffer.data(), dirty_len, buffer_pos);
+    dirty_len = 0;
+    return result;
+  }
+
+  /// Writes all pending data
+  bool drain() {
+    if (!flushBuffer()) return false;
+    return p_async == nullptr || p_async->sync();
+  }
+
+  size_t writeAsync(const uint8_t* data, size_t len) {
+    size_t result = 0;
+    while (result < len) {
+      if (p_page != nullptr && (pos != p_page->offset + p_page->len ||
+                                p_page->len == p_page->data.size())) {
+        flushBuffer();
+      }
+      if (p_page == nullptr) {
+        p_page = p_async->acquire();
+        if (p_page == nullptr) break;
+        p_page->offset = pos;
+      }
+      size_t n = std::min(len - result, p_page->data.size() - p_page->len);
+      memcpy(p_page->data.data() + p_page->len, data + result, n);
+      p_page->len += n;
+      pos += n;
+      result += n;
+    }
+    if (pos > file_size) file_size = pos;
+    return result;
+  }
+
+  ssize_t readAt(uint8_t* data, size_t len, uint64_t offset) {
+    while (true) {
+      ssize_t n = ::pread(fd, data, len, offset);
+      if (n >= 0 || errno != EINTR) return n;
+    }
+  }
+
+  bool writeAt(const uint8_t* data, size_t len, uint64_t offset) {
+    while (len > 0) {
+      ssize_t n = ::pwrite(fd, data, len, offset);
+      if (n < 0 && errno == EINTR) continue;
+      if (n <= 0) return false;
+      data += n;
+      len -= n;
+      offset += n;
+    }
+    return true;
+  }
+};
+
+/**
+ * @brief Entries of a directory: used by the SD and SdFat emulation to
+ * iterate over a directory.
+ *
+ * read() loads all entries with getdents64() in batches of 64 KB. The type of
+ * the entries is provided by the file system, so that no stat() is needed
+ * unless the file system does not report it.
+ */
+class PosixDirectory {
+ public:
+  /// Reads all entries of the directory (without . and ..)
+  bool read(const char* path) {
+    clear();
+    int fd = ::open(path, O_RDONLY | O_DIRECTORY | O_CLOEXEC);
+    if (fd < 0) return false;
+    std::vector<uint8_t> buffer(64 * 1024);
+    bool result = true;
+    while (true) {
+      long len = ::syscall(SYS_getdents64, fd, buffer.data(), buffer.size());
+      if (len < 0 && errno == EINTR) continue;
+      if (len <= 0) {
+        result = len == 0;
+        break;
+      }
+      for (long offset = 0; offset < len;) {
+        LinuxDirent64* entry = (LinuxDirent64*)(buffer.data() + offset);
+        offset += entry->d_reclen;
+        const char* name = entry->d_name;
+        if (strcmp(name, ".") == 0 || strcmp(name, "..") == 0) continue;
+        bool is_dir = entry->d_type == DT_DIR;
+        if (entry->d_type == DT_UNKNOWN || entry->d_type == DT_LNK) {
+          struct stat info;
+          is_dir = ::fstatat(fd, name, &info, 0) == 0 && S_ISDIR(info.st_mode);
+        }
+        entries.push_back({(uint32_t)names.size(), is_dir});
+        names.append(name);
+        names.push_back('\0');
+      }
+    }
+    ::close(fd);
+    return result;
+  }
+
+  void clear() {
+    entries.clear();
+    names.clear();
+  }
+
+  size_t size() { return entries.size(); }
+
+  const char* name(size_t idx) { return names.c_str() + entries[idx].name_pos; }
+
+  bool isDirectory(size_t idx) { return entries[idx].is_dir; }
+
+ protected:
+  struct LinuxDirent64 {
+    uint64_t d_ino;
+    int64_t d_off;
+    unsigned short d_reclen;
+    unsigned char d_type;
+    char d_name[];
+  };
+  struct Entry {
+    uint32_t name_pos;
+    bool is_dir;
+  };
+  std::vector<Entry> entries;
+  // the names separated by 0
+  std::string names;
+};
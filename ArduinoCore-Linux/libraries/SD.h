@@ -19,19 +19,19 @@
 #pragma once
 
 #include <sys/stat.h>
+#include <sys/statvfs.h>
 #include <sys/types.h>
 #include <unistd.h>
 
+#include <climits>
 #include <cstdint>
 #include <filesystem>
-#include <fstream>
 #include <iostream>
+#include <memory>
 #include <string>
 
+#include "PosixFile.h"
 #include "Stream.h"
-#ifdef USE_FILESYSTEM
-#include <filesystem>
-#endif
 
 #define SD_SCK_MHZ(maxMhz) (1000000UL * (maxMhz))
 #define SPI_FULL_SPEED SD_SCK_MHZ(50)
@@ -42,19 +42,19 @@
 #define SPI_EIGHTH_SPEED SD_SCK_MHZ(1)
 #define SPI_SIXTEENTH_SPEED SD_SCK_HZ(500000)
 
-#define O_RDONLY ios::in           ///< Open for reading only.
-#define O_WRONLY ios::out          ///< Open for writing only.
-#define O_RDWR ios::in | ios::out  ///< Open for reading and writing.
-#define O_AT_END ios::ate          ///< Open at EOF.
-#define O_APPEND ios::ate          ///< Set append mode.
-#define O_CREAT ios::trunc         ///< Create file if it does not exist.
-#define O_TRUNC ios::trunc         ///< Truncate file to zero length.
-#define O_EXCL 0                   ///< Fail if the file exists.
-#define O_SYNC 0                   ///< Synchronized write I/O operations.
+// O_RDONLY, O_WRONLY, O_RDWR, O_APPEND, O_CREAT, O_TRUNC, O_EXCL and O_SYNC
+// are the ones of <fcntl.h>
+#ifndef O_AT_END
+#define O_AT_END 0x10000000  ///< Open at EOF (not used by open()).
+#endif
+#ifndef O_READ
 #define O_READ O_RDONLY
 #define O_WRITE O_WRONLY
-#define FILE_READ ios::in
-#define FILE_WRITE ios::out
+#endif
+#ifndef FILE_READ
+#define FILE_READ O_RDONLY
+#define FILE_WRITE (O_RDWR | O_CREAT | O_AT_END)
+#endif
 
 #ifndef SS
 #define SS -1
@@ -72,94 +72,246 @@ class SdSpiConfig {
 };
 
 /**
- * @brief C++ std based emulatoion ofr File
+ * @brief Storage of an emulated SD card: the root directory and the optional
+ * quota
+ *
+ * The paths of the sketch are mapped into the root directory: .. can not
+ * leave it (symbolic links inside the root are followed). With a quota the
+ * card has the indicated size: the used bytes are the sum of the file sizes
+ * in the root directory and writes beyond the quota fail. The used and total
+ * bytes are cached: writes update them, removals invalidate them.
+ */
+class SDStorage {
+ public:
+  /// Defines the root directory which is created if it does not exist:
+  /// empty to use the paths as they are
+  bool setRoot(const char *dir) {
+    root = dir != nullptr ? dir : "";
+    while (root.size() > 1 && root.back() == '/') root.pop_back();
+    invalidate();
+    if (root.empty()) return true;
+    std::error_code ec;
+    std::filesystem::create_directories(root, ec);
+    return std::filesystem::is_directory(root, ec);
+  }
+
+  const char *getRoot() { return root.c_str(); }
+
+  /// Size of the emulated card in bytes: 0 to report the file system
+  void setQuota(uint64_t bytes) {
+    quota = bytes;
+    invalidate();
+  }
+
+  /// Maps the path of the sketch into the root directory
+  std::string path(const char *name) {
+    if (root.empty()) return name;
+    std::vector<std::string> parts;
+    std::string part;
+    for (const char *p = name;; p++) {
+      if (*p == '/' || *p == 0) {
+        if (part == "..") {
+          if (!parts.empty()) parts.pop_back();
+        } else if (!part.empty() && part != ".") {
+          parts.push_back(part);
+        }
+        part.clear();
+        if (*p == 0) break;
+      } else {
+        part += *p;
+      }
+    }
+    std::string result = root;
+    for (auto &p : parts) {
+      result += '/';
+      result += p;
+    }
+    return result;
+  }
+
+  /// Path of the sketch for the path in the file system
+  const char *sketchPath(const std::string &path) {
+    if (root.empty() || path.compare(0, root.size(), root) != 0) {
+      return path.c_str();
+    }
+    return path.size() == root.size() ? "/" : path.c_str() + root.size();
+  }
+
+  uint64_t totalBytes() {
+    update();
+    return total_bytes;
+  }
+
+  uint64_t usedBytes() {
+    update();
+    return used_bytes;
+  }
+
+  /// Reserves the space for the growth of a file: returns the number of
+  /// bytes which fit on the card
+  uint64_t reserve(uint64_t bytes) {
+    if (bytes == 0) return 0;
+    update();
+    if (quota > 0) bytes = std::min(bytes, total_bytes - used_bytes);
+    used_bytes += bytes;
+    return bytes;
+  }
+
+  /// The cached values need to be determined again
+  void invalidate() { is_valid = false; }
+
+ protected:
+  std::string root;
+  uint64_t quota = 0;
+  bool is_valid = false;
+  uint64_t total_bytes = 0;
+  uint64_t used_bytes = 0;
+
+  void update() {
+    if (is_valid) return;
+    is_valid = true;
+    if (quota > 0) {
+      total_bytes = quota;
+      used_bytes = std::min(directorySize(root.empty() ? "." : root), quota);
+      return;
+    }
+    struct statvfs info;
+    if (statvfs(root.empty() ? "." : root.c_str(), &info) == 0) {
+      total_bytes = (uint64_t)info.f_blocks * info.f_frsize;
+      used_bytes = (uint64_t)(info.f_blocks - info.f_bavail) * info.f_frsize;
+    } else {
+      total_bytes = used_bytes = 0;
+    }
+  }
+
+  uint64_t directorySize(const std::string &dir) {
+    uint64_t result = 0;
+    PosixDirectory entries;
+    if (!entries.read(dir.c_str())) return 0;
+    for (size_t j = 0; j < entries.size(); j++) {
+      std::string path = dir + "/" + entries.name(j);
+      if (entries.isDirectory(j)) {
+        result += directorySize(path);
+      } else {
+        struct stat info;
+        if (lstat(path.c_str(), &info) == 0) result += info.st_size;
+      }
+    }
+    return result;
+  }
+};
+
+/**
+ * @brief Emulation of the SD File: regular files are accessed via PosixFile
  *
+ * The entries of a directory are read with a single pass when the iteration
+ * starts, so openNextFile() does not need any stat() calls. The files which
+ * are returned by openNextFile() are only opened with the first access, so
+ * listing the names of a directory does not need any system calls per entry.
  */
 class File : public Stream {
  public:
   bool isOpen() {
     if (filename == "") return false;
-    if (is_dir) return true;
-    bool result = file.is_open();
-    return result;
+    if (is_dir || is_pending) return true;
+    return file.isOpen();
   }
 
+  /// Read-only files with at least the indicated size are mapped into
+  /// memory by open(): 0 to deactivate
+  void setMmapThreshold(size_t size) { mmap_threshold = size; }
+
+  /// Opens the file or directory with the open() flags
   bool open(const char *name, int flags) {
-    this->filename = name;
-    int rc = stat(name, &info);
-    if ((flags == O_RDONLY) && rc == -1) {
-      // if we want to read but the file does not exist we fail
-      return false;
-    } else if (rc == 0 && info.st_mode & S_IFDIR) {
-      // file exists and it is a directory
-      is_dir = true;
-      size_bytes = 0;
-#ifdef USE_FILESYSTEM
-      // prevent authorization exceptions
-      try {
-        dir_path = std::filesystem::path(filename);
-        iterator = std::filesystem::directory_iterator({dir_path});
-      } catch (...) {
-      }
-#endif
-      return true;
-    } else {
-      is_dir = false;
-      size_bytes = rc != -1 ? info.st_size : 0;
-      file.open(filename.c_str(), toMode(flags));
-      return isOpen();
-    }
+    std::string path = p_storage ? p_storage->path(name) : name;
+    struct stat info;
+    bool is_directory =
+        stat(path.c_str(), &info) == 0 && S_ISDIR(info.st_mode);
+    return openEntry(path.c_str(), flags, is_directory);
   }
 
+  /// Defines the card which contains the file: used by SdFat
+  void setStorage(std::shared_ptr<SDStorage> storage) { p_storage = storage; }
+
   bool close() {
-    file.close();
-    return !isOpen();
+    directory.clear();
+    is_dir_read = false;
+    is_pending = false;
+    return file.close();
   }
 
   size_t read(uint8_t *buffer, size_t length) {
-    return readBytes((char *)buffer, length);
+    return io().read(buffer, length);
+  }
+
+  size_t readBytes(uint8_t *buffer, size_t length) {
+    return io().read(buffer, length);
   }
 
   size_t readBytes(char *buffer, size_t length) {
-    file.read(buffer, length);
-    return static_cast<size_t>(file.gcount());
+    return io().read((uint8_t *)buffer, length);
   }
 
   size_t write(const uint8_t *buffer, size_t size) override {
-    file.write((const char *)buffer, size);
-    return file.good() ? size : 0;
-  }
-  size_t write(uint8_t ch) override {
-    file.put(ch);
-    return file.good() ? 1 : 0;
+    if (p_storage) {
+      // limit the size to the free space of the card
+      uint64_t growth = io().growth(size);
+      uint64_t reserved = p_storage->reserve(growth);
+      if (reserved < growth) size -= std::min<uint64_t>(size, growth - reserved);
+    }
+    return io().write(buffer, size);
   }
-  int available() override { return size_bytes - file.tellg(); };
+  size_t write(uint8_t ch) override { return write(&ch, 1); }
+  int available() override {
+    return std::min<uint64_t>(io().available(), INT_MAX);
+  };
   int availableForWrite() override { return 1024; }
-  int read() override { return file.get(); }
-  int peek() override { return file.peek(); }
-  void flush() override {}
-  void getName(char *str, size_t len) { strncpy(str, filename.c_str(), len); }
+  int read() override { return io().read(); }
+  int peek() override { return io().peek(); }
+  void flush() override { io().flush(); }
+
+  /// Write-behind mode for data loggers: write() copies the data into 64 KB
+  /// pages which are written by a background thread. It only blocks when all
+  /// pages are waiting to be written.
+  bool setAsyncWrite(bool active, size_t pages = 2) {
+    return io().setAsyncWrite(active, pages);
+  }
+
+  /// Waits until all data was written and commits it to the storage
+  bool sync() { return io().sync(); }
+  void getName(char *str, size_t len) { strncpy(str, name(), len); }
   bool isDir() { return is_dir; }
   bool isHidden() { return false; }
   bool rewind() {
     pos = 0;
     return is_dir;
   }
-  bool openNext(File &dir, int flags = O_RDONLY) {
-    if (!*this) return false;
-
-    // if (pos == 0) {
-    //   dir_path = std::filesystem::path(filename);
-    //   iterator = std::filesystem::directory_iterator({dir_path});
-    // }
-    // pos++;
-#ifdef USE_FILESYSTEM
-    if (iterator != end(iterator)) {
-      std::filesystem::directory_entry entry = *iterator++;
-      return dir.open(entry.path().c_str(), flags);
+
+  /// Opens the next entry of this directory in entry
+  bool openNext(File &entry, int flags = O_RDONLY) {
+    if (!is_dir) return false;
+    if (!is_dir_read) {
+      is_dir_read = directory.read(filename.c_str());
+      if (!is_dir_read) return false;
     }
-#endif
-    return false;
+    if ((size_t)pos >= directory.size()) return false;
+    std::string path = filename;
+    if (path.empty() || path.back() != '/') path += '/';
+    path += directory.name(pos);
+    bool is_directory = directory.isDirectory(pos);
+    pos++;
+    entry.mmap_threshold = mmap_threshold;
+    entry.p_storage = p_storage;
+    if (!is_directory && flags == O_RDONLY) {
+      // opened with the first access
+      entry.close();
+      entry.filename = path;
+      entry.pos = 0;
+      entry.is_dir = false;
+      entry.is_pending = true;
+      return true;
+    }
+    return entry.openEntry(path.c_str(), flags, is_directory);
   }
   int dirIndex() { return pos; }
 
@@ -170,50 +322,68 @@ class File : public Stream {
   }
 
   size_t size() {
-    int rc = stat(filename.c_str(), &info);
-    size_bytes = rc != -1 ? info.st_size : 0;
-    return size_bytes;
+    if (is_pending) {
+      // no need to open the file
+      struct stat info;
+      return stat(filename.c_str(), &info) == 0 ? info.st_size : 0;
+    }
+    return file.size();
   }
 
-  size_t position() { return file.tellg(); }
+  size_t position() { return io().position(); }
 
-  bool seek(size_t pos) {
-    file.seekg(pos);
-    return file ? true : false;
-  }
+  bool seek(size_t pos) { return io().seek(pos); }
 
   operator bool() { return isOpen(); }
 
   bool isDirectory() { return is_dir; }
 
-  const char *name() { return filename.c_str(); }
+  const char *name() {
+    return p_storage ? p_storage->sketchPath(filename) : filename.c_str();
+  }
 
+  /// Restarts the iteration: the entries are read again
   void rewindDirectory() {
     if (!is_dir) return;
-#ifdef USE_FILESYSTEM
-    try {
-      iterator = std::filesystem::directory_iterator(dir_path);
-    } catch (...) {
-      // Handle errors silently
-    }
-#endif
+    pos = 0;
+    is_dir_read = false;
   }
 
  protected:
-  std::fstream file;
-  size_t size_bytes = 0;
+  PosixFile file;
+  PosixDirectory directory;
+  bool is_dir_read = false;
+  bool is_pending = false;
+  size_t mmap_threshold = 0;
+  std::shared_ptr<SDStorage> p_storage;
   bool is_dir = false;
   int pos = 0;
   std::string filename = "";
-  struct stat info;
 
-#ifdef USE_FILESYSTEM
-  std::filesystem::directory_iterator iterator;
-  std::filesystem::path dir_path;
-#endif
+  /// Provides the file: a pending directory entry is opened
+  PosixFile &io() {
+    if (is_pending) {
+      is_pending = false;
+      std::string path = filename;
+      openEntry(path.c_str(), O_RDONLY, false);
+    }
+    return file;
+  }
 
-  std::ios_base::openmode toMode(int flags) {
-    return (std::ios_base::openmode)flags;
+  bool openEntry(const char *name, int flags, bool isDirectory) {
+    close();
+    filename = name;
+    pos = 0;
+    is_dir = isDirectory;
+    if (is_dir) return true;
+    if (!file.open(name, flags & ~O_AT_END)) return false;
+    if ((flags & O_TRUNC) && p_storage) p_storage->invalidate();
+    if (flags & O_AT_END) file.seek(file.size());
+    if (mmap_threshold > 0 && (flags & O_ACCMODE) == O_RDONLY &&
+        file.size() >= mmap_threshold) {
+      file.map();
+    }
+    return true;
   }
 };
 
@@ -235,33 +405,50 @@ class SdFat {
   }
   void initErrorHalt() { exit(0); }
 
+  /// Directory which is used as root of the card: e.g. to run multiple
+  /// emulated loggers with isolated cards. It is created if necessary.
+  bool setRoot(const char *dir) { return p_storage->setRoot(dir); }
+
+  /// Emulates a card of the indicated size: 0 (default) to report the file
+  /// system of the root directory
+  void setQuota(uint64_t bytes) { p_storage->setQuota(bytes); }
+
   bool exists(const char *name) {
     struct stat info;
-    return stat(name, &info) == 0;
+    return stat(path(name).c_str(), &info) == 0;
   }
 
   File open(const char *name, int flags = O_READ) {
     File file;
+    file.setMmapThreshold(mmap_threshold);
+    file.setStorage(p_storage);
     file.open(name, flags);
     return file;
   }
 
-  bool remove(const char *name) { return std::remove(name) == 0; }
-  bool mkdir(const char *name) { return ::mkdir(name, 0777) == 0; }
-  bool rmdir(const char *path) {
-    int rc = ::rmdir(path);
-    return rc == 0;
+  /// Read-only files with at least the indicated size are mapped into
+  /// memory: e.g. to replay big data logs. 0 (default) to deactivate.
+  void setMmapThreshold(size_t size) { mmap_threshold = size; }
+
+  bool remove(const char *name) {
+    p_storage->invalidate();
+    return std::remove(path(name).c_str()) == 0;
   }
-  uint64_t totalBytes() {
-    std::error_code ec;
-    const std::filesystem::space_info si = std::filesystem::space("/home", ec);
-    return si.capacity;
+  bool mkdir(const char *name) {
+    return ::mkdir(path(name).c_str(), 0777) == 0;
   }
-  uint64_t usedBytes() {
-    std::error_code ec;
-    const std::filesystem::space_info si = std::filesystem::space("/home", ec);
-    return si.capacity - si.available;
+  bool rmdir(const char *name) {
+    p_storage->invalidate();
+    return ::rmdir(path(name).c_str()) == 0;
   }
+  uint64_t totalBytes() { return p_storage->totalBytes(); }
+  uint64_t usedBytes() { return p_storage->usedBytes(); }
+
+ protected:
+  size_t mmap_threshold = 0;
+  std::shared_ptr<SDStorage> p_storage = std::make_shared<SDStorage>();
+
+  std::string path(const char *name) { return p_storage->path(name); }
 };
 
 static SdFat SD;
@@ -18,15 +18,13 @@
 */
 #pragma once
 
+#include "PosixFile.h"
 #include "Stream.h"
-#include <fstream>
+#include <climits>
 #include <iostream>
 #include <string>
 #include <sys/stat.h>
 #include <sys/types.h>
-#ifdef USE_FILESYSTEM
-#include <filesystem>
-#endif
 
 #define SD_SCK_MHZ(maxMhz) (1000000UL * (maxMhz))
 #define SPI_FULL_SPEED SD_SCK_MHZ(50)
@@ -37,17 +35,15 @@
 #define SPI_EIGHTH_SPEED SD_SCK_MHZ(1)
 #define SPI_SIXTEENTH_SPEED SD_SCK_HZ(500000)
 
-#define O_RDONLY ios::in          ///< Open for reading only.
-#define O_WRONLY ios::out         ///< Open for writing only.
-#define O_RDWR ios::in | ios::out ///< Open for reading and writing.
-#define O_AT_END ios::ate         ///< Open at EOF.
-#define O_APPEND ios::ate         ///< Set append mode.
-#define O_CREAT ios::trunc                 ///< Create file if it does not exist.
-#define O_TRUNC ios::trunc        ///< Truncate file to zero length.
-#define O_EXCL 0                  ///< Fail if the file exists.
-#define O_SYNC 0                  ///< Synchronized write I/O operations.
+// O_RDONLY, O_WRONLY, O_RDWR, O_APPEND, O_CREAT, O_TRUNC, O_EXCL and O_SYNC
+// are the ones of <fcntl.h>
+#ifndef O_AT_END
+#define O_AT_END 0x10000000 ///< Open at EOF (not used by open()).
+#endif
+#ifndef O_READ
 #define O_READ O_RDONLY
 #define O_WRITE O_WRONLY
+#endif
 
 #ifndef SS
 #define SS 0
@@ -85,61 +81,55 @@ public:
   void end(){}
 };
 /**
- * @brief C++ std based emulatoion ofr SdFile
+ * @brief Emulation of SdFile: regular files are accessed via PosixFile
  *
+ * The entries of a directory are read with a single pass when the iteration
+ * starts, so openNext() does not need any stat() calls.
  */
 class SdFile : public Stream {
 public:
-  bool isOpen() {
-    bool result = file.is_open();
-    return result;
-  }
+  bool isOpen() { return is_dir || file.isOpen(); }
 
+  /// Opens the file or directory with the open() flags
   bool open(const char *name, int flags) {
-    this->filename = name;
     struct stat info;
-    int rc = stat(name, &info);
-    if ((flags == O_RDONLY) && rc == -1){
-      // if we want to read but the file does not exist we fail
-      return false;
-    } else if (rc == 0 && info.st_mode & S_IFDIR) {
-      // file exists and it is a directory
-      is_dir = true;
-      size = 0;
-#ifdef USE_FILESYSTEM
-      dir_path = std::filesystem::path(filename);
-      iterator = std::filesystem::directory_iterator({dir_path});
-#endif
-      return true;
-    } else {
-      is_dir = false;
-      size = rc!=-1 ? info.st_size: 0;
-      file.open(filename.c_str(), (std::ios_base::openmode)flags);
-      return isOpen();
-    }
+    bool is_directory = stat(name, &info) == 0 && S_ISDIR(info.st_mode);
+    return openEntry(name, flags, is_directory);
   }
 
   bool close() {
-    file.close();
-    return !isOpen();
+    directory.clear();
+    is_dir_read = false;
+    return file.close();
   }
 
   size_t readBytes(uint8_t *buffer, size_t length) {
-    return file.readsome((char *)buffer, length);
+    return file.read(buffer, length);
   }
   size_t write(const uint8_t *buffer, size_t size) override {
-    file.write((const char *)buffer, size);
-    return file.good() ? size : 0;
-  }
-  size_t write(uint8_t ch) override {
-    file.put(ch);
-    return file.good() ? 1 : 0;
+    return file.write(buffer, size);
   }
-  int available() override { return size - file.tellg(); };
+  size_t write(uint8_t ch) override { return file.write(&ch, 1); }
+  int available() override {
+    return std::min<uint64_t>(file.available(), INT_MAX);
+  };
   int availableForWrite() override { return 1024; }
-  int read() override { return file.get(); }
+  int read() override { return file.read(); }
   int peek() override { return file.peek(); }
-  void flush() override {}
+  void flush() override { file.flush(); }
+
+  /// Write-behind mode for data loggers: write() copies the data into 64 KB
+  /// pages which are written by a background thread. It only blocks when all
+  /// pages are waiting to be written.
+  bool setAsyncWrite(bool active, size_t pages = 2) {
+    return file.setAsyncWrite(active, pages);
+  }
+
+  /// Waits until all data was written and commits it to the storage
+  bool sync() { return file.sync(); }
+  size_t fileSize() { return file.size(); }
+  size_t curPosition() { return file.position(); }
+  bool seekSet(size_t pos) { return file.seek(pos); }
   void getName(char *str, size_t len) { strncpy(str, filename.c_str(), len); }
   bool isDir() { return is_dir; }
   bool isHidden() { return false; }
@@ -147,25 +137,39 @@ public:
     pos = 0;
     return is_dir;
   }
+  /// Opens the next entry of the directory dir
   bool openNext(SdFile &dir, int flags = O_RDONLY) {
-  #ifdef USE_FILESYSTEM
-    if (dir.isDir() && dir.iterator != end(dir.iterator)) {
-      std::filesystem::directory_entry entry = *dir.iterator++;
-      return open(entry.path().c_str(), flags);
+    if (!dir.is_dir) return false;
+    if (!dir.is_dir_read) {
+      dir.is_dir_read = dir.directory.read(dir.filename.c_str());
+      if (!dir.is_dir_read) return false;
     }
-  #endif
-    return false;
+    if ((size_t)dir.pos >= dir.directory.size()) return false;
+    std::string path = dir.filename;
+    if (path.empty() || path.back() != '/') path += '/';
+    path += dir.directory.name(dir.pos);
+    bool is_directory = dir.directory.isDirectory(dir.pos);
+    dir.pos++;
+    return openEntry(path.c_str(), flags, is_directory);
   }
   int dirIndex() { return pos; }
 
 protected:
-  std::fstream file;
-  size_t size = 0;
-  bool is_dir;
+  PosixFile file;
+  PosixDirectory directory;
+  bool is_dir_read = false;
+  bool is_dir = false;
   int pos = 0;
   std::string filename;
-#ifdef USE_FILESYSTEM
-  std::filesystem::directory_iterator iterator;
-  std::filesystem::path dir_path;
-#endif
+
+  bool openEntry(const char *name, int flags, bool isDirectory) {
+    close();
+    filename = name;
+    pos = 0;
+    is_dir = isDirectory;
+    if (is_dir) return true;
+    if (!file.open(name, flags & ~O_AT_END)) return false;
+    if (flags & O_AT_END) file.seek(file.size());
+    return true;
+  }
 };
@@ -0,0 +1,72 @@
+/// Measures the throughput of the libb64 base64 encoding and decoding with
+/// each kernel which is supported by the CPU (bytewise is the original state
+/// machine) for 1 KB, 64 KB and 16 MB of data.
+
+#include <vector>
+
+#include "Arduino.h"
+#include "libb64/cbase64simd.h"
+#include "libb64/cdecode.h"
+#include "libb64/cencode.h"
+
+/// total amount of data which is processed per measurement
+const size_t TOTAL_SIZE = 64 * 1024 * 1024;
+const size_t SIZES[] = {1024, 64 * 1024, 16 * 1024 * 1024};
+const base64_kernel KERNELS[] = {base64_kernel_bytewise, base64_kernel_scalar,
+                                 base64_kernel_sse41, base64_kernel_avx2,
+                                 base64_kernel_neon};
+
+std::vector<char> data;
+std::vector<char> encoded;
+std::vector<char> decoded;
+
+void report(base64_kernel kernel, size_t size, unsigned long encode_us,
+            unsigned long decode_us, bool ok) {
+  char msg[100];
+  snprintf(msg, sizeof(msg), "%-9s %9u bytes  encode %8.1f MB/s  decode %8.1f MB/s %s",
+           base64_kernel_name(kernel), (unsigned)size,
+           (float)TOTAL_SIZE / encode_us, (float)TOTAL_SIZE / decode_us,
+           ok ? "" : "(error)");
+  Serial.println(msg);
+}
+
+void measure(base64_kernel kernel, size_t size) {
+  int rounds = TOTAL_SIZE / size;
+  int encoded_len = 0;
+  int decoded_len = 0;
+
+  unsigned long start = micros();
+  for (int j = 0; j < rounds; j++) {
+    encoded_len = base64_encode_chars(data.data(), size, encoded.data());
+  }
+  unsigned long encode_us = micros() - start;
+
+  start = micros();
+  for (int j = 0; j < rounds; j++) {
+    decoded_len = base64_decode_chars(encoded.data(), encoded_len, decoded.data());
+  }
+  unsigned long decode_us = micros() - start;
+
+  bool ok = decoded_len == (int)size &&
+            memcmp(data.data(), decoded.data(), size) == 0;
+  report(kernel, size, encode_us, decode_us, ok);
+}
+
+void setup() {
+  Serial.begin(115200);
+  size_t max_size = SIZES[2];
+  data.resize(max_size);
+  encoded.resize(base64_encode_expected_len(max_size) + 1);
+  decoded.resize(base64_decode_expected_len(encoded.size()) + 1);
+  randomSeed(1);
+  for (auto& b : data) b = random(256);
+
+  for (size_t size : SIZES) {
+    for (base64_kernel kernel : KERNELS) {
+      if (base64_set_kernel(kernel)) measure(kernel, size);
+    }
+  }
+  base64_set_kernel(base64_kernel_auto);
+}
+
+void loop() { delay(1000); }
@@ -0,0 +1,106 @@
+/// Measures the throughput of the COBS and SLIP framing streams with 1 MB
+/// payloads which are sent over an in-memory loopback stream. As reference
+/// the same COBS encoding is done byte by byte via write() and read().
+
+#include <vector>
+
+#include "Arduino.h"
+#include "FramingStream.h"
+
+const size_t PAYLOAD_SIZE = 1024 * 1024;
+const int ROUNDS = 20;
+
+/// Stream which provides the written data for reading
+class LoopbackStream : public Stream {
+ public:
+  size_t write(uint8_t c) override { return write(&c, 1); }
+  size_t write(const uint8_t* data, size_t len) override {
+    buffer.insert(buffer.end(), data, data + len);
+    return len;
+  }
+  int available() override { return buffer.size() - pos; }
+  int read() override { return pos < buffer.size() ? buffer[pos++] : -1; }
+  int peek() override { return pos < buffer.size() ? buffer[pos] : -1; }
+  size_t readBytes(uint8_t* data, size_t len) {
+    size_t n = std::min(len, buffer.size() - pos);
+    memcpy(data, buffer.data() + pos, n);
+    pos += n;
+    if (pos == buffer.size()) {
+      buffer.clear();
+      pos = 0;
+    }
+    return n;
+  }
+
+ protected:
+  std::vector<uint8_t> buffer;
+  size_t pos = 0;
+};
+
+std::vector<uint8_t> payload(PAYLOAD_SIZE);
+std::vector<uint8_t> received(PAYLOAD_SIZE);
+
+void report(const char* name, unsigned long us, bool ok) {
+  char msg[80];
+  snprintf(msg, sizeof(msg), "%-28s %8.1f MB/s %s", name,
+           ok ? (float)ROUNDS * PAYLOAD_SIZE / us : 0.0f, ok ? "" : "(error)");
+  Serial.println(msg);
+}
+
+template <class S>
+void measureFrames(const char* name) {
+  LoopbackStream loopback;
+  S stream(loopback, PAYLOAD_SIZE);
+  bool ok = true;
+  unsigned long start = micros();
+  for (int j = 0; j < ROUNDS; j++) {
+    stream.writeFrame(payload.data(), payload.size());
+    ok = ok && stream.readFrame(received.data(), received.size()) ==
+                   (long)PAYLOAD_SIZE;
+  }
+  unsigned long us = micros() - start;
+  report(name, us, ok && received == payload);
+}
+
+/// COBS encoding and decoding with a single byte per call
+void measureBytewise() {
+  LoopbackStream loopback;
+  Stream& io = loopback;
+  bool ok = true;
+  unsigned long start = micros();
+  for (int j = 0; j < ROUNDS; j++) {
+    uint8_t block[255];
+    size_t len = 0;
+    for (size_t i = 0; i <= payload.size(); i++) {
+      bool is_end = i == payload.size();
+      if (!is_end && payload[i] != 0) block[1 + len++] = payload[i];
+      if (is_end || payload[i] == 0 || len == 254) {
+        io.write((uint8_t)(len + 1));
+        for (size_t k = 0; k < len; k++) io.write(block[1 + k]);
+        len = 0;
+      }
+    }
+    io.write((uint8_t)0);
+    // decode
+    size_t o = 0;
+    int code;
+    while ((code = io.read()) > 0) {
+      for (int k = 1; k < code; k++) received[o++] = io.read();
+      if (code != 0xFF && io.peek() != 0) received[o++] = 0;
+    }
+    ok = ok && o == PAYLOAD_SIZE;
+  }
+  unsigned long us = micros() - start;
+  report("COBS byte by byte", us, ok && received == payload);
+}
+
+void setup() {
+  Serial.begin(115200);
+  randomSeed(1);
+  for (auto& b : payload) b = random(256);
+  measureBytewise();
+  measureFrames<COBSStream<LoopbackStream>>("COBS frames");
+  measureFrames<SLIPStream<LoopbackStream>>("SLIP frames");
+}
+
+void loop() { delay(1000); }
@@ -0,0 +1,96 @@
+/// Compares the round trip latency of the transports which can be used for
+/// the remote hardware protocol on loopback: UDP, unix domain socket and
+/// shared memory. A thread simulates the device which echoes all requests.
+
+#include <thread>
+
+#include "Arduino.h"
+#include "SharedMemoryStream.h"
+#include "SocketStream.h"
+#include "WiFiUdpStream.h"
+
+const int ROUNDS = 10000;
+const int MSG_SIZE = 16;
+
+// readBytes() of SocketStream and SharedMemoryStream blocks until data arrives
+template <class T>
+bool readAll(T& stream, uint8_t* data, int len) {
+  int n = 0;
+  unsigned long start = millis();
+  while (n < len) {
+    if (millis() - start > 1000) return false;
+    n += stream.readBytes(data + n, len - n);
+  }
+  return true;
+}
+
+// the simulated device
+template <class T>
+void echo(T& stream) {
+  uint8_t buffer[MSG_SIZE];
+  for (int j = 0; j < ROUNDS; j++) {
+    if (!readAll(stream, buffer, MSG_SIZE)) return;
+    stream.write(buffer, MSG_SIZE);
+    stream.flush();
+  }
+}
+
+template <class T>
+void measure(const char* name, T& stream) {
+  uint8_t request[MSG_SIZE] = {0};
+  uint8_t response[MSG_SIZE];
+  unsigned long start = micros();
+  for (int j = 0; j < ROUNDS; j++) {
+    stream.write(request, MSG_SIZE);
+    stream.flush();
+    if (!readAll(stream, response, MSG_SIZE)) {
+      Serial.println("timeout");
+      return;
+    }
+  }
+  char msg[80];
+  snprintf(msg, sizeof(msg), "%-20s %8.2f us per round trip", name,
+           (float)(micros() - start) / ROUNDS);
+  Serial.println(msg);
+}
+
+void measureUDP() {
+  WiFiUDPStream client, device;
+  client.begin(9601);
+  device.begin(9602);
+  client.setTarget(IPAddress(127, 0, 0, 1), 9602);
+  device.setTarget(IPAddress(127, 0, 0, 1), 9601);
+  std::thread thread([&]() { echo(device); });
+  measure("UDP", client);
+  thread.join();
+}
+
+void measureUnixSocket() {
+  const char* path = "/tmp/remote-latency.sock";
+  SocketStream client, device;
+  std::thread thread([&]() {
+    if (device.listenUnix(path, 1000)) echo(device);
+  });
+  while (!client.connectUnix(path)) delay(10);
+  measure("Unix domain socket", client);
+  thread.join();
+}
+
+void measureSharedMemory() {
+  const char* name = "/remote-latency";
+  SharedMemoryStream client, device;
+  client.create(name);
+  device.open(name);
+  std::thread thread([&]() { echo(device); });
+  measure("Shared memory", client);
+  thread.join();
+}
+
+void setup() {
+  Serial.begin(115200);
+  measureUDP();
+  measureUnixSocket();
+  measureSharedMemory();
+}
+
+void loop() { delay(1000); }
@@ -0,0 +1,153 @@
+/// Load test of the remote hardware protocol without real hardware: a thread
+/// runs HardwareServiceServer with a mock GPIO and a mock serial port behind
+/// a unix domain socket. The client connects with HardwareSetupRemote
+/// (including the handshake), checks the replies and reports the number of
+/// calls per second and the serial read throughput.
+
+#include <atomic>
+#include <thread>
+
+#include "Arduino.h"
+#include "HardwareServiceServer.h"
+#include "HardwareSetupRemote.h"
+#include "RemoteSerial.h"
+#include "SocketStream.h"
+
+const char* SOCKET_PATH = "/tmp/remote-load.sock";
+const int ROUNDS = 20000;
+const size_t SERIAL_TOTAL = 4 * 1024 * 1024;
+
+/// digitalRead() returns the last written value of the pin
+class MockGPIO : public HardwareGPIO {
+ public:
+  void pinMode(pin_size_t pinNumber, PinMode pinMode) override {}
+  void digitalWrite(pin_size_t pinNumber, PinStatus status) override {
+    pins[pinNumber % 64] = status;
+  }
+  PinStatus digitalRead(pin_size_t pinNumber) override {
+    return pins[pinNumber % 64];
+  }
+  int analogRead(pin_size_t pinNumber) override { return pinNumber; }
+  void analogReference(uint8_t mode) override {}
+  void analogWrite(pin_size_t pinNumber, int value) override {}
+  void tone(uint8_t pin, unsigned int frequency,
+            unsigned long duration = 0) override {}
+  void noTone(uint8_t pin) override {}
+  unsigned long pulseIn(uint8_t pin, uint8_t state,
+                        unsigned long timeout = 1000000L) override {
+    return 0;
+  }
+  unsigned long pulseInLong(uint8_t pin, uint8_t state,
+                            unsigned long timeout = 1000000L) override {
+    return 0;
+  }
+  void analogWriteFrequency(pin_size_t pin, uint32_t freq) override {}
+  void analogWriteResolution(uint8_t bits) override {}
+
+ protected:
+  PinStatus pins[64] = {LOW};
+};
+
+/// serial port which always has data: the bytes are a counter
+class MockSerial : public HardwareSerial {
+ public:
+  void begin(unsigned long baudrate) override {}
+  void begin(unsigned long baudrate, uint16_t config) override {}
+  void end() override {}
+  int available() override { return 1024; }
+  int peek() override { return counter; }
+  int read() override { return counter++; }
+  void flush() override {}
+  size_t write(uint8_t c) override { return 1; }
+  operator bool() override { return true; }
+
+ protected:
+  uint8_t counter = 0;
+};
+
+MockGPIO mock_gpio;
+MockSerial mock_serial;
+std::atomic<bool> is_done{false};
+
+// the simulated device: it connects to the emulator and serves the calls
+void device() {
+  SocketStream stream;
+  delay(100);  // wait for listenUnix()
+  while (!stream.connectUnix(SOCKET_PATH)) delay(100);
+  HardwareServiceServer server;
+  server.setGPIO(&mock_gpio);
+  server.setSerial(&mock_serial, 0);
+  server.begin(stream);
+  while (!is_done) delay(10);
+  server.end();
+}
+
+void report(const char* name, float value, const char* unit) {
+  char msg[80];
+  snprintf(msg, sizeof(msg), "%-28s %10.1f %s", name, value, unit);
+  Serial.println(msg);
+}
+
+bool testGPIO(HardwareGPIO* gpio) {
+  unsigned long start = micros();
+  for (int j = 0; j < ROUNDS; j++) {
+    PinStatus status = (j & 1) ? HIGH : LOW;
+    gpio->digitalWrite(13, status);
+    if (gpio->digitalRead(13) != status) {
+      Serial.println("digitalRead: invalid value");
+      return false;
+    }
+  }
+  report("digitalWrite + digitalRead", ROUNDS * 1000000.0f / (micros() - start),
+         "calls/s");
+
+  // calls without reply are only limited by the throughput
+  start = micros();
+  for (int j = 0; j < ROUNDS; j++) gpio->digitalWrite(12, HIGH);
+  bool ok = gpio->digitalRead(12) == HIGH;
+  report("digitalWrite", ROUNDS * 1000000.0f / (micros() - start), "calls/s");
+  return ok;
+}
+
+bool testSerial(RemoteSerialClass& serial) {
+  uint8_t buffer[512];
+  uint8_t expected = 0;
+  size_t total = 0;
+  unsigned long start = micros();
+  while (total < SERIAL_TOTAL) {
+    size_t n = serial.readBytes(buffer, sizeof(buffer));
+    if (n == 0) {
+      Serial.println("readBytes: timeout");
+      return false;
+    }
+    for (size_t j = 0; j < n; j++) {
+      if (buffer[j] != expected++) {
+        Serial.println("readBytes: invalid data");
+        return false;
+      }
+    }
+    total += n;
+  }
+  report("Serial readBytes", (float)total / (micros() - start), "MB/s");
+  return true;
+}
+
+void setup() {
+  Serial.begin(115200);
+  std::thread thread(device);
+  SocketStream stream;
+  HardwareSetupRemote remote;
+  remote.setHandShakeTimeout(5000);
+  if (!stream.listenUnix(SOCKET_PATH, 5000) ||
+      !remote.begin(&stream, false)) {
+    Serial.println("device not connected");
+  } else {
+    RemoteSerialClass serial(stream, 0);
+    bool ok = testGPIO(remote.getGPIO()) && testSerial(serial);
+    Serial.println(ok ? "OK" : "FAILED");
+  }
+  is_done = true;
+  thread.join();
+}
+
+void loop() { delay(1000); }
@@ -0,0 +1,76 @@
+/// Tests the reliable mode of WiFiUDPStream on loopback: a thread sends 4 MB
+/// in small datagrams (so that the 16 bit sequence numbers wrap around) while
+/// both sides drop some of their outgoing datagrams. The received data must
+/// be complete and in order.
+
+#include <atomic>
+#include <thread>
+#include <vector>
+
+#include "Arduino.h"
+#include "WiFiUdpStream.h"
+
+const size_t DATA_SIZE = 4 * 1024 * 1024;
+const int PACKET_SIZE = 64;
+const int WINDOW_SIZE = 5;  // rounded up to 8
+const float LOSS_RATE = 0.01f;
+
+std::vector<uint8_t> data(DATA_SIZE);
+std::vector<uint8_t> received;
+std::atomic<bool> is_done{false};
+
+void setupStream(WiFiUDPStream& stream, int port, int targetPort,
+                 uint32_t seed) {
+  stream.setPacketPool(0, PACKET_SIZE);
+  stream.begin(port);
+  stream.setTarget(IPAddress(127, 0, 0, 1), targetPort);
+  stream.setReliable(true, WINDOW_SIZE);
+  stream.setRetransmitTimeout(5);
+  stream.setTimeout(5000);
+  stream.setSimulatedLoss(LOSS_RATE, seed);
+}
+
+void sender() {
+  WiFiUDPStream stream;
+  setupStream(stream, 9611, 9612, 1);
+  size_t pos = 0;
+  while (pos < DATA_SIZE && !stream.getWriteError()) {
+    pos += stream.write(data.data() + pos, min((size_t)1000, DATA_SIZE - pos));
+  }
+  stream.flush();
+  // the receiver thread keeps processing the acks and retransmissions until
+  // everything has been received
+  stream.setReceiverThread(true);
+  while (!is_done) delay(1);
+  stream.stop();
+}
+
+void setup() {
+  Serial.begin(115200);
+  randomSeed(1);
+  for (auto& b : data) b = random(256);
+
+  WiFiUDPStream stream;
+  setupStream(stream, 9612, 9611, 2);
+  received.reserve(DATA_SIZE);
+
+  unsigned long start = millis();
+  std::thread thread(sender);
+  uint8_t buffer[1024];
+  while (received.size() < DATA_SIZE && millis() - start < 60000) {
+    stream.waitForPacket(10);
+    int n = stream.read(buffer, sizeof(buffer));
+    received.insert(received.end(), buffer, buffer + n);
+  }
+  is_done = true;
+  thread.join();
+  stream.stop();
+
+  char msg[80];
+  bool ok = received == data;
+  snprintf(msg, sizeof(msg), "%s: %u bytes in %lu ms", ok ? "OK" : "FAILED",
+           (unsigned)received.size(), millis() - start);
+  Serial.println(msg);
+}
+
+void loop() { delay(1000); }